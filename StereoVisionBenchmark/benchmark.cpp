@@ -0,0 +1,703 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gray_reader.h"
+#include "ground_truth.h"
+#include "profiler.h"
+#include "stereo.h"
+#include "streaming.h"
+#include "synthetic.h"
+#include "tiled.h"
+
+/*
+Microbenchmarks of the stages and engines of StereoVisionCpp on synthetic image pairs (see synthetic.h).
+* Cases: scaleAndGray, zncc, crossChecking, occlusionFilling, normalize, and the whole pipeline
+  in memory (pipeline), row by row (streaming) and tile by tile (tiled).
+* Every case runs for every combination of the parameters it depends on. The other parameters are fixed
+  to the constants of stereo.h, which is what the case actually uses:
+  zncc depends on size, window, disparities and threads, tiled on size and threads, the rest on size only.
+* Sizes are the ones of the gray images the stages work on, scaleAndGray gets scaleFactor times larger RGBA input.
+* Throughput is reported per pixel and per pixel and disparity (Mpixel*disparities/s). disparities is the largest
+  disparity of a case, it searches the disparities + 1 values from 0 up to it.
+* Each case runs several times, the fastest and the median run are reported, on the console and as JSON.
+* With --profile every run is a "benchmark run" zone of the profiler report, --counters adds the hardware counters
+  of the runs and of the zones of the stages to it.
+* --evaluate measures accuracy against ground truth instead (see ground_truth.h), for every window and disparity range:
+  the raw left disparity map (zncc) and the final map (pipeline) are timed and compared with the ground truth,
+  bad pixel rates and RMSE are reported next to the throughput. The input is the pair of --left and --right
+  with --ground-truth (PFM or PNG, --gt-scale for PNG) or the synthetic pairs of --sizes without their occluded pixels.
+  The configurations that no other one beats in both throughput and the --pareto metric (bad1, bad2 (default), bad4
+  or rmse) form the Pareto frontier, which is printed at the end.
+*/
+struct Options {
+	std::vector<std::string> cases = {
+		"scaleAndGray", "zncc", "crossChecking", "occlusionFilling", "normalize", "pipeline", "streaming", "tiled"
+	};
+	std::vector<std::pair<unsigned, unsigned>> sizes = { { 367, 252 }, { 735, 504 } }; // A quarter and all of the sample pair
+	std::vector<int> windows = { windowWidth };
+	std::vector<int> disparities = { maxDisparity };
+	std::vector<unsigned> threads;
+	int runs = 3;
+	const char* jsonFile = "benchmark.json";
+	const char* profileFile = nullptr;
+	bool counters = false;
+	bool evaluate = false;
+	bool sweepSet = false; // --windows or --disparities given, the evaluation sweeps more of both otherwise
+	const char* leftFile = nullptr;
+	const char* rightFile = nullptr;
+	const char* groundTruthFile = nullptr;
+	float groundTruthScale = 256;
+	int paretoMetric = 1; // Index into DisparityErrors::bad, badThresholdCount for the RMSE
+};
+
+struct Result {
+	std::string name;
+	unsigned width, height;
+	int window, disparities;
+	unsigned threads;
+	double bestMs, medianMs;
+};
+
+struct Evaluation {
+	std::string input, stage;
+	unsigned width, height;
+	int window, disparities;
+	double bestMs;
+	DisparityErrors errors;
+	bool pareto;
+};
+
+// Parameters of one run of a case
+struct CaseParameters {
+	unsigned width, height;
+	int window, disparities;
+	unsigned threads;
+};
+
+/*
+Reads a gray image held in memory row by row, for the tiled pipeline which takes its input from readers.
+* The image is already downscaled, so the scale factor is 1.
+*/
+class MemoryGrayReader : public GrayReader {
+private:
+	const std::vector<unsigned>& m_Pixels;
+	unsigned m_Row;
+
+public:
+	MemoryGrayReader(const std::vector<unsigned>& pixels, const unsigned width, const unsigned height) :
+		GrayReader(1), m_Pixels(pixels), m_Row(0) {
+		m_Width = width;
+		m_Height = height;
+	}
+
+	unsigned nextRow(unsigned* out) override {
+		const unsigned* row = &m_Pixels[(size_t)m_Row++ * m_Width];
+		std::copy(row, row + m_Width, out);
+		return 0;
+	}
+};
+
+// The whole image functions print their progress, which has no place in the middle of a measurement
+class QuietOutput {
+public:
+	QuietOutput() { std::cout.setstate(std::ios::failbit); }
+	~QuietOutput() { std::cout.clear(); }
+};
+
+// Prototypes
+bool parseOptions(int, char**, Options&);
+bool runCase(const std::string&, const CaseParameters&, const int, Result&);
+bool writeJson(const char*, const std::vector<Result>&);
+int runEvaluation(const Options&);
+bool writeEvaluationJson(const char*, const std::vector<Evaluation>&);
+
+int main(int argc, char** argv) {
+	Options options;
+	if (!parseOptions(argc, argv, options)) {
+		std::cout << "Usage: " << argv[0] << " [--cases name,...] [--sizes WIDTHxHEIGHT,...] [--windows n,...]"
+			<< " [--disparities n,...] [--threads n,...] [--runs n] [--json benchmark.json] [--profile trace.json [--counters]]"
+			<< " [--evaluate [--left file --right file --ground-truth file [--gt-scale n]] [--pareto bad1 | bad2 | bad4 | rmse]]" << std::endl;
+		std::cout << "Cases: scaleAndGray, zncc, crossChecking, occlusionFilling, normalize, pipeline, streaming, tiled" << std::endl;
+		return -1;
+	}
+
+	Profiler::instance().setThreadName("main");
+	ProfileOutput profileOutput(options.profileFile);
+
+	if (options.counters) {
+		std::string error;
+		if (!Profiler::instance().enableCounters(error)) {
+			std::cout << "Hardware counters unavailable (" << error << "), only timing is recorded" << std::endl;
+		}
+	}
+
+	if (options.evaluate) {
+		return runEvaluation(options);
+	}
+
+	if (options.threads.empty()) {
+		options.threads.push_back(1);
+
+		unsigned cores = std::thread::hardware_concurrency();
+		if (cores > 1) options.threads.push_back(cores);
+	}
+
+	std::vector<Result> results;
+
+	std::cout << "case                  size        window  disp  threads    best ms  median ms   Mpixel/s  Mpixel*disp/s" << std::endl;
+
+	for (const std::string& name : options.cases) {
+		const bool byWindow = name == "zncc";
+		const bool byDisparities = name == "zncc";
+		const bool byThreads = name == "zncc" || name == "tiled";
+
+		for (const auto& size : options.sizes) {
+			for (size_t w = 0; w < (byWindow ? options.windows.size() : 1); w++) {
+				for (size_t d = 0; d < (byDisparities ? options.disparities.size() : 1); d++) {
+					for (size_t t = 0; t < (byThreads ? options.threads.size() : 1); t++) {
+						CaseParameters parameters = {
+							size.first,
+							size.second,
+							byWindow ? options.windows[w] : windowWidth,
+							byDisparities ? options.disparities[d] : maxDisparity,
+							byThreads ? options.threads[t] : 1
+						};
+
+						Result result;
+						if (!runCase(name, parameters, options.runs, result)) {
+							std::cout << "Unknown case " << name << std::endl;
+							return -1;
+						}
+
+						const double pixels = (double)result.width * result.height;
+
+						char line[160];
+						snprintf(line, sizeof(line), "%-20s %5ux%-5u %7d %5d %8u %10.3f %10.3f %10.2f %14.1f",
+							result.name.c_str(), result.width, result.height, result.window, result.disparities, result.threads,
+							result.bestMs, result.medianMs, pixels / result.bestMs / 1e3,
+							pixels * (result.disparities + 1) / result.bestMs / 1e3);
+						std::cout << line << std::endl;
+
+						results.push_back(result);
+					}
+				}
+			}
+		}
+	}
+
+	if (!writeJson(options.jsonFile, results)) {
+		std::cout << "Failed to write " << options.jsonFile << std::endl;
+		return -1;
+	}
+
+	return 0;
+}
+
+// Comma separated list of values, returns false if one of them isn't valid
+template<typename T>
+static bool parseList(const char* text, std::vector<T>& values, std::function<bool(const std::string&, T&)> parse) {
+	values.clear();
+
+	std::string list(text);
+	size_t begin = 0;
+
+	while (begin <= list.size()) {
+		size_t end = list.find(',', begin);
+		if (end == std::string::npos) end = list.size();
+
+		T value;
+		if (!parse(list.substr(begin, end - begin), value)) return false;
+		values.push_back(value);
+
+		begin = end + 1;
+	}
+
+	return !values.empty();
+}
+
+static bool parsePositive(const std::string& text, int& value) {
+	value = atoi(text.c_str());
+	return value > 0;
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+	auto parseName = [](const std::string& text, std::string& value) {
+		value = text;
+		return !text.empty();
+	};
+
+	auto parseSize = [](const std::string& text, std::pair<unsigned, unsigned>& value) {
+		return sscanf(text.c_str(), "%ux%u", &value.first, &value.second) == 2 && value.first > 0 && value.second > 0;
+	};
+
+	auto parseThreads = [](const std::string& text, unsigned& value) {
+		value = atoi(text.c_str());
+		return value > 0;
+	};
+
+	for (int i = 1; i < argc; i++) {
+		bool valid = true;
+
+		// The flags take no value, all the other options need one
+		if (!strcmp(argv[i], "--counters")) {
+			options.counters = true;
+		} else if (!strcmp(argv[i], "--evaluate")) {
+			options.evaluate = true;
+		} else if (i + 1 >= argc) {
+			return false;
+		} else if (!strcmp(argv[i], "--cases")) {
+			valid = parseList<std::string>(argv[++i], options.cases, parseName);
+		} else if (!strcmp(argv[i], "--sizes")) {
+			valid = parseList<std::pair<unsigned, unsigned>>(argv[++i], options.sizes, parseSize);
+		} else if (!strcmp(argv[i], "--windows")) {
+			valid = parseList<int>(argv[++i], options.windows, parsePositive);
+			options.sweepSet = true;
+		} else if (!strcmp(argv[i], "--disparities")) {
+			valid = parseList<int>(argv[++i], options.disparities, parsePositive);
+			options.sweepSet = true;
+		} else if (!strcmp(argv[i], "--threads")) {
+			valid = parseList<unsigned>(argv[++i], options.threads, parseThreads);
+		} else if (!strcmp(argv[i], "--runs")) {
+			valid = parsePositive(argv[++i], options.runs);
+		} else if (!strcmp(argv[i], "--json")) {
+			options.jsonFile = argv[++i];
+		} else if (!strcmp(argv[i], "--profile")) {
+			options.profileFile = argv[++i];
+		} else if (!strcmp(argv[i], "--left")) {
+			options.leftFile = argv[++i];
+		} else if (!strcmp(argv[i], "--right")) {
+			options.rightFile = argv[++i];
+		} else if (!strcmp(argv[i], "--ground-truth")) {
+			options.groundTruthFile = argv[++i];
+		} else if (!strcmp(argv[i], "--gt-scale")) {
+			options.groundTruthScale = (float)atof(argv[++i]);
+			valid = options.groundTruthScale > 0;
+		} else if (!strcmp(argv[i], "--pareto")) {
+			const char* metric = argv[++i];
+			if (!strcmp(metric, "bad1")) {
+				options.paretoMetric = 0;
+			} else if (!strcmp(metric, "bad2")) {
+				options.paretoMetric = 1;
+			} else if (!strcmp(metric, "bad4")) {
+				options.paretoMetric = 2;
+			} else if (!strcmp(metric, "rmse")) {
+				options.paretoMetric = badThresholdCount;
+			} else {
+				valid = false;
+			}
+		} else {
+			valid = false;
+		}
+
+		if (!valid) return false;
+	}
+
+	// A real pair needs both images and its ground truth
+	const bool pairComplete = !options.leftFile == !options.rightFile && !options.leftFile == !options.groundTruthFile;
+
+	return (!options.counters || options.profileFile) && pairComplete;
+}
+
+// The ZNCC kernel on row bands, one band per thread, every band reads the rows of its windows around it
+static void znccBands(
+	const std::vector<unsigned>& left,
+	const std::vector<unsigned>& right,
+	std::vector<unsigned>& disparity,
+	const CaseParameters& parameters
+) {
+	const int width = parameters.width;
+	const int height = parameters.height;
+	const int window = parameters.window;
+
+	auto band = [&](const int rowBegin, const int rowEnd) {
+		std::vector<const unsigned*> leftRows(window), rightRows(window);
+
+		for (int i = rowBegin; i < rowEnd; i++) {
+			for (int x = -window / 2; x < window / 2; x++) {
+				bool inside = i + x >= 0 && i + x < height;
+
+				leftRows[x + window / 2] = inside ? &left[(size_t)(i + x) * width] : nullptr;
+				rightRows[x + window / 2] = inside ? &right[(size_t)(i + x) * width] : nullptr;
+			}
+
+			znccRow(leftRows.data(), rightRows.data(), &disparity[(size_t)i * width], width, 0, parameters.disparities,
+				0, width, 0, window, window);
+		}
+	};
+
+	const int bandCount = std::min((int)parameters.threads, height);
+
+	std::vector<std::thread> threads;
+	for (int k = 1; k < bandCount; k++) {
+		threads.emplace_back(band, height * k / bandCount, height * (k + 1) / bandCount);
+	}
+	band(0, height / bandCount);
+
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+}
+
+/*
+Measures one case, the inputs are created before the measured runs.
+* Returns false for an unknown case name.
+*/
+bool runCase(const std::string& name, const CaseParameters& parameters, const int runs, Result& result) {
+	const unsigned width = parameters.width;
+	const unsigned height = parameters.height;
+	const size_t size = (size_t)width * height;
+
+	// Pairs are reused by the cases of the same size and disparity range
+	static std::map<std::string, SyntheticPair> pairs;
+
+	const std::string key = std::to_string(width) + "x" + std::to_string(height) + "/" + std::to_string(parameters.disparities);
+	SyntheticPair& pair = pairs[key];
+	if (pair.left.empty()) {
+		makeSyntheticPair(pair, width, height, parameters.disparities);
+	}
+
+	// Input of the later stages: the ground truth with its occluded pixels and some more cleared by the cross check
+	std::vector<unsigned> checked(pair.disparity), shifted(pair.disparity);
+	for (size_t i = 0; i < size; i++) {
+		if (pair.occluded[i] || i % 23 == 0) {
+			checked[i] = 0;
+			shifted[i] += crossCheckingThreshold + 1;
+		}
+	}
+
+	std::vector<unsigned> output(size);
+	std::function<void()> run;
+
+	if (name == "scaleAndGray") {
+		std::vector<unsigned char> rgba = grayToRgba(pair.left, width, height, scaleFactor);
+
+		run = [&, rgba]() {
+			output = scaleAndGray(rgba, width * scaleFactor, height * scaleFactor);
+		};
+	} else if (name == "zncc") {
+		run = [&]() {
+			znccBands(pair.left, pair.right, output, parameters);
+		};
+	} else if (name == "crossChecking") {
+		run = [&]() {
+			QuietOutput quiet;
+			output = crossChecking(pair.disparity, shifted, width, height);
+		};
+	} else if (name == "occlusionFilling") {
+		run = [&]() {
+			QuietOutput quiet;
+			output = occlusionFilling(checked, width, height);
+		};
+	} else if (name == "normalize") {
+		run = [&]() {
+			std::vector<unsigned char> image = normalize(pair.disparity, width, height);
+			output[0] = image[0];
+		};
+	} else if (name == "pipeline") {
+		run = [&]() {
+			QuietOutput quiet;
+			std::vector<unsigned> dispLR = zncc(pair.left, pair.right, width, height, 0, maxDisparity);
+			std::vector<unsigned> dispRL = zncc(pair.right, pair.left, width, height, -maxDisparity, 0);
+			output = occlusionFilling(crossChecking(dispLR, dispRL, width, height), width, height);
+		};
+	} else if (name == "streaming") {
+		// Rows are copied from the pair like a reader would convert them
+		auto rowSource = [width](const std::vector<unsigned>& image, unsigned& row) -> RowSource {
+			return [&image, &row, width](unsigned* out) {
+				const unsigned* source = &image[(size_t)row++ * width];
+				std::copy(source, source + width, out);
+				return 0u;
+			};
+		};
+
+		run = [&]() {
+			unsigned leftRow = 0, rightRow = 0;
+
+			streamDisparity(
+				rowSource(pair.left, leftRow),
+				rowSource(pair.right, rightRow),
+				width,
+				height,
+				[&](unsigned i, const unsigned* disparity) { std::copy(disparity, disparity + width, &output[(size_t)i * width]); }
+			);
+		};
+	} else if (name == "tiled") {
+		run = [&]() {
+			MemoryGrayReader left(pair.left, width, height), right(pair.right, width, height);
+			tiledDisparity(left, right, "benchmark_tiled.pgm", nullptr, parameters.threads);
+		};
+	} else {
+		return false;
+	}
+
+	std::vector<double> durations;
+
+	for (int i = 0; i < runs; i++) {
+		ProfileZone zone("benchmark run");
+		zone.setPixels(size);
+
+		auto start = std::chrono::steady_clock::now();
+		run();
+		std::chrono::duration<double, std::milli> duration = std::chrono::steady_clock::now() - start;
+
+		durations.push_back(duration.count());
+	}
+
+	remove("benchmark_tiled.pgm");
+
+	std::sort(durations.begin(), durations.end());
+
+	result.name = name;
+	result.width = width;
+	result.height = height;
+	result.window = parameters.window;
+	result.disparities = parameters.disparities;
+	result.threads = parameters.threads;
+	result.bestMs = durations.front();
+	result.medianMs = durations[durations.size() / 2];
+
+	return true;
+}
+
+bool writeJson(const char* filename, const std::vector<Result>& results) {
+	std::ofstream out(filename);
+	if (!out) return false;
+
+	out << "{\n  \"hardwareThreads\": " << std::thread::hardware_concurrency() << ",\n  \"results\": [";
+
+	char line[512];
+
+	for (size_t i = 0; i < results.size(); i++) {
+		const Result& result = results[i];
+		const double pixels = (double)result.width * result.height;
+
+		snprintf(line, sizeof(line),
+			"%s\n    {\"case\": \"%s\", \"width\": %u, \"height\": %u, \"window\": %d, \"disparities\": %d, \"threads\": %u,"
+			" \"bestMs\": %.4f, \"medianMs\": %.4f, \"mpixelsPerSecond\": %.4f, \"mpixelDisparitiesPerSecond\": %.4f}",
+			i ? "," : "", result.name.c_str(), result.width, result.height, result.window, result.disparities, result.threads,
+			result.bestMs, result.medianMs, pixels / result.bestMs / 1e3, pixels * (result.disparities + 1) / result.bestMs / 1e3);
+
+		out << line;
+	}
+
+	out << "\n  ]\n}\n";
+
+	return (bool)out;
+}
+
+// Error of a configuration in the metric of the Pareto frontier
+static double paretoError(const DisparityErrors& errors, const int metric) {
+	return metric < badThresholdCount ? errors.bad[metric] : errors.rmse;
+}
+
+/*
+Marks the evaluations of an input that no other one of it dominates: at least as fast and at most as wrong,
+better in one of both.
+*/
+static void markParetoFrontier(std::vector<Evaluation>& evaluations, const size_t begin, const int metric) {
+	for (size_t a = begin; a < evaluations.size(); a++) {
+		Evaluation& candidate = evaluations[a];
+		candidate.pareto = true;
+
+		for (size_t b = begin; b < evaluations.size() && candidate.pareto; b++) {
+			const Evaluation& other = evaluations[b];
+
+			const bool notSlower = other.bestMs <= candidate.bestMs;
+			const bool notWorse = paretoError(other.errors, metric) <= paretoError(candidate.errors, metric);
+			const bool better = other.bestMs < candidate.bestMs || paretoError(other.errors, metric) < paretoError(candidate.errors, metric);
+
+			if (notSlower && notWorse && better) candidate.pareto = false;
+		}
+	}
+}
+
+/*
+The accuracy sweep of --evaluate, every input is evaluated for every window and disparity range.
+* Runs are single threaded like the default pipeline of StereoVisionCpp, the time of zncc is the one of the left map only.
+*/
+int runEvaluation(const Options& options) {
+	struct Input {
+		std::string name;
+		unsigned width, height;
+		std::vector<unsigned> left, right;
+		GroundTruth truth;
+		std::vector<unsigned char> occluded;
+	};
+
+	std::vector<Input> inputs;
+
+	if (options.leftFile) {
+		Input input;
+		input.name = options.leftFile;
+
+		unsigned fullWidth, fullHeight;
+		unsigned error = decodeScaledGray(input.left, fullWidth, fullHeight, options.leftFile, scaleFactor);
+		if (!error) error = decodeScaledGray(input.right, fullWidth, fullHeight, options.rightFile, scaleFactor);
+		if (!error) error = loadGroundTruth(input.truth, options.groundTruthFile, options.groundTruthScale);
+
+		if (error) {
+			std::cout << "Failed to load the evaluation input: " << imageErrorText(error) << std::endl;
+			return -1;
+		}
+
+		input.width = fullWidth / scaleFactor;
+		input.height = fullHeight / scaleFactor;
+		inputs.push_back(std::move(input));
+	} else {
+		for (const auto& size : options.sizes) {
+			SyntheticPair pair;
+			makeSyntheticPair(pair, size.first, size.second, maxDisparity);
+
+			// The ground truth has the size of the map, the pair is already downscaled
+			Input input;
+			input.name = "synthetic " + std::to_string(size.first) + "x" + std::to_string(size.second);
+			input.width = pair.width;
+			input.height = pair.height;
+			input.left = std::move(pair.left);
+			input.right = std::move(pair.right);
+			input.truth.width = pair.width;
+			input.truth.height = pair.height;
+			input.truth.disparity.assign(pair.disparity.begin(), pair.disparity.end());
+			input.occluded = std::move(pair.occluded);
+			inputs.push_back(std::move(input));
+		}
+	}
+
+	// Without a given sweep, windows and disparity ranges around the defaults of stereo.h
+	std::vector<int> windows = options.windows, disparities = options.disparities;
+	if (!options.sweepSet) {
+		windows = { 5, 7, windowWidth, 11, 15 };
+		disparities = { maxDisparity / 2, maxDisparity * 3 / 4, maxDisparity };
+	}
+
+	static const char* metricNames[badThresholdCount + 1] = { "bad1", "bad2", "bad4", "rmse" };
+
+	std::vector<Evaluation> evaluations;
+
+	for (const Input& input : inputs) {
+		const size_t size = (size_t)input.width * input.height;
+		const size_t begin = evaluations.size();
+
+		std::cout << input.name << std::endl;
+		std::cout << "stage      window  disp    best ms   Mpixel/s   bad1 %   bad2 %   bad4 %     RMSE  pareto" << std::endl;
+
+		for (int window : windows) {
+			for (int disparity : disparities) {
+				for (const char* stage : { "zncc", "pipeline" }) {
+					const bool pipeline = !strcmp(stage, "pipeline");
+
+					std::vector<unsigned> output;
+					double bestMs = 0;
+
+					for (int run = 0; run < options.runs; run++) {
+						ProfileZone zone("benchmark run");
+						zone.setPixels(size);
+
+						QuietOutput quiet;
+						auto start = std::chrono::steady_clock::now();
+
+						output = zncc(input.left, input.right, input.width, input.height, 0, disparity, window, window);
+
+						if (pipeline) {
+							std::vector<unsigned> dispRL = zncc(input.right, input.left, input.width, input.height, -disparity, 0, window, window);
+							output = occlusionFilling(crossChecking(output, dispRL, input.width, input.height), input.width, input.height);
+						}
+
+						std::chrono::duration<double, std::milli> duration = std::chrono::steady_clock::now() - start;
+						if (run == 0 || duration.count() < bestMs) bestMs = duration.count();
+					}
+
+					Evaluation evaluation = { input.name, stage, input.width, input.height, window, disparity, bestMs, {}, false };
+
+					unsigned error = evaluateDisparity(evaluation.errors, output, input.width, input.height, input.truth,
+						input.occluded.empty() ? nullptr : &input.occluded);
+
+					if (error) {
+						std::cout << "Failed to evaluate " << input.name << ": " << imageErrorText(error) << std::endl;
+						return -1;
+					}
+
+					evaluations.push_back(evaluation);
+				}
+			}
+		}
+
+		markParetoFrontier(evaluations, begin, options.paretoMetric);
+
+		for (size_t i = begin; i < evaluations.size(); i++) {
+			const Evaluation& evaluation = evaluations[i];
+
+			char line[160];
+			snprintf(line, sizeof(line), "%-10s %6d %5d %10.3f %10.2f %8.2f %8.2f %8.2f %8.3f  %s",
+				evaluation.stage.c_str(), evaluation.window, evaluation.disparities, evaluation.bestMs, size / evaluation.bestMs / 1e3,
+				evaluation.errors.bad[0], evaluation.errors.bad[1], evaluation.errors.bad[2], evaluation.errors.rmse,
+				evaluation.pareto ? "*" : "");
+			std::cout << line << std::endl;
+		}
+
+		// The frontier from the fastest to the most accurate configuration
+		std::vector<const Evaluation*> frontier;
+		for (size_t i = begin; i < evaluations.size(); i++) {
+			if (evaluations[i].pareto) frontier.push_back(&evaluations[i]);
+		}
+
+		std::sort(frontier.begin(), frontier.end(), [](const Evaluation* a, const Evaluation* b) { return a->bestMs < b->bestMs; });
+
+		std::cout << std::endl << "Pareto frontier of throughput and " << metricNames[options.paretoMetric] << ":" << std::endl;
+
+		for (const Evaluation* evaluation : frontier) {
+			char line[160];
+			snprintf(line, sizeof(line), "  %10.2f Mpixel/s  %8.3f %s  %s window %d disparities %d",
+				size / evaluation->bestMs / 1e3, paretoError(evaluation->errors, options.paretoMetric),
+				metricNames[options.paretoMetric], evaluation->stage.c_str(), evaluation->window, evaluation->disparities);
+			std::cout << line << std::endl;
+		}
+
+		std::cout << std::endl;
+	}
+
+	if (!writeEvaluationJson(options.jsonFile, evaluations)) {
+		std::cout << "Failed to write " << options.jsonFile << std::endl;
+		return -1;
+	}
+
+	return 0;
+}
+
+bool writeEvaluationJson(const char* filename, const std::vector<Evaluation>& evaluations) {
+	std::ofstream out(filename);
+	if (!out) return false;
+
+	out << "{\n  \"evaluations\": [";
+
+	char line[640];
+
+	for (size_t i = 0; i < evaluations.size(); i++) {
+		const Evaluation& evaluation = evaluations[i];
+		const double pixels = (double)evaluation.width * evaluation.height;
+
+		snprintf(line, sizeof(line),
+			"%s\n    {\"input\": \"%s\", \"stage\": \"%s\", \"width\": %u, \"height\": %u, \"window\": %d, \"disparities\": %d,"
+			" \"bestMs\": %.4f, \"mpixelsPerSecond\": %.4f, \"pixels\": %zu, \"bad1\": %.4f, \"bad2\": %.4f, \"bad4\": %.4f,"
+			" \"meanError\": %.5f, \"rmse\": %.5f, \"pareto\": %s}",
+			i ? "," : "", evaluation.input.c_str(), evaluation.stage.c_str(), evaluation.width, evaluation.height,
+			evaluation.window, evaluation.disparities, evaluation.bestMs, pixels / evaluation.bestMs / 1e3,
+			evaluation.errors.pixels, evaluation.errors.bad[0], evaluation.errors.bad[1], evaluation.errors.bad[2],
+			evaluation.errors.meanError, evaluation.errors.rmse, evaluation.pareto ? "true" : "false");
+
+		out << line;
+	}
+
+	out << "\n  ]\n}\n";
+
+	return (bool)out;
+}
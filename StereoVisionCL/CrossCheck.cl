@@ -1,3 +1,6 @@
+/*
+Keeps the left to right disparity where both maps agree within the threshold, 0 elsewhere, like the CPU crossChecking.
+*/
 __kernel void CrossCheck(
 	__global uint* leftDisp, 
 	__global uint* rightDisp, 
@@ -7,20 +10,10 @@ __kernel void CrossCheck(
 	size_t i = get_global_id(0);
 
 	int diff = leftDisp[i] - rightDisp[i];
-	if (diff >= 0) { // leftDisp is winner
-		if (diff <= crossCheckingThreshold) {
-			result[i] = leftDisp[i];
-		}
-		else {
-			result[i] = 0;
-		}
-	} else { //  rightDisp is winner
-		if (-diff <= crossCheckingThreshold) {
-			result[i] = rightDisp[i];
-		}
-		else {
-			result[i] = 0;
-		}
-
+	if (abs(diff) <= crossCheckingThreshold) {
+		result[i] = leftDisp[i];
+	}
+	else {
+		result[i] = 0;
 	}
-}
\ No newline at end of file
+}
@@ -1,8 +1,8 @@
 __kernel void ScaleAndGray(
 	__global uchar* lOrig,
 	__global uchar* rOrig,
-	__global uint* lGray, 
-	__global uint* rGray, 
+	__global uchar* lGray, 
+	__global uchar* rGray, 
 	uint width, 
 	uint height, 
 	int scaleFactor
@@ -24,4 +24,45 @@ __kernel void ScaleAndGray(
 		0.3 * rOrig[x * (4 * width) + 4 * y] + 
 		0.59 * rOrig[x * (4 * width) + 4 * y + 1] + 
 		0.11 * rOrig[x * (4 * width) + 4 * y + 2];
-}
\ No newline at end of file
+}
+
+// Pixel coordinates, reads between pixels blend them
+__constant sampler_t scaleSampler = CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP_TO_EDGE | CLK_FILTER_LINEAR;
+
+/*
+ScaleAndGray on images: the RGBA images are CL_RGBA, CL_UNORM_INT8 images and the gray images CL_R, CL_UNORM_INT8 ones.
+* Every gray pixel is the average of its box of scaleFactor x scaleFactor pixels, where ScaleAndGray takes one pixel.
+* The linear sampler returns the average of 2 x 2 pixels when read at the corner between them, so a box takes
+  (scaleFactor / 2)^2 reads. The last row and column of an odd scaleFactor are read at the centers of their pixels,
+  weighted by the number of pixels each read covers.
+*/
+__kernel void ScaleAndGrayImage(
+	__read_only image2d_t lOrig,
+	__read_only image2d_t rOrig,
+	__write_only image2d_t lGray,
+	__write_only image2d_t rGray,
+	int scaleFactor
+) {
+	int i = get_global_id(0);
+	int j = get_global_id(1);
+
+	float4 left = 0;
+	float4 right = 0;
+
+	for (int y = 0; y < scaleFactor; y += 2) {
+		int rows = min(2, scaleFactor - y);
+
+		for (int x = 0; x < scaleFactor; x += 2) {
+			int columns = min(2, scaleFactor - x);
+			float2 coord = (float2)(scaleFactor * j + x + columns * 0.5f, scaleFactor * i + y + rows * 0.5f);
+
+			left += (float)(rows * columns) * read_imagef(lOrig, scaleSampler, coord);
+			right += (float)(rows * columns) * read_imagef(rOrig, scaleSampler, coord);
+		}
+	}
+
+	float4 weights = (float4)(0.3f, 0.59f, 0.11f, 0) / (scaleFactor * scaleFactor);
+
+	write_imagef(lGray, (int2)(j, i), (float4)(dot(left, weights)));
+	write_imagef(rGray, (int2)(j, i), (float4)(dot(right, weights)));
+}
@@ -1,8 +1,206 @@
+// Sum of the lanes of v
+inline int sum16(int16 v) {
+	int8 v8 = v.lo + v.hi;
+	int4 v4 = v8.lo + v8.hi;
+	int2 v2 = v4.lo + v4.hi;
+
+	return v2.x + v2.y;
+}
+
+/*
+Best disparity of a pixel whose windows are inside the image at every disparity, so no sample needs a border check.
+* The window rows are loaded 16 columns at a time with vload16, the lanes past the window are masked out,
+  which needs up to 15 more columns in the image after the window.
+* The sums are ints, exact where float sums of large windows round.
+* The left window doesn't move with the disparity, its mean and deviation are computed once.
+*/
+float bestDisparityInside(
+	__global uchar* leftPixels,
+	__global uchar* rightPixels,
+	uint width,
+	int i,
+	int j,
+	int minDisp,
+	int maxDisp,
+	int windowWidth,
+	int windowHeight
+) {
+	uint windowSize = windowWidth * windowHeight;
+
+	// The window spans rows and columns -window / 2 to window / 2 - 1 around the pixel
+	int windowColumns = windowWidth / 2 * 2;
+	int16 lanes = (int16)(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+	int sumL = 0;
+
+	for (int x = -windowHeight / 2; x < windowHeight / 2; x++) {
+		__global uchar* leftRow = leftPixels + (i + x) * width + j - windowWidth / 2;
+
+		for (int c = 0; c < windowColumns; c += 16) {
+			int16 mask = lanes < windowColumns - c;
+			sumL += sum16(convert_int16(vload16(0, leftRow + c)) & mask);
+		}
+	}
+
+	float meanLBlock = (float)sumL / windowSize;
+	int16 stdLLanes = 0;
+
+	for (int x = -windowHeight / 2; x < windowHeight / 2; x++) {
+		__global uchar* leftRow = leftPixels + (i + x) * width + j - windowWidth / 2;
+
+		for (int c = 0; c < windowColumns; c += 16) {
+			int16 mask = lanes < windowColumns - c;
+			int16 centerL = convert_int16(convert_float16(vload16(0, leftRow + c)) - meanLBlock) & mask;
+
+			stdLLanes += centerL * centerL;
+		}
+	}
+
+	int stdLBlock = sum16(stdLLanes);
+
+	float bestDisparity = maxDisp;
+	float bestZncc = -1;
+
+	for (int d = minDisp; d <= maxDisp; d++) {
+		int sumR = 0;
+
+		for (int x = -windowHeight / 2; x < windowHeight / 2; x++) {
+			__global uchar* rightRow = rightPixels + (i + x) * width + j - windowWidth / 2 - d;
+
+			for (int c = 0; c < windowColumns; c += 16) {
+				int16 mask = lanes < windowColumns - c;
+				sumR += sum16(convert_int16(vload16(0, rightRow + c)) & mask);
+			}
+		}
+
+		float meanRBlock = (float)sumR / windowSize;
+		int16 stdRLanes = 0, znccLanes = 0;
+
+		for (int x = -windowHeight / 2; x < windowHeight / 2; x++) {
+			__global uchar* leftRow = leftPixels + (i + x) * width + j - windowWidth / 2;
+			__global uchar* rightRow = rightPixels + (i + x) * width + j - windowWidth / 2 - d;
+
+			for (int c = 0; c < windowColumns; c += 16) {
+				int16 mask = lanes < windowColumns - c;
+				int16 centerL = convert_int16(convert_float16(vload16(0, leftRow + c)) - meanLBlock) & mask;
+				int16 centerR = convert_int16(convert_float16(vload16(0, rightRow + c)) - meanRBlock) & mask;
+
+				stdRLanes += centerR * centerR;
+				znccLanes += centerL * centerR;
+			}
+		}
+
+		float currentZncc = sum16(znccLanes) / (sqrt((float)stdLBlock) * sqrt((float)sum16(stdRLanes)));
+
+		// Selecting best disparity
+		if (currentZncc > bestZncc) {
+			bestZncc = currentZncc;
+			bestDisparity = d;
+		}
+	}
+
+	return bestDisparity;
+}
+
+/*
+Best disparity of a pixel whose windows cross the image borders, one sample at a time with the border checks.
+*/
+float bestDisparityAtBorder(
+	__global uchar* leftPixels,
+	__global uchar* rightPixels,
+	uint width,
+	uint height,
+	int i,
+	int j,
+	int minDisp,
+	int maxDisp,
+	int windowWidth,
+	int windowHeight
+) {
+	uint windowSize = windowWidth * windowHeight;
+
+	float bestDisparity = maxDisp;
+	float bestZncc = -1;
+
+	// Select the best disparity value for the current pixel
+	for (int d = minDisp; d <= maxDisp; d++) {
+		// Calculating mean of blocks using the sliding window method
+		int sumL = 0, sumR = 0;
+
+		for (int x = -windowHeight / 2; x < windowHeight / 2; x++) {
+			for (int y = -windowWidth / 2; y < windowWidth / 2; y++) {
+				// Check for image borders
+				if (
+					!(i + x >= 0) ||
+					!(i + x < (int)height) ||
+					!(j + y >= 0) ||
+					!(j + y < (int)width) ||
+					!(j + y - d >= 0) ||
+					!(j + y - d < (int)width)
+					) {
+					continue;
+				}
+
+				sumL += leftPixels[(i + x) * width + (j + y)];
+				sumR += rightPixels[(i + x) * width + (j + y - d)];
+			}
+		}
+
+		float meanLBlock = (float)sumL / windowSize;
+		float meanRBlock = (float)sumR / windowSize;
+
+		// Calculate ZNCC for current disparity value
+		int stdLBlock = 0, stdRBlock = 0;
+		int currentZncc = 0;
+
+		for (int x = -windowHeight / 2; x < windowHeight / 2; x++) {
+			for (int y = -windowWidth / 2; y < windowWidth / 2; y++) {
+				// Check for image borders
+				if (
+					!(i + x >= 0) ||
+					!(i + x < (int)height) ||
+					!(j + y >= 0) ||
+					!(j + y < (int)width) ||
+					!(j + y - d >= 0) ||
+					!(j + y - d < (int)width)
+					) {
+					continue;
+				}
+
+				int centerL = leftPixels[(i + x) * width + (j + y)] - meanLBlock;
+				int centerR = rightPixels[(i + x) * width + (j + y - d)] - meanRBlock;
+
+				// standard deviation
+				stdLBlock += centerL * centerL;
+				stdRBlock += centerR * centerR;
+
+				currentZncc += centerL * centerR;
+			}
+		}
+
+		float zncc = currentZncc / (sqrt((float)stdLBlock) * sqrt((float)stdRBlock));
+
+		// Selecting best disparity
+		if (zncc > bestZncc) {
+			bestZncc = zncc;
+			bestDisparity = d;
+		}
+	}
+
+	return bestDisparity;
+}
+
+/*
+Zncc of one pixel per work-item, one disparity map per launch like the CPU zncc
+(the right to left map swaps the images and searches -maxDisp to 0).
+* The gray images are 8 bit. The pixels away from the borders load their windows 16 samples at a time,
+  see bestDisparityInside, the others check every sample against the borders.
+* The global size is rounded up to whole work-groups, the work-items outside the image do nothing.
+*/
 __kernel void Zncc(
-	__global uint* leftPixels, 
-	__global uint* rightPixels, 
-	__global uint* dispLRMap, 
-	__global uint* dispRLMap, 
+	__global uchar* leftPixels, 
+	__global uchar* rightPixels, 
+	__global uint* dispMap, 
 	uint width, 
 	uint height, 
 	int minDisp, 
@@ -10,111 +208,276 @@ __kernel void Zncc(
 	int windowWidth,
 	int windowHeight
 ) {
+	int i = get_global_id(0);
+	int j = get_global_id(1);
+
+	if (i >= (int)height || j >= (int)width) {
+		return;
+	}
+
+	// The rows of the windows, and the columns of the windows at every disparity plus the columns vload16 reads past them
+	int firstColumn = j - windowWidth / 2;
+	int loadedColumns = (windowWidth / 2 * 2 + 15) / 16 * 16;
+
+	bool inside =
+		i - windowHeight / 2 >= 0 &&
+		i + windowHeight / 2 <= (int)height &&
+		firstColumn - max(maxDisp, 0) >= 0 &&
+		firstColumn - min(minDisp, 0) + loadedColumns <= (int)width;
+
+	float bestDisparity = inside ?
+		bestDisparityInside(leftPixels, rightPixels, width, i, j, minDisp, maxDisp, windowWidth, windowHeight) :
+		bestDisparityAtBorder(leftPixels, rightPixels, width, height, i, j, minDisp, maxDisp, windowWidth, windowHeight);
+
+	dispMap[i * width + j] = (uint) fabs(bestDisparity);
+}
+
+// Pixel coordinates without filtering, the samples outside the image are skipped by the border checks
+__constant sampler_t graySampler = CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP_TO_EDGE | CLK_FILTER_NEAREST;
+
+// Gray value of a CL_R, CL_UNORM_INT8 image, 0 to 255 like the gray buffers
+inline int grayAt(__read_only image2d_t image, int row, int column) {
+	return convert_int_rte(read_imagef(image, graySampler, (int2)(column, row)).x * 255);
+}
+
+/*
+Zncc on gray images of CL_R, CL_UNORM_INT8 (see ScaleAndGrayImage), same arguments and results as Zncc otherwise.
+* The windows are read through the image path, whose cache holds 2D neighbourhoods, so the rows above and below
+  a sample are as close to it as its columns.
+* Every sample is checked against the borders like bestDisparityAtBorder.
+*/
+__kernel void ZnccImage(
+	__read_only image2d_t leftPixels,
+	__read_only image2d_t rightPixels,
+	__global uint* dispMap,
+	uint width,
+	uint height,
+	int minDisp,
+	int maxDisp,
+	int windowWidth,
+	int windowHeight
+) {
+	int i = get_global_id(0);
+	int j = get_global_id(1);
+
+	if (i >= (int)height || j >= (int)width) {
+		return;
+	}
+
 	uint windowSize = windowWidth * windowHeight;
 
-	size_t gi = get_global_id(0);
-	size_t gj = get_global_id(1);
-
-	size_t h = get_global_size(0);
-	size_t w = get_global_size(1);
-
-	float l_bestDisparity = maxDisp;
-	float l_bestZncc = -1;
-	float r_bestDisparity = minDisp;
-	float r_bestZncc = -1;
-
-	for (int i = gi; i < height; i += h) {
-		for (int j = gj; j < width; j += w) {
-			// Select the best disparity value for the current pixel
-			for (int d = minDisp; d <= maxDisp; d++) {
-				int l_d = d;
-				int r_d = -d;
-
-				// Calculating mean of blocks using the sliding window method
-				float l_meanLBlock = 0, l_meanRBlock = 0, r_meanLBlock = 0, r_meanRBlock = 0;
-
-				for (int x = -windowHeight / 2; x < windowHeight / 2; x++) {
-					for (int y = -windowWidth / 2; y < windowWidth / 2; y++) {
-						// Check for image borders
-						if (
-							!(i + x >= 0) ||
-							!(i + x < height) ||
-							!(j + y >= 0) ||
-							!(j + y < width) ||
-							!(j + y - l_d >= 0) ||
-							!(j + y - r_d >= 0) ||
-							!(j + y - l_d < width) ||
-							!(j + y - r_d < width)
-							) {
-							continue;
-						}
-
-						l_meanLBlock += leftPixels[(i + x) * width + (j + y)];
-						l_meanRBlock += rightPixels[(i + x) * width + (j + y - l_d)];
-						r_meanLBlock += rightPixels[(i + x) * width + (j + y)];
-						r_meanRBlock += leftPixels[(i + x) * width + (j + y - r_d)];
-					}
+	float bestDisparity = maxDisp;
+	float bestZncc = -1;
+
+	// Select the best disparity value for the current pixel
+	for (int d = minDisp; d <= maxDisp; d++) {
+		// Calculating mean of blocks using the sliding window method
+		int sumL = 0, sumR = 0;
+
+		for (int x = -windowHeight / 2; x < windowHeight / 2; x++) {
+			for (int y = -windowWidth / 2; y < windowWidth / 2; y++) {
+				// Check for image borders
+				if (
+					!(i + x >= 0) ||
+					!(i + x < (int)height) ||
+					!(j + y >= 0) ||
+					!(j + y < (int)width) ||
+					!(j + y - d >= 0) ||
+					!(j + y - d < (int)width)
+					) {
+					continue;
 				}
 
-				l_meanLBlock /= windowSize;
-				l_meanRBlock /= windowSize;
-				r_meanLBlock /= windowSize;
-				r_meanRBlock /= windowSize;
-
-				// Calculate ZNCC for current disparity value
-				float l_stdLBlock = 0, l_stdRBlock = 0, r_stdLBlock = 0, r_stdRBlock = 0;
-				float l_currentZncc = 0, r_currentZncc = 0;
-
-				for (int x = -windowHeight / 2; x < windowHeight / 2; x++) {
-					for (int y = -windowWidth / 2; y < windowWidth / 2; y++) {
-						// Check for image borders
-						if (
-							!(i + x >= 0) ||
-							!(i + x < height) ||
-							!(j + y >= 0) ||
-							!(j + y < width) ||
-							!(j + y - l_d >= 0) ||
-							!(j + y - r_d >= 0) ||
-							!(j + y - l_d < width) ||
-							!(j + y - r_d < width)
-							) {
-							continue;
-						}
-
-						int l_centerL = leftPixels[(i + x) * width + (j + y)] - l_meanLBlock;
-						int l_centerR = rightPixels[(i + x) * width + (j + y - l_d)] - l_meanRBlock;
-						int r_centerL = rightPixels[(i + x) * width + (j + y)] - r_meanLBlock;
-						int r_centerR = leftPixels[(i + x) * width + (j + y - r_d)] - r_meanRBlock;
-
-						// standard deviation
-						l_stdLBlock += l_centerL * l_centerL;
-						l_stdRBlock += l_centerR * l_centerR;
-
-						l_currentZncc += l_centerL * l_centerR;
-
-						r_stdLBlock += r_centerL * r_centerL;
-						r_stdRBlock += r_centerR * r_centerR;
-
-						r_currentZncc += r_centerL * r_centerR;
-					}
+				sumL += grayAt(leftPixels, i + x, j + y);
+				sumR += grayAt(rightPixels, i + x, j + y - d);
+			}
+		}
+
+		float meanLBlock = (float)sumL / windowSize;
+		float meanRBlock = (float)sumR / windowSize;
+
+		// Calculate ZNCC for current disparity value
+		int stdLBlock = 0, stdRBlock = 0;
+		int currentZncc = 0;
+
+		for (int x = -windowHeight / 2; x < windowHeight / 2; x++) {
+			for (int y = -windowWidth / 2; y < windowWidth / 2; y++) {
+				// Check for image borders
+				if (
+					!(i + x >= 0) ||
+					!(i + x < (int)height) ||
+					!(j + y >= 0) ||
+					!(j + y < (int)width) ||
+					!(j + y - d >= 0) ||
+					!(j + y - d < (int)width)
+					) {
+					continue;
 				}
 
-				l_currentZncc /= native_sqrt(l_stdLBlock) * native_sqrt(l_stdRBlock);
-				r_currentZncc /= native_sqrt(r_stdLBlock) * native_sqrt(r_stdRBlock);
+				int centerL = grayAt(leftPixels, i + x, j + y) - meanLBlock;
+				int centerR = grayAt(rightPixels, i + x, j + y - d) - meanRBlock;
+
+				// standard deviation
+				stdLBlock += centerL * centerL;
+				stdRBlock += centerR * centerR;
+
+				currentZncc += centerL * centerR;
+			}
+		}
+
+		float zncc = currentZncc / (sqrt((float)stdLBlock) * sqrt((float)stdRBlock));
+
+		// Selecting best disparity
+		if (zncc > bestZncc) {
+			bestZncc = zncc;
+			bestDisparity = d;
+		}
+	}
+
+	dispMap[i * width + j] = (uint) fabs(bestDisparity);
+}
+
+/*
+Zncc with the window samples in local memory, same arguments and results as Zncc plus the two local buffers.
+* The gray images and the tiles are 8 bit, the sums ints like Zncc.
+* Every work-group computes a tile of get_local_size(0) rows and get_local_size(1) columns. Its work-items first
+  load the left tile with the window halo into leftTile and the right strip the disparities slide over into rightTile,
+  then every disparity is evaluated from local memory.
+* leftTile holds (tile height + windowHeight - 1) x (tile width + windowWidth - 1) values,
+  rightTile as many rows of maxDisp - minDisp more values.
+* The global size is rounded up to whole tiles, the work-items outside the image only help loading.
+*/
+__kernel void ZnccTiled(
+	__global uchar* leftPixels,
+	__global uchar* rightPixels,
+	__global uint* dispMap,
+	uint width,
+	uint height,
+	int minDisp,
+	int maxDisp,
+	int windowWidth,
+	int windowHeight,
+	__local uchar* leftTile,
+	__local uchar* rightTile
+) {
+	uint windowSize = windowWidth * windowHeight;
+
+	int tileHeight = get_local_size(0);
+	int tileWidth = get_local_size(1);
+
+	int li = get_local_id(0);
+	int lj = get_local_id(1);
+
+	int i = get_global_id(0);
+	int j = get_global_id(1);
+
+	// Image position of the first tile values
+	int top = get_group_id(0) * tileHeight - windowHeight / 2;
+	int leftColumn = get_group_id(1) * tileWidth - windowWidth / 2;
+	int rightColumn = leftColumn - maxDisp;
+
+	int rows = tileHeight + windowHeight - 1;
+	int leftStride = tileWidth + windowWidth - 1;
+	int rightStride = leftStride + maxDisp - minDisp;
+
+	// Cooperative load, the values outside the image are never read below
+	int localId = li * tileWidth + lj;
+	int localSize = tileHeight * tileWidth;
+
+	for (int k = localId; k < rows * leftStride; k += localSize) {
+		int y = top + k / leftStride;
+		int x = leftColumn + k % leftStride;
+
+		leftTile[k] = y >= 0 && y < (int)height && x >= 0 && x < (int)width ? leftPixels[y * width + x] : 0;
+	}
+
+	for (int k = localId; k < rows * rightStride; k += localSize) {
+		int y = top + k / rightStride;
+		int x = rightColumn + k % rightStride;
+
+		rightTile[k] = y >= 0 && y < (int)height && x >= 0 && x < (int)width ? rightPixels[y * width + x] : 0;
+	}
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	if (i >= (int)height || j >= (int)width) {
+		return;
+	}
 
-				// Selecting best disparity
-				if (l_currentZncc > l_bestZncc) {
-					l_bestZncc = l_currentZncc;
-					l_bestDisparity = l_d;
+	float bestDisparity = maxDisp;
+	float bestZncc = -1;
+
+	// Select the best disparity value for the current pixel
+	for (int d = minDisp; d <= maxDisp; d++) {
+		// Calculating mean of blocks using the sliding window method
+		int sumL = 0, sumR = 0;
+
+		for (int x = -windowHeight / 2; x < windowHeight / 2; x++) {
+			// Centered on the current pixel and its match at disparity d
+			__local uchar* leftRow = &leftTile[(li + x + windowHeight / 2) * leftStride + lj + windowWidth / 2];
+			__local uchar* rightRow = &rightTile[(li + x + windowHeight / 2) * rightStride + lj + windowWidth / 2 + maxDisp - d];
+
+			for (int y = -windowWidth / 2; y < windowWidth / 2; y++) {
+				// Check for image borders
+				if (
+					!(i + x >= 0) ||
+					!(i + x < (int)height) ||
+					!(j + y >= 0) ||
+					!(j + y < (int)width) ||
+					!(j + y - d >= 0) ||
+					!(j + y - d < (int)width)
+					) {
+					continue;
 				}
-				if (r_currentZncc > r_bestZncc) {
-					r_bestZncc = r_currentZncc;
-					r_bestDisparity = r_d;
+
+				sumL += leftRow[y];
+				sumR += rightRow[y];
+			}
+		}
+
+		float meanLBlock = (float)sumL / windowSize;
+		float meanRBlock = (float)sumR / windowSize;
+
+		// Calculate ZNCC for current disparity value
+		int stdLBlock = 0, stdRBlock = 0;
+		int currentZncc = 0;
+
+		for (int x = -windowHeight / 2; x < windowHeight / 2; x++) {
+			__local uchar* leftRow = &leftTile[(li + x + windowHeight / 2) * leftStride + lj + windowWidth / 2];
+			__local uchar* rightRow = &rightTile[(li + x + windowHeight / 2) * rightStride + lj + windowWidth / 2 + maxDisp - d];
+
+			for (int y = -windowWidth / 2; y < windowWidth / 2; y++) {
+				// Check for image borders
+				if (
+					!(i + x >= 0) ||
+					!(i + x < (int)height) ||
+					!(j + y >= 0) ||
+					!(j + y < (int)width) ||
+					!(j + y - d >= 0) ||
+					!(j + y - d < (int)width)
+					) {
+					continue;
 				}
+
+				int centerL = leftRow[y] - meanLBlock;
+				int centerR = rightRow[y] - meanRBlock;
+
+				// standard deviation
+				stdLBlock += centerL * centerL;
+				stdRBlock += centerR * centerR;
+
+				currentZncc += centerL * centerR;
 			}
 		}
+
+		float zncc = currentZncc / (sqrt((float)stdLBlock) * sqrt((float)stdRBlock));
+
+		// Selecting best disparity
+		if (zncc > bestZncc) {
+			bestZncc = zncc;
+			bestDisparity = d;
+		}
 	}
 
-	dispLRMap[gi * width + gj] = (uint) fabs(l_bestDisparity);
-	dispRLMap[gi * width + gj] = (uint) fabs(r_bestDisparity);
-}
\ No newline at end of file
+	dispMap[i * width + j] = (uint) fabs(bestDisparity);
+}
@@ -0,0 +1,61 @@
+#include "cl_bands.h"
+
+#include <algorithm>
+
+#include "cl_call.h"
+
+ZnccBand::ZnccBand(
+	const cl::Context& context,
+	const cl::Device& device,
+	const cl::Program& program,
+	const bool tiled,
+	const int windowWidth,
+	const int windowHeight,
+	const int maxDisp,
+	const unsigned width,
+	const unsigned height,
+	const unsigned firstRow,
+	const unsigned rows
+) : m_Device(device), m_Zncc(program, device, tiled, false, windowWidth, windowHeight, maxDisp),
+	m_Width(width), m_FirstRow(firstRow), m_Rows(rows) {
+	// The windows span rows -windowHeight / 2 to windowHeight / 2 - 1 around their pixel
+	const unsigned halo = windowHeight / 2;
+
+	m_Top = firstRow > halo ? firstRow - halo : 0;
+	m_BandRows = std::min(height, firstRow + rows + halo) - m_Top;
+
+	const size_t grayBytes = sizeof(cl_uchar) * width * m_BandRows;
+	const size_t mapBytes = sizeof(cl_uint) * width * m_BandRows;
+
+	m_GrayL = cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, grayBytes);
+	m_GrayR = cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, grayBytes);
+	m_DispLR = cl::Buffer(context, CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY, mapBytes);
+	m_DispRL = cl::Buffer(context, CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY, mapBytes);
+
+	m_Zncc.setArgs(m_GrayL, m_GrayR, m_DispLR, m_DispRL, width, m_BandRows);
+
+	m_Queue = cl::CommandQueue(context, device, CL_QUEUE_PROFILING_ENABLE);
+}
+
+void ZnccBand::enqueue(const unsigned char* grayL, const unsigned char* grayR, unsigned* dispLR, unsigned* dispRL) {
+	const size_t bandBytes = sizeof(cl_uchar) * m_Width * m_BandRows;
+	const size_t rowsBytes = sizeof(cl_uint) * m_Width * m_Rows;
+	// The band starts below the halo above it
+	const size_t haloBytes = sizeof(cl_uint) * m_Width * (m_FirstRow - m_Top);
+
+	m_Events.assign(6, cl::Event());
+
+	CLCall(m_Queue.enqueueWriteBuffer(m_GrayL, CL_FALSE, 0, bandBytes, grayL + m_Width * m_Top, nullptr, &m_Events[0]));
+	CLCall(m_Queue.enqueueWriteBuffer(m_GrayR, CL_FALSE, 0, bandBytes, grayR + m_Width * m_Top, nullptr, &m_Events[1]));
+
+	m_Zncc.enqueue(m_Queue, nullptr, &m_Events[2], &m_Events[3]);
+
+	CLCall(m_Queue.enqueueReadBuffer(m_DispLR, CL_FALSE, haloBytes, rowsBytes, dispLR + m_Width * m_FirstRow, nullptr, &m_Events[4]));
+	CLCall(m_Queue.enqueueReadBuffer(m_DispRL, CL_FALSE, haloBytes, rowsBytes, dispRL + m_Width * m_FirstRow, nullptr, &m_Events[5]));
+
+	CLCall(m_Queue.flush());
+}
+
+void ZnccBand::finish() {
+	CLCall(m_Queue.finish());
+}
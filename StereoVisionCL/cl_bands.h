@@ -0,0 +1,53 @@
+#pragma once
+
+#include <CL/cl.hpp>
+#include <vector>
+
+#include "cl_zncc.h"
+
+/*
+The disparity maps of a band of rows, so Zncc can be split over several devices, one band each.
+* The band is computed with windowHeight / 2 rows of the gray images above and below it (its halo), which the
+  windows of its edge pixels cover, so its maps equal those rows of the maps of the whole image.
+* The gray images are written from and the maps read to host memory, without waiting: enqueue every band,
+  then finish them, so the devices run at the same time.
+*/
+class ZnccBand {
+private:
+	cl::Device m_Device;
+	cl::CommandQueue m_Queue;
+	ZnccKernels m_Zncc;
+	cl::Buffer m_GrayL, m_GrayR, m_DispLR, m_DispRL;
+	unsigned m_Width;
+	unsigned m_FirstRow, m_Rows;
+	// First row and number of rows with the halo
+	unsigned m_Top, m_BandRows;
+	std::vector<cl::Event> m_Events;
+
+public:
+	ZnccBand(
+		const cl::Context& context,
+		const cl::Device& device,
+		const cl::Program& program,
+		const bool tiled,
+		const int windowWidth,
+		const int windowHeight,
+		const int maxDisp,
+		const unsigned width,
+		const unsigned height,
+		const unsigned firstRow,
+		const unsigned rows
+	);
+
+	// The host images are width x height with 8 bit gray values, only the rows of the band are written to the maps
+	void enqueue(const unsigned char* grayL, const unsigned char* grayR, unsigned* dispLR, unsigned* dispRL);
+	void finish();
+
+	inline const cl::Device& Device() const { return m_Device; }
+	inline unsigned FirstRow() const { return m_FirstRow; }
+	inline unsigned Rows() const { return m_Rows; }
+	inline const ZnccKernels& Zncc() const { return m_Zncc; }
+
+	// Events of the last enqueue, from the first write to the last read
+	inline const std::vector<cl::Event>& Events() const { return m_Events; }
+};
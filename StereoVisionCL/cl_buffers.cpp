@@ -0,0 +1,131 @@
+#include "cl_buffers.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include "cl_call.h"
+
+// Alignment of the host memory and granularity of its size, what zero-copy needs on Intel and AMD runtimes
+constexpr size_t pageSize = 4096;
+constexpr size_t cacheLineSize = 64;
+
+PageMemory::PageMemory(const size_t size) : m_Size((size + cacheLineSize - 1) / cacheLineSize * cacheLineSize) {
+#ifdef _WIN32
+	m_Data = _aligned_malloc(m_Size, pageSize);
+#else
+	if (posix_memalign(&m_Data, pageSize, m_Size)) {
+		m_Data = nullptr;
+	}
+#endif
+
+	if (!m_Data) {
+		throw std::bad_alloc();
+	}
+}
+
+PageMemory::~PageMemory() {
+#ifdef _WIN32
+	_aligned_free(m_Data);
+#else
+	free(m_Data);
+#endif
+}
+
+bool useZeroCopy(const cl::Device& device, const BufferStrategy strategy) {
+	if (strategy == BufferStrategy::Auto) {
+		return device.getInfo<CL_DEVICE_HOST_UNIFIED_MEMORY>();
+	}
+
+	return strategy == BufferStrategy::ZeroCopy;
+}
+
+void uploadBuffer(const cl::CommandQueue& queue, const cl::Buffer& buffer, const void* data, const size_t size,
+	const bool zeroCopy, std::vector<cl::Event>& events) {
+	if (!zeroCopy) {
+		events.emplace_back();
+		CLCall(queue.enqueueWriteBuffer(buffer, CL_FALSE, 0, size, data, nullptr, &events.back()));
+		return;
+	}
+
+	// The old contents are not needed, so the runtime doesn't have to copy them to the mapping
+	cl::Event mapEvent, unmapEvent;
+	void* mapping = queue.enqueueMapBuffer(buffer, CL_TRUE, CL_MAP_WRITE_INVALIDATE_REGION, 0, size, nullptr, &mapEvent, &err);
+	CLCall(err);
+	if (!mapping) {
+		return;
+	}
+
+	memcpy(mapping, data, size);
+	CLCall(queue.enqueueUnmapMemObject(buffer, mapping, nullptr, &unmapEvent));
+
+	events.push_back(mapEvent);
+	events.push_back(unmapEvent);
+}
+
+void* enqueueReadback(const cl::CommandQueue& queue, const cl::Buffer& buffer, void* data, const size_t size,
+	const bool zeroCopy, const std::vector<cl::Event>* waitEvents, std::vector<cl::Event>& events) {
+	events.emplace_back();
+
+	if (!zeroCopy) {
+		CLCall(queue.enqueueReadBuffer(buffer, CL_FALSE, 0, size, data, waitEvents, &events.back()));
+		return nullptr;
+	}
+
+	void* mapping = queue.enqueueMapBuffer(buffer, CL_FALSE, CL_MAP_READ, 0, size, waitEvents, &events.back(), &err);
+	CLCall(err);
+
+	return mapping;
+}
+
+void finishReadback(const cl::CommandQueue& queue, const cl::Buffer& buffer, void* mapping, void* data, const size_t size,
+	std::vector<cl::Event>& events) {
+	CLCall(events.back().wait());
+
+	if (!mapping) {
+		return;
+	}
+
+	memcpy(data, mapping, size);
+
+	events.emplace_back();
+	CLCall(queue.enqueueUnmapMemObject(buffer, mapping, nullptr, &events.back()));
+	CLCall(events.back().wait());
+}
+
+bool supportsGrayImages(const cl::Context& context, const cl::Device& device) {
+	if (!device.getInfo<CL_DEVICE_IMAGE_SUPPORT>()) {
+		return false;
+	}
+
+	std::vector<cl::ImageFormat> inputFormats, grayFormats;
+	CLCall(context.getSupportedImageFormats(CL_MEM_READ_ONLY, CL_MEM_OBJECT_IMAGE2D, &inputFormats));
+	CLCall(context.getSupportedImageFormats(CL_MEM_READ_WRITE, CL_MEM_OBJECT_IMAGE2D, &grayFormats));
+
+	const auto hasFormat = [](const std::vector<cl::ImageFormat>& formats, const cl_channel_order order) {
+		return std::any_of(formats.begin(), formats.end(), [order](const cl::ImageFormat& format) {
+			return format.image_channel_order == order && format.image_channel_data_type == CL_UNORM_INT8;
+		});
+	};
+
+	return hasFormat(inputFormats, CL_RGBA) && hasFormat(grayFormats, CL_R);
+}
+
+cl::size_t<3> imageRegion(const size_t width, const size_t height) {
+	cl::size_t<3> region;
+	region[0] = width;
+	region[1] = height;
+	region[2] = 1;
+
+	return region;
+}
+
+void uploadImage(const cl::CommandQueue& queue, const cl::Image2D& image, const void* data, const size_t width, const size_t height,
+	std::vector<cl::Event>& events) {
+	events.emplace_back();
+
+	// The pointer of enqueueWriteImage is not const in cl.hpp, the write only reads it
+	CLCall(queue.enqueueWriteImage(image, CL_FALSE, cl::size_t<3>(), imageRegion(width, height), 0, 0,
+		const_cast<void*>(data), nullptr, &events.back()));
+}
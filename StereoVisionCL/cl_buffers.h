@@ -0,0 +1,70 @@
+#pragma once
+
+#include <CL/cl.hpp>
+#include <vector>
+
+#include "cl_options.h"
+
+/*
+Host memory aligned to pages, for CL_MEM_USE_HOST_PTR buffers.
+* Runtimes of CPUs and integrated GPUs use memory aligned to a page, and of a size multiple of a cache line, in place,
+  they copy any other host memory to memory of their own.
+*/
+class PageMemory {
+private:
+	void* m_Data;
+	size_t m_Size;
+
+public:
+	explicit PageMemory(const size_t size);
+	~PageMemory();
+
+	PageMemory(const PageMemory&) = delete;
+	PageMemory& operator=(const PageMemory&) = delete;
+
+	inline void* Data() const { return m_Data; }
+	// Rounded up to whole cache lines
+	inline size_t Size() const { return m_Size; }
+};
+
+/*
+Whether the input and output buffers are zero-copy: allocated in host memory (CL_MEM_ALLOC_HOST_PTR, CL_MEM_USE_HOST_PTR)
+and accessed by mapping them, instead of copied to and from device memory.
+* BufferStrategy::Auto is zero-copy if the device shares the memory of the host (CPUs, integrated GPUs), where
+  copies are only memcpys.
+*/
+bool useZeroCopy(const cl::Device& device, const BufferStrategy strategy);
+
+/*
+Copies size bytes of the host to the buffer, into its mapping if zeroCopy, with a write otherwise.
+* The write doesn't block, data must stay valid until the commands added to events are complete.
+*/
+void uploadBuffer(const cl::CommandQueue& queue, const cl::Buffer& buffer, const void* data, const size_t size,
+	const bool zeroCopy, std::vector<cl::Event>& events);
+
+/*
+Starts copying size bytes of the buffer to data once waitEvents are complete, finishReadback completes it.
+* Enqueues a read to data, or if zeroCopy maps the buffer and returns the mapping, without blocking either way.
+*/
+void* enqueueReadback(const cl::CommandQueue& queue, const cl::Buffer& buffer, void* data, const size_t size,
+	const bool zeroCopy, const std::vector<cl::Event>* waitEvents, std::vector<cl::Event>& events);
+
+// Waits for the readback of enqueueReadback, a mapping is copied to data and unmapped
+void finishReadback(const cl::CommandQueue& queue, const cl::Buffer& buffer, void* mapping, void* data, const size_t size,
+	std::vector<cl::Event>& events);
+
+/*
+Whether the gray images can be images (--gray images): the device supports images, and images of CL_RGBA, CL_UNORM_INT8
+for the input and of CL_R, CL_UNORM_INT8 for the gray images. Only the former format is required by OpenCL 1.2.
+*/
+bool supportsGrayImages(const cl::Context& context, const cl::Device& device);
+
+// Region of a whole image of width x height pixels for image reads and writes, from the origin cl::size_t<3>()
+cl::size_t<3> imageRegion(const size_t width, const size_t height);
+
+/*
+Copies the host image of width x height pixels to the image with a write.
+* The write doesn't block, data must stay valid until the command added to events is complete.
+*/
+void uploadImage(const cl::CommandQueue& queue, const cl::Image2D& image, const void* data, const size_t width, const size_t height,
+	std::vector<cl::Event>& events);
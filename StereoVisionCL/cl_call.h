@@ -0,0 +1,13 @@
+#pragma once
+
+#include <CL/cl.hpp>
+#include <iostream>
+
+// Result of the last CLCall, defined in main.cpp
+extern cl_int err;
+
+// Efficient error handling
+#define CLCall(x) \
+	err = x; \
+	if (err) \
+		std::cout << "Error [" << err << "]: " << __FILE__ << ":" << __LINE__ << std::endl
@@ -0,0 +1,65 @@
+#include "cl_devices.h"
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <utility>
+
+// Rank of a device type in the selection, lower is preferred
+static int typeRank(const cl_device_type type) {
+	if (type & CL_DEVICE_TYPE_GPU) {
+		return 0;
+	}
+
+	if (type & CL_DEVICE_TYPE_CPU) {
+		return 1;
+	}
+
+	return 2;
+}
+
+static const char* typeName(const cl_device_type type) {
+	const char* names[] = { "GPU", "CPU", "Other" };
+
+	return names[typeRank(type)];
+}
+
+std::vector<cl::Device> findDevices(const char* name) {
+	std::vector<cl::Platform> platforms;
+	cl::Platform::get(&platforms);
+
+	// The devices with the name of their platform
+	typedef std::pair<cl::Device, std::string> PlatformDevice;
+	std::vector<PlatformDevice> found;
+
+	for (cl::Platform& platform : platforms) {
+		std::vector<cl::Device> platformDevices;
+
+		// A platform without devices reports an error instead of an empty list
+		if (platform.getDevices(CL_DEVICE_TYPE_ALL, &platformDevices)) {
+			continue;
+		}
+
+		for (cl::Device& device : platformDevices) {
+			if (!name || device.getInfo<CL_DEVICE_NAME>().find(name) != std::string::npos) {
+				found.emplace_back(device, platform.getInfo<CL_PLATFORM_NAME>());
+			}
+		}
+	}
+
+	// Stable, so the platform order is kept within a type
+	std::stable_sort(found.begin(), found.end(), [](const PlatformDevice& a, const PlatformDevice& b) {
+		return typeRank(a.first.getInfo<CL_DEVICE_TYPE>()) < typeRank(b.first.getInfo<CL_DEVICE_TYPE>());
+	});
+
+	std::vector<cl::Device> devices;
+
+	for (const PlatformDevice& device : found) {
+		std::cout << "OpenCL Device " << devices.size() << ": " << typeName(device.first.getInfo<CL_DEVICE_TYPE>()) << " "
+			<< device.first.getInfo<CL_DEVICE_NAME>() << " (" << device.second << ")" << std::endl;
+
+		devices.push_back(device.first);
+	}
+
+	return devices;
+}
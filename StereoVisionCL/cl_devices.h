@@ -0,0 +1,12 @@
+#pragma once
+
+#include <CL/cl.hpp>
+#include <vector>
+
+/*
+Every OpenCL device of every platform, in the order they are preferred.
+* GPUs first, then CPUs, then the other types (accelerators...), in platform order within a type.
+* If name is given, only the devices whose name contains it.
+* Prints the devices found, the first one is the one the pipeline runs on.
+*/
+std::vector<cl::Device> findDevices(const char* name = nullptr);
@@ -0,0 +1,91 @@
+#include "cl_options.h"
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+
+bool parseClOptions(int& argc, char** argv, ClOptions& options) {
+	bool valid = true;
+	int kept = 1;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--zncc") && i + 1 < argc) {
+			const char* value = argv[++i];
+
+			if (!strcmp(value, "tiled")) {
+				options.tiledZncc = true;
+			} else if (!strcmp(value, "direct")) {
+				options.tiledZncc = false;
+			} else {
+				valid = false;
+			}
+		} else if (!strcmp(argv[i], "--gray") && i + 1 < argc) {
+			const char* value = argv[++i];
+
+			if (!strcmp(value, "images")) {
+				options.grayImages = true;
+			} else if (!strcmp(value, "buffers")) {
+				options.grayImages = false;
+			} else {
+				valid = false;
+			}
+		} else if (!strcmp(argv[i], "--out-of-order")) {
+			options.outOfOrder = true;
+		} else if (!strcmp(argv[i], "--program-cache") && i + 1 < argc) {
+			options.programCache = argv[++i];
+		} else if (!strcmp(argv[i], "--no-program-cache")) {
+			options.programCache = nullptr;
+		} else if (!strcmp(argv[i], "--kernel-dir") && i + 1 < argc) {
+			options.kernelDirectory = argv[++i];
+		} else if (!strcmp(argv[i], "--buffers") && i + 1 < argc) {
+			const char* value = argv[++i];
+
+			if (!strcmp(value, "auto")) {
+				options.buffers = BufferStrategy::Auto;
+			} else if (!strcmp(value, "copy")) {
+				options.buffers = BufferStrategy::Copy;
+			} else if (!strcmp(value, "zero-copy")) {
+				options.buffers = BufferStrategy::ZeroCopy;
+			} else {
+				valid = false;
+			}
+		} else if (!strcmp(argv[i], "--frames") && i + 1 < argc) {
+			int frames = atoi(argv[++i]);
+
+			if (frames > 0) {
+				options.frames = frames;
+			} else {
+				valid = false;
+			}
+		} else if (!strcmp(argv[i], "--tune")) {
+			options.tune = true;
+		} else if (!strcmp(argv[i], "--tuning-file") && i + 1 < argc) {
+			options.tuningFile = argv[++i];
+		} else if (!strcmp(argv[i], "--device") && i + 1 < argc) {
+			options.deviceName = argv[++i];
+		} else if (!strcmp(argv[i], "--split") && i + 1 < argc) {
+			const char* value = argv[++i];
+			int count = atoi(value);
+
+			if (!strcmp(value, "all")) {
+				options.split = 0;
+			} else if (count > 0) {
+				options.split = count;
+			} else {
+				valid = false;
+			}
+		} else {
+			argv[kept++] = argv[i];
+		}
+	}
+
+	argc = kept;
+
+	if (!valid) {
+		std::cout << "OpenCL options: [--zncc direct | tiled] [--gray buffers | images] [--out-of-order] [--program-cache directory | --no-program-cache]"
+			" [--kernel-dir directory] [--device name] [--split count | all] [--buffers auto | copy | zero-copy] [--frames n]"
+			" [--tune] [--tuning-file file]" << std::endl;
+	}
+
+	return valid;
+}
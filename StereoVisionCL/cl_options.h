@@ -0,0 +1,52 @@
+#pragma once
+
+// How the input and output buffers get to and from the device, see useZeroCopy
+enum class BufferStrategy {
+	Auto,
+	Copy,
+	ZeroCopy
+};
+
+/*
+Command line options of the OpenCL backend only, on top of the shared ones of backend_options.h.
+* --zncc tiled computes the disparity maps with ZnccTiled, which reads the window samples from local memory,
+  --zncc direct (default) with Zncc, which reads them from global memory.
+* --gray images uploads the RGBA images as images and keeps the gray images as images: ScaleAndGrayImage averages
+  boxes of pixels with the linear sampler and ZnccImage reads the windows through the image path, instead of ZnccTiled too.
+  The input images are always copied then. --gray buffers (default) uses the buffer kernels, as do devices without image support.
+* --out-of-order runs the stages on an out of order queue if the device has them, so the two disparity maps,
+  which only depend on the gray images, can run at the same time.
+* --program-cache directory keeps the binary of the OpenCL program in the directory (the working directory by default),
+  so later runs skip the compiler (see CLProgram). --no-program-cache always builds from source.
+* --kernel-dir directory reads the kernel files from the directory instead of the working directory.
+* --device name only uses the devices whose name contains name, see findDevices for the order they are taken in.
+* --split count computes the disparity maps on the first count devices (all of them with --split all),
+  each one a band of rows (see ZnccBand). The other stages run on the first device.
+* --buffers zero-copy maps the input and output buffers from host memory, --buffers copy writes and reads them
+  to and from device memory, --buffers auto (default) maps them if the device shares the memory of the host (see useZeroCopy).
+* --frames n processes the pair n times as a stream of frames and reports the throughput (see StereoCL).
+* --tune measures the work-groups of the kernels on the device and the images, and stores the fastest ones
+  in the tuning file (StereoVisionCL_tuning.txt by default, --tuning-file file), later runs use them (see TuningDatabase).
+*/
+
+struct ClOptions {
+	bool tiledZncc = false;
+	bool grayImages = false;
+	bool outOfOrder = false;
+	const char* programCache = ".";
+	const char* kernelDirectory = nullptr;
+	const char* deviceName = nullptr;
+	// Number of devices Zncc is split over, 0 for all of them
+	unsigned split = 1;
+	BufferStrategy buffers = BufferStrategy::Auto;
+	unsigned frames = 1;
+	bool tune = false;
+	const char* tuningFile = "StereoVisionCL_tuning.txt";
+};
+
+/*
+Takes the options of ClOptions out of argv, so the rest can go to parseBackendOptions.
+* argc is lowered by the number of arguments taken.
+* Prints the usage of the options and returns false on invalid values.
+*/
+bool parseClOptions(int& argc, char** argv, ClOptions& options);
@@ -0,0 +1,139 @@
+#include "cl_program.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+#include "cl_call.h"
+#include "profiler.h"
+
+// First line of the cache files, changing it makes the caches of older versions miss
+static const char* cacheMagic = "StereoVisionCL program binary 1";
+
+// 64 bit FNV-1a
+static uint64_t hashString(const std::string& text) {
+	uint64_t hash = 14695981039346656037ull;
+
+	for (unsigned char c : text) {
+		hash ^= c;
+		hash *= 1099511628211ull;
+	}
+
+	return hash;
+}
+
+static std::string hexString(const uint64_t value) {
+	char text[17];
+	snprintf(text, sizeof(text), "%016llx", (unsigned long long)value);
+
+	return text;
+}
+
+CLProgram::CLProgram(
+	const cl::Context& context,
+	const cl::Device& device,
+	const std::vector<std::string>& fileNames,
+	const std::string& options,
+	const char* cacheDirectory
+) {
+	ProfileZone zone("build program", true);
+
+	// Read the kernel codes, #line keeps the file names and line numbers of the build log
+	std::string src;
+
+	for (const std::string& fileName : fileNames) {
+		std::ifstream fileStream(fileName);
+		if (!fileStream) {
+			std::cout << "Failed to read " << fileName << std::endl;
+		}
+
+		src += "#line 1 \"" + fileName + "\"\n";
+		src.append(std::istreambuf_iterator<char>(fileStream), std::istreambuf_iterator<char>());
+		src += "\n";
+	}
+
+	// Everything the binary depends on, the cache file is named after its hash
+	const std::string header = std::string(cacheMagic) + "\n" +
+		hexString(hashString(src)) + "\n" +
+		device.getInfo<CL_DEVICE_NAME>() + "\n" +
+		device.getInfo<CL_DRIVER_VERSION>() + "\n" +
+		options + "\n";
+
+	if (cacheDirectory) {
+		m_CacheFile = std::string(cacheDirectory) + "/StereoVisionCL_" + hexString(hashString(header)) + ".bin";
+		m_FromCache = loadBinary(context, device, header, options);
+	}
+
+	if (m_FromCache) {
+		return;
+	}
+
+	// Load the kernel code
+	cl::Program::Sources sources(1, std::make_pair(src.c_str(), src.length() + 1));
+
+	m_Program = cl::Program(context, sources);
+
+	CLCall(m_Program.build(options.c_str()));
+
+	cl_build_status status = m_Program.getBuildInfo<CL_PROGRAM_BUILD_STATUS>(device);
+	if (status == CL_BUILD_ERROR) {
+		std::string log = m_Program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(device);
+		std::cerr << log << std::endl;
+	} else if (cacheDirectory) {
+		storeBinary(header);
+	}
+}
+
+bool CLProgram::loadBinary(const cl::Context& context, const cl::Device& device, const std::string& header, const std::string& options) {
+	std::ifstream file(m_CacheFile, std::ios::binary);
+	if (!file) {
+		return false;
+	}
+
+	std::string contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	// Another key with the same hash or a damaged file is a miss
+	if (contents.size() <= header.size() || contents.compare(0, header.size(), header)) {
+		return false;
+	}
+
+	cl::Program::Binaries binaries(1, std::make_pair(contents.data() + header.size(), contents.size() - header.size()));
+	std::vector<cl_int> binaryStatus;
+	cl_int error;
+
+	cl::Program program(context, std::vector<cl::Device>(1, device), binaries, &binaryStatus, &error);
+
+	// A binary of an older compiler may be rejected, the program is built from source then
+	if (error || binaryStatus.empty() || binaryStatus[0] || program.build(options.c_str())) {
+		return false;
+	}
+
+	m_Program = program;
+	return true;
+}
+
+void CLProgram::storeBinary(const std::string& header) {
+	// The contexts have a single device, so the program has a single binary
+	const std::vector<size_t> sizes = m_Program.getInfo<CL_PROGRAM_BINARY_SIZES>();
+	if (sizes.size() != 1 || !sizes[0]) {
+		return;
+	}
+
+	// cl.hpp's getInfo<CL_PROGRAM_BINARIES> doesn't allocate the buffers the binaries are copied to, the C API is used instead
+	std::vector<unsigned char> binary(sizes[0]);
+	unsigned char* binaries[1] = { binary.data() };
+
+	CLCall(clGetProgramInfo(m_Program(), CL_PROGRAM_BINARIES, sizeof(binaries), binaries, nullptr));
+	if (err) {
+		return;
+	}
+
+	std::ofstream file(m_CacheFile, std::ios::binary);
+	file << header;
+	file.write((const char*)binary.data(), binary.size());
+
+	if (!file) {
+		std::cout << "Failed to write " << m_CacheFile << std::endl;
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <CL/cl.hpp>
+#include <string>
+#include <vector>
+
+/*
+Class to handle multiple opencl kernel files
+* The files are merged into one program, so the compiler runs once for all the kernels.
+* With a cache directory the binary of the program is kept in it for the next runs, in a file per key:
+  the hash of the sources, the device name, the driver version and the build options.
+  A cached binary the driver rejects is rebuilt from source and replaced.
+* The build is a "build program" zone of the profiler, its time is printed like the stages of the pipeline.
+*/
+class CLProgram {
+private:
+	cl::Program m_Program;
+	bool m_FromCache = false;
+	std::string m_CacheFile;
+
+	bool loadBinary(const cl::Context& context, const cl::Device& device, const std::string& header, const std::string& options);
+	void storeBinary(const std::string& header);
+
+public:
+	CLProgram(
+		const cl::Context& context,
+		const cl::Device& device,
+		const std::vector<std::string>& fileNames,
+		const std::string& options = "-cl-std=CL1.2",
+		const char* cacheDirectory = nullptr
+	);
+
+	inline cl::Program GetProgram() { return m_Program; }
+
+	// True if the program was built from a cached binary instead of the sources
+	inline bool FromCache() const { return m_FromCache; }
+
+	// Cache file of the program, empty without a cache directory
+	inline const std::string& CacheFile() const { return m_CacheFile; }
+};
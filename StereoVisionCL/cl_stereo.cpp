@@ -0,0 +1,443 @@
+#include "cl_stereo.h"
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <functional>
+
+#include "cl_call.h"
+#include "cl_program.h"
+#include "profiler.h"
+
+// The kernel files in kernelDirectory, in the working directory without one
+static std::vector<std::string> programFiles(const char* kernelDirectory) {
+	static const char* const names[] = { "ScaleAndGray.cl", "Zncc.cl", "CrossCheck.cl", "OcclusionFill.cl" };
+
+	std::vector<std::string> files;
+	for (const char* name : names) {
+		files.push_back(kernelDirectory ? std::string(kernelDirectory) + "/" + name : std::string(name));
+	}
+
+	return files;
+}
+
+// Device time from the start of the first event to the end of the last one, which covers overlapping commands once
+static double eventSeconds(const std::vector<cl::Event>& events) {
+	cl_ulong start = ULLONG_MAX, end = 0;
+
+	for (const cl::Event& event : events) {
+		start = std::min(start, event.getProfilingInfo<CL_PROFILING_COMMAND_START>());
+		end = std::max(end, event.getProfilingInfo<CL_PROFILING_COMMAND_END>());
+	}
+
+	return (end - start) * 1e-9;
+}
+
+static void printZnccTile(const ZnccKernels& zncc) {
+	if (zncc.Tiled()) {
+		std::cout << "Zncc Tile: " << zncc.WorkGroup()[1] << "x" << zncc.WorkGroup()[0] << " (" << zncc.LocalBytes() << " bytes of local memory)" << std::endl;
+	}
+}
+
+FrameTimes& FrameTimes::operator+=(const FrameTimes& other) {
+	upload += other.upload;
+	scale += other.scale;
+	zncc += other.zncc;
+	crossCheck += other.crossCheck;
+	occlusionFill += other.occlusionFill;
+	read += other.read;
+	device += other.device;
+
+	bands.resize(std::max(bands.size(), other.bands.size()));
+	for (size_t i = 0; i < other.bands.size(); i++) {
+		bands[i] += other.bands[i];
+	}
+
+	return *this;
+}
+
+StereoCL::StereoCL(
+	const std::vector<cl::Device>& devices,
+	const BackendOptions& options,
+	const ClOptions& clOptions,
+	const unsigned imageWidth,
+	const unsigned imageHeight,
+	const int scaleFactor,
+	const int crossCheckingThreshold,
+	const int occlusionNeighbours
+) : m_Device(devices.front()), m_Context(devices.front()), m_ImageWidth(imageWidth), m_ImageHeight(imageHeight),
+	m_Width(imageWidth / scaleFactor), m_Height(imageHeight / scaleFactor) {
+	const std::string mapSize = std::to_string(m_Width) + "x" + std::to_string(m_Height);
+
+	m_ScaleProblem = std::to_string(imageWidth) + "x" + std::to_string(imageHeight) + " scale " + std::to_string(scaleFactor);
+	m_ZnccProblem = mapSize + " window " + std::to_string(options.windowWidth) + "x" + std::to_string(options.windowHeight) +
+		" disparities " + std::to_string(options.maxDisparity);
+	m_MapProblem = mapSize;
+
+	std::cout << "Building Program...";
+	CLProgram program(m_Context, m_Device, programFiles(clOptions.kernelDirectory), "-cl-std=CL1.2", clOptions.programCache);
+	m_Program = program.GetProgram();
+
+	if (clOptions.programCache) {
+		std::cout << "Program Binary: " << (program.FromCache() ? "loaded from " : "built and stored in ") << program.CacheFile() << std::endl;
+	}
+
+	// The input images are uploaded and the output read back through mappings of host memory on zero-copy
+	m_ZeroCopy = useZeroCopy(m_Device, clOptions.buffers);
+
+	std::cout << "Buffers: " << (m_ZeroCopy ? "zero-copy, mapped from host memory" : "copied to and from device memory") << std::endl;
+
+	// The gray images are images if asked for and the device has the image formats, buffers otherwise
+	m_Images = clOptions.grayImages && supportsGrayImages(m_Context, m_Device);
+
+	if (m_Images) {
+		std::cout << "Gray Images: images, the input images are copied to device memory" << std::endl;
+	} else if (clOptions.grayImages) {
+		std::cout << "The device has no support for the gray images, using buffers" << std::endl;
+	}
+
+	cl_command_queue_properties queueProperties = CL_QUEUE_PROFILING_ENABLE;
+
+	if (clOptions.outOfOrder) {
+		if (m_Device.getInfo<CL_DEVICE_QUEUE_PROPERTIES>() & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE) {
+			queueProperties |= CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE;
+		} else {
+			std::cout << "The device has no out of order queues, using an in order queue" << std::endl;
+		}
+	}
+
+	// Split Zncc into equal bands of rows, each device with its own context and program as they may be of different platforms
+	const size_t deviceCount = devices.size();
+
+	for (size_t d = 0; deviceCount > 1 && d < deviceCount; d++) {
+		const unsigned firstRow = m_Height * d / deviceCount;
+		const unsigned rows = m_Height * (d + 1) / deviceCount - firstRow;
+
+		std::cout << "Zncc Band " << d << ": rows " << firstRow << " to " << firstRow + rows - 1
+			<< " on " << devices[d].getInfo<CL_DEVICE_NAME>() << std::endl;
+
+		if (d == 0) {
+			m_Bands.emplace_back(m_Context, m_Device, m_Program, clOptions.tiledZncc,
+				options.windowWidth, options.windowHeight, options.maxDisparity, m_Width, m_Height, firstRow, rows);
+		} else {
+			std::cout << "Building Program...";
+			cl::Context bandContext(devices[d]);
+			CLProgram bandProgram(bandContext, devices[d], programFiles(clOptions.kernelDirectory), "-cl-std=CL1.2", clOptions.programCache);
+
+			m_Bands.emplace_back(bandContext, devices[d], bandProgram.GetProgram(), clOptions.tiledZncc,
+				options.windowWidth, options.windowHeight, options.maxDisparity, m_Width, m_Height, firstRow, rows);
+		}
+
+		if (clOptions.tiledZncc) {
+			printZnccTile(m_Bands.back().Zncc());
+		}
+	}
+
+	for (FrameSet& set : m_Sets) {
+		createSet(set, options, clOptions, queueProperties, scaleFactor, crossCheckingThreshold, occlusionNeighbours);
+	}
+
+	if (clOptions.tiledZncc && m_Bands.empty()) {
+		printZnccTile(*m_Sets[0].zncc);
+	}
+}
+
+void StereoCL::createSet(FrameSet& set, const BackendOptions& options, const ClOptions& clOptions, const cl_command_queue_properties queueProperties,
+	const int scaleFactor, const int crossCheckingThreshold, const int occlusionNeighbours) {
+	const size_t imageBytes = sizeof(cl_uchar) * 4 * m_ImageWidth * m_ImageHeight;
+	const size_t grayBytes = sizeof(cl_uchar) * m_Width * m_Height;
+	const size_t mapBytes = sizeof(cl_uint) * m_Width * m_Height;
+
+	// On zero-copy the output buffer uses outputMemory in place
+	const cl_mem_flags inputAllocation = m_ZeroCopy ? CL_MEM_ALLOC_HOST_PTR : 0;
+	const cl_mem_flags outputAllocation = m_ZeroCopy ? CL_MEM_USE_HOST_PTR : 0;
+
+	// The host reads the gray images and writes the disparity maps when Zncc is split over several devices
+	const cl_mem_flags splitAccess = m_Bands.empty() ? CL_MEM_HOST_NO_ACCESS : 0;
+
+	set.outputMemory.reset(new PageMemory(mapBytes));
+
+	// The buffers between the stages are only written by the kernels, so they are not initialized
+	if (m_Images) {
+		const cl::ImageFormat rgba(CL_RGBA, CL_UNORM_INT8), gray(CL_R, CL_UNORM_INT8);
+
+		set.leftImage = cl::Image2D(m_Context, CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, rgba, m_ImageWidth, m_ImageHeight);
+		set.rightImage = cl::Image2D(m_Context, CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, rgba, m_ImageWidth, m_ImageHeight);
+		set.grayLImage = cl::Image2D(m_Context, CL_MEM_READ_WRITE | splitAccess, gray, m_Width, m_Height);
+		set.grayRImage = cl::Image2D(m_Context, CL_MEM_READ_WRITE | splitAccess, gray, m_Width, m_Height);
+	} else {
+		set.left = cl::Buffer(m_Context, CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY | inputAllocation, imageBytes);
+		set.right = cl::Buffer(m_Context, CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY | inputAllocation, imageBytes);
+		set.grayL = cl::Buffer(m_Context, CL_MEM_READ_WRITE | splitAccess, grayBytes);
+		set.grayR = cl::Buffer(m_Context, CL_MEM_READ_WRITE | splitAccess, grayBytes);
+	}
+	set.dispLR = cl::Buffer(m_Context, CL_MEM_READ_WRITE | splitAccess, mapBytes);
+	set.dispRL = cl::Buffer(m_Context, CL_MEM_READ_WRITE | splitAccess, mapBytes);
+	set.dispCC = cl::Buffer(m_Context, CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS, mapBytes);
+	set.output = cl::Buffer(m_Context, CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY | outputAllocation,
+		mapBytes, m_ZeroCopy ? set.outputMemory->Data() : nullptr);
+
+	set.map.resize(m_Width * m_Height);
+
+	if (!m_Bands.empty()) {
+		set.grayLHost.resize(m_Width * m_Height);
+		set.grayRHost.resize(m_Width * m_Height);
+		set.dispLRHost.resize(m_Width * m_Height);
+		set.dispRLHost.resize(m_Width * m_Height);
+	}
+
+	// Kernels keep their arguments, so every set has its own
+	set.scale = cl::Kernel(m_Program, ScaleKernelName());
+	if (m_Images) {
+		CLCall(set.scale.setArg(0, set.leftImage));
+		CLCall(set.scale.setArg(1, set.rightImage));
+		CLCall(set.scale.setArg(2, set.grayLImage));
+		CLCall(set.scale.setArg(3, set.grayRImage));
+		CLCall(set.scale.setArg(4, scaleFactor));
+	} else {
+		CLCall(set.scale.setArg(0, set.left));
+		CLCall(set.scale.setArg(1, set.right));
+		CLCall(set.scale.setArg(2, set.grayL));
+		CLCall(set.scale.setArg(3, set.grayR));
+		CLCall(set.scale.setArg(4, m_ImageWidth));
+		CLCall(set.scale.setArg(5, m_ImageHeight));
+		CLCall(set.scale.setArg(6, scaleFactor));
+	}
+
+	// Zncc computes one map per launch, the right to left one with the images swapped
+	set.zncc.reset(new ZnccKernels(m_Program, m_Device, clOptions.tiledZncc, m_Images,
+		options.windowWidth, options.windowHeight, options.maxDisparity));
+	if (m_Images) {
+		set.zncc->setArgs(set.grayLImage, set.grayRImage, set.dispLR, set.dispRL, m_Width, m_Height);
+	} else {
+		set.zncc->setArgs(set.grayL, set.grayR, set.dispLR, set.dispRL, m_Width, m_Height);
+	}
+
+	set.crossCheck = cl::Kernel(m_Program, "CrossCheck");
+	CLCall(set.crossCheck.setArg(0, set.dispLR));
+	CLCall(set.crossCheck.setArg(1, set.dispRL));
+	CLCall(set.crossCheck.setArg(2, set.dispCC));
+	CLCall(set.crossCheck.setArg(3, crossCheckingThreshold));
+
+	set.occlusionFill = cl::Kernel(m_Program, "OcclusionFill");
+	CLCall(set.occlusionFill.setArg(0, set.dispCC));
+	CLCall(set.occlusionFill.setArg(1, set.output));
+	CLCall(set.occlusionFill.setArg(2, m_Width));
+	CLCall(set.occlusionFill.setArg(3, m_Height));
+	CLCall(set.occlusionFill.setArg(4, occlusionNeighbours));
+
+	set.queue = cl::CommandQueue(m_Context, m_Device, queueProperties);
+}
+
+void StereoCL::submit(const unsigned char* left, const unsigned char* right) {
+	ProfileZone zone("submit frame");
+
+	// The set was freed by receiving the frame before the last one
+	assert(InFlight() < 2);
+	FrameSet& set = m_Sets[m_Submitted++ % 2];
+	set.times = FrameTimes();
+
+	const size_t imageBytes = sizeof(cl_uchar) * 4 * m_ImageWidth * m_ImageHeight;
+	const size_t mapBytes = sizeof(cl_uint) * m_Width * m_Height;
+
+	// Every stage waits for the events of the stages it reads from instead of the host waiting after each one
+	set.uploadEvents.clear();
+	if (m_Images) {
+		uploadImage(set.queue, set.leftImage, left, m_ImageWidth, m_ImageHeight, set.uploadEvents);
+		uploadImage(set.queue, set.rightImage, right, m_ImageWidth, m_ImageHeight, set.uploadEvents);
+	} else {
+		uploadBuffer(set.queue, set.left, left, imageBytes, m_ZeroCopy, set.uploadEvents);
+		uploadBuffer(set.queue, set.right, right, imageBytes, m_ZeroCopy, set.uploadEvents);
+	}
+
+	// Scale and gray both images
+	CLCall(set.queue.enqueueNDRangeKernel(set.scale, cl::NullRange,
+		cl::NDRange(m_Height, m_Width), m_ScaleGroup, &set.uploadEvents, &set.scaleEvent));
+
+	// Disparity Maps, both only need the gray images
+	if (m_Bands.empty()) {
+		std::vector<cl::Event> grayEvents = { set.scaleEvent };
+		set.zncc->enqueue(set.queue, &grayEvents, &set.dispLREvent, &set.dispRLEvent);
+	} else {
+		enqueueBands(set);
+	}
+
+	// Cross Checking
+	std::vector<cl::Event> dispEvents = { set.dispLREvent, set.dispRLEvent };
+	CLCall(set.queue.enqueueNDRangeKernel(set.crossCheck, cl::NullRange,
+		cl::NDRange(m_Height * m_Width), m_CrossCheckGroup, &dispEvents, &set.crossCheckEvent));
+
+	// Occlusion Filling
+	std::vector<cl::Event> crossCheckEvents = { set.crossCheckEvent };
+	CLCall(set.queue.enqueueNDRangeKernel(set.occlusionFill, cl::NullRange,
+		cl::NDRange(m_Height, m_Width), m_OcclusionFillGroup, &crossCheckEvents, &set.occlusionFillEvent));
+
+	// Read output without waiting, receive does
+	std::vector<cl::Event> occlusionFillEvents = { set.occlusionFillEvent };
+	set.readEvents.clear();
+	set.mapping = enqueueReadback(set.queue, set.output, set.map.data(), mapBytes, m_ZeroCopy, &occlusionFillEvents, set.readEvents);
+
+	CLCall(set.queue.flush());
+}
+
+void StereoCL::enqueueBands(FrameSet& set) {
+	ProfileZone zone("zncc bands");
+
+	const size_t grayBytes = sizeof(cl_uchar) * m_Width * m_Height;
+	const size_t mapBytes = sizeof(cl_uint) * m_Width * m_Height;
+	std::vector<cl::Event> grayEvents = { set.scaleEvent };
+	cl::Event grayLEvent, grayREvent;
+
+	// The gray images go through the host to the devices of the bands, their maps come back the same way
+	if (m_Images) {
+		const cl::size_t<3> region = imageRegion(m_Width, m_Height);
+
+		CLCall(set.queue.enqueueReadImage(set.grayLImage, CL_FALSE, cl::size_t<3>(), region, 0, 0, set.grayLHost.data(), &grayEvents, &grayLEvent));
+		CLCall(set.queue.enqueueReadImage(set.grayRImage, CL_TRUE, cl::size_t<3>(), region, 0, 0, set.grayRHost.data(), &grayEvents, &grayREvent));
+	} else {
+		CLCall(set.queue.enqueueReadBuffer(set.grayL, CL_FALSE, 0, grayBytes, set.grayLHost.data(), &grayEvents, &grayLEvent));
+		CLCall(set.queue.enqueueReadBuffer(set.grayR, CL_TRUE, 0, grayBytes, set.grayRHost.data(), &grayEvents, &grayREvent));
+	}
+	CLCall(grayLEvent.wait());
+
+	// All the bands are enqueued and flushed before waiting for any of them
+	for (ZnccBand& band : m_Bands) {
+		band.enqueue(set.grayLHost.data(), set.grayRHost.data(), set.dispLRHost.data(), set.dispRLHost.data());
+	}
+
+	for (ZnccBand& band : m_Bands) {
+		band.finish();
+		set.times.bands.push_back(eventSeconds(band.Events()));
+	}
+
+	CLCall(set.queue.enqueueWriteBuffer(set.dispLR, CL_FALSE, 0, mapBytes, set.dispLRHost.data(), nullptr, &set.dispLREvent));
+	CLCall(set.queue.enqueueWriteBuffer(set.dispRL, CL_FALSE, 0, mapBytes, set.dispRLHost.data(), nullptr, &set.dispRLEvent));
+
+	set.times.zncc = zone.getElapsedTime();
+}
+
+const std::vector<unsigned>& StereoCL::receive(FrameTimes& times) {
+	ProfileZone zone("receive frame");
+
+	assert(InFlight() > 0);
+	FrameSet& set = m_Sets[m_Received++ % 2];
+
+	finishReadback(set.queue, set.output, set.mapping, set.map.data(), sizeof(cl_uint) * m_Width * m_Height, set.readEvents);
+	set.mapping = nullptr;
+
+	// Device times of the stages, the frame is complete
+	set.times.upload = eventSeconds(set.uploadEvents);
+	set.times.scale = eventSeconds({ set.scaleEvent });
+	if (m_Bands.empty()) {
+		set.times.zncc = eventSeconds({ set.dispLREvent, set.dispRLEvent });
+	}
+	set.times.crossCheck = eventSeconds({ set.crossCheckEvent });
+	set.times.occlusionFill = eventSeconds({ set.occlusionFillEvent });
+	// The unmap of a mapping is enqueued by receive, the time between the map and it is not part of the read
+	set.times.read = 0;
+	for (const cl::Event& event : set.readEvents) {
+		set.times.read += eventSeconds({ event });
+	}
+	set.times.device = eventSeconds({ set.uploadEvents.front(), set.readEvents.front() });
+
+	times = set.times;
+	return set.map;
+}
+
+void StereoCL::setZnccWorkGroup(const cl::NDRange& group) {
+	for (FrameSet& set : m_Sets) {
+		set.zncc->setWorkGroup(group);
+	}
+}
+
+void StereoCL::applyTuning(const TuningDatabase& database) {
+	cl::NDRange group;
+
+	if (database.find(m_Device, ScaleKernelName(), m_ScaleProblem, group)) {
+		m_ScaleGroup = group;
+	}
+
+	if (database.find(m_Device, m_Sets[0].zncc->KernelName(), m_ZnccProblem, group) && group.dimensions() == 2) {
+		setZnccWorkGroup(group);
+	}
+
+	if (database.find(m_Device, "CrossCheck", m_MapProblem, group)) {
+		m_CrossCheckGroup = group;
+	}
+
+	if (database.find(m_Device, "OcclusionFill", m_MapProblem, group)) {
+		m_OcclusionFillGroup = group;
+	}
+
+	std::cout << "Work-groups: " << ScaleKernelName() << " " << workGroupString(m_ScaleGroup) << ", " << m_Sets[0].zncc->KernelName() << " "
+		<< workGroupString(m_Sets[0].zncc->WorkGroup()) << ", CrossCheck " << workGroupString(m_CrossCheckGroup)
+		<< ", OcclusionFill " << workGroupString(m_OcclusionFillGroup) << std::endl;
+}
+
+// Times the current work-group and the candidates with launchTime, returns the fastest
+// (current is a copy, launchTime may change the work-group it was taken from)
+static cl::NDRange fastestWorkGroup(
+	const char* kernel,
+	const cl::NDRange current,
+	const std::vector<cl::NDRange>& candidates,
+	const std::function<double(const cl::NDRange&)>& launchTime
+) {
+	const double currentTime = launchTime(current);
+
+	cl::NDRange best = current;
+	double bestTime = currentTime;
+
+	for (const cl::NDRange& candidate : candidates) {
+		const double time = launchTime(candidate);
+
+		if (time < bestTime) {
+			best = candidate;
+			bestTime = time;
+		}
+	}
+
+	std::cout << "Tuning " << kernel << ": " << candidates.size() << " work-groups, " << workGroupString(best) << " (" << bestTime << " s, "
+		<< currentTime << " s with " << workGroupString(current) << ")" << std::endl;
+
+	return best;
+}
+
+void StereoCL::tune(const unsigned char* left, const unsigned char* right, TuningDatabase& database) {
+	ProfileZone zone("tune");
+
+	constexpr int repeats = 3;
+
+	// The kernels are timed on the buffers of a real frame, the time of OcclusionFill depends on the holes of the map
+	FrameTimes times;
+	submit(left, right);
+	receive(times);
+
+	FrameSet& set = m_Sets[(m_Received - 1) % 2];
+
+	const cl::NDRange imageRange(m_Height, m_Width);
+	const cl::NDRange pixelRange(m_Height * m_Width);
+
+	m_ScaleGroup = fastestWorkGroup(ScaleKernelName(), m_ScaleGroup, divisorWorkGroups(m_Device, set.scale, imageRange),
+		[&](const cl::NDRange& group) { return timeLaunch(set.queue, set.scale, imageRange, group, repeats); });
+
+	// The tiles of ZnccTiled are sized by the work-group, so its local memory arguments change with it
+	ZnccKernels& zncc = *set.zncc;
+	const cl::NDRange znccGroup = fastestWorkGroup(zncc.KernelName(), zncc.WorkGroup(), zncc.candidateWorkGroups(m_Device),
+		[&](const cl::NDRange& group) {
+			zncc.setWorkGroup(group);
+			return timeLaunch(set.queue, zncc.LeftKernel(), zncc.GlobalRange(), group, repeats);
+		});
+
+	setZnccWorkGroup(znccGroup);
+
+	m_CrossCheckGroup = fastestWorkGroup("CrossCheck", m_CrossCheckGroup, divisorWorkGroups(m_Device, set.crossCheck, pixelRange),
+		[&](const cl::NDRange& group) { return timeLaunch(set.queue, set.crossCheck, pixelRange, group, repeats); });
+
+	m_OcclusionFillGroup = fastestWorkGroup("OcclusionFill", m_OcclusionFillGroup, divisorWorkGroups(m_Device, set.occlusionFill, imageRange),
+		[&](const cl::NDRange& group) { return timeLaunch(set.queue, set.occlusionFill, imageRange, group, repeats); });
+
+	database.store(m_Device, ScaleKernelName(), m_ScaleProblem, m_ScaleGroup);
+	database.store(m_Device, zncc.KernelName(), m_ZnccProblem, znccGroup);
+	database.store(m_Device, "CrossCheck", m_MapProblem, m_CrossCheckGroup);
+	database.store(m_Device, "OcclusionFill", m_MapProblem, m_OcclusionFillGroup);
+}
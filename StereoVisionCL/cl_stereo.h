@@ -0,0 +1,120 @@
+#pragma once
+
+#include <CL/cl.hpp>
+#include <memory>
+#include <vector>
+
+#include "backend_options.h"
+#include "cl_bands.h"
+#include "cl_buffers.h"
+#include "cl_options.h"
+#include "cl_tuning.h"
+#include "cl_zncc.h"
+
+/*
+Times of the stages of one frame in seconds, on the device.
+* zncc is the time on the host when Zncc is split, the device time of every band is in bands.
+* device spans the frame on its queue, from the start of the upload to the end of the read or map of the output.
+*/
+struct FrameTimes {
+	double upload = 0, scale = 0, zncc = 0, crossCheck = 0, occlusionFill = 0, read = 0, device = 0;
+	std::vector<double> bands;
+
+	FrameTimes& operator+=(const FrameTimes& other);
+};
+
+/*
+The OpenCL pipeline as an engine that stays alive for a stream of stereo pairs.
+* The context, program, kernels and buffers are made once, a frame only enqueues commands.
+* Two sets of buffers, each with its own queue: while a frame computes on one set, the next frame is uploaded to
+  the other one, after the frame before it is read back from it, so the transfers overlap with the kernels.
+* submit enqueues a frame, receive waits for the oldest frame in flight. There are at most two frames in flight.
+* With several devices Zncc is split over them (see ZnccBand), the host waits for the bands within submit.
+*/
+class StereoCL {
+private:
+	struct FrameSet {
+		cl::CommandQueue queue;
+		cl::Buffer left, right, grayL, grayR, dispLR, dispRL, dispCC, output;
+		// Replace left, right, grayL and grayR on gray images
+		cl::Image2D leftImage, rightImage, grayLImage, grayRImage;
+		std::unique_ptr<PageMemory> outputMemory;
+		cl::Kernel scale, crossCheck, occlusionFill;
+		std::unique_ptr<ZnccKernels> zncc;
+
+		// The gray images and maps go through the host when Zncc is split
+		std::vector<unsigned char> grayLHost, grayRHost;
+		std::vector<unsigned> dispLRHost, dispRLHost;
+		// The final map, read back here or copied here from the mapping of output
+		std::vector<unsigned> map;
+		void* mapping = nullptr;
+
+		std::vector<cl::Event> uploadEvents, readEvents;
+		cl::Event scaleEvent, dispLREvent, dispRLEvent, crossCheckEvent, occlusionFillEvent;
+		FrameTimes times;
+	};
+
+	cl::Device m_Device;
+	cl::Context m_Context;
+	cl::Program m_Program;
+	bool m_ZeroCopy;
+	bool m_Images;
+	unsigned m_ImageWidth, m_ImageHeight;
+	unsigned m_Width, m_Height;
+	std::vector<ZnccBand> m_Bands;
+	FrameSet m_Sets[2];
+
+	// Work-groups of the kernels other than Zncc, whose work-group is in the ZnccKernels of the sets
+	cl::NDRange m_ScaleGroup, m_CrossCheckGroup, m_OcclusionFillGroup;
+	// Keys of the kernels in the tuning database, the image size and the parameters the time depends on
+	std::string m_ScaleProblem, m_ZnccProblem, m_MapProblem;
+	unsigned m_Submitted = 0, m_Received = 0;
+
+	void createSet(FrameSet& set, const BackendOptions& options, const ClOptions& clOptions, const cl_command_queue_properties queueProperties,
+		const int scaleFactor, const int crossCheckingThreshold, const int occlusionNeighbours);
+	void enqueueBands(FrameSet& set);
+	void setZnccWorkGroup(const cl::NDRange& group);
+
+	inline const char* ScaleKernelName() const { return m_Images ? "ScaleAndGrayImage" : "ScaleAndGray"; }
+
+public:
+	/*
+	Builds the program and creates both sets for RGBA images of imageWidth x imageHeight pixels.
+	* The pipeline runs on the first device, Zncc on all of them if there are several.
+	*/
+	StereoCL(
+		const std::vector<cl::Device>& devices,
+		const BackendOptions& options,
+		const ClOptions& clOptions,
+		const unsigned imageWidth,
+		const unsigned imageHeight,
+		const int scaleFactor,
+		const int crossCheckingThreshold,
+		const int occlusionNeighbours
+	);
+
+	// Enqueues a pair of RGBA images, which must stay valid until the frame is received
+	void submit(const unsigned char* left, const unsigned char* right);
+
+	// Waits for the oldest frame in flight, its map is valid until the frame after the next one is submitted
+	const std::vector<unsigned>& receive(FrameTimes& times);
+
+	// Uses the work-groups of the database that were tuned for the device and the problem
+	void applyTuning(const TuningDatabase& database);
+
+	/*
+	Measures the work-groups of every kernel on a frame of the pair, then uses and stores the fastest ones.
+	* The work-groups that fit the kernel and the device are timed on the buffers of that frame, a few launches each.
+	* Needs no frame in flight. The Zncc of the bands of other devices keeps its work-group.
+	*/
+	void tune(const unsigned char* left, const unsigned char* right, TuningDatabase& database);
+
+	inline unsigned InFlight() const { return m_Submitted - m_Received; }
+	inline bool ZeroCopy() const { return m_ZeroCopy; }
+	// Whether the input and gray images are images, see ClOptions::grayImages
+	inline bool Images() const { return m_Images; }
+
+	// Size of the disparity maps
+	inline unsigned Width() const { return m_Width; }
+	inline unsigned Height() const { return m_Height; }
+};
@@ -0,0 +1,174 @@
+#include "cl_tuning.h"
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+#include "cl_call.h"
+
+// Fields of a line and of a key
+static const char separator = '\t';
+
+std::string TuningDatabase::key(const cl::Device& device, const std::string& kernel, const std::string& problem) {
+	return device.getInfo<CL_DEVICE_NAME>() + separator + device.getInfo<CL_DRIVER_VERSION>() + separator + kernel + separator + problem;
+}
+
+TuningDatabase::TuningDatabase(const std::string& fileName) : m_FileName(fileName) {
+	std::ifstream file(fileName);
+	std::string line;
+
+	while (std::getline(file, line)) {
+		// The work-group is the last field, a damaged line is skipped
+		size_t end = line.rfind(separator);
+		if (line.empty() || line[0] == '#' || end == std::string::npos) {
+			continue;
+		}
+
+		std::istringstream sizes(line.substr(end + 1));
+		std::vector<size_t> group;
+		size_t size;
+
+		while (sizes >> size) {
+			group.push_back(size);
+		}
+
+		if (!group.empty() && group.size() <= 3) {
+			m_Entries[line.substr(0, end)] = group;
+		}
+	}
+}
+
+bool TuningDatabase::find(const cl::Device& device, const std::string& kernel, const std::string& problem, cl::NDRange& group) const {
+	auto entry = m_Entries.find(key(device, kernel, problem));
+	if (entry == m_Entries.end()) {
+		return false;
+	}
+
+	const std::vector<size_t>& sizes = entry->second;
+
+	if (sizes[0] == 0) {
+		group = cl::NullRange;
+	} else if (sizes.size() == 1) {
+		group = cl::NDRange(sizes[0]);
+	} else if (sizes.size() == 2) {
+		group = cl::NDRange(sizes[0], sizes[1]);
+	} else {
+		group = cl::NDRange(sizes[0], sizes[1], sizes[2]);
+	}
+
+	return true;
+}
+
+void TuningDatabase::store(const cl::Device& device, const std::string& kernel, const std::string& problem, const cl::NDRange& group) {
+	std::vector<size_t> sizes;
+
+	for (size_t i = 0; i < group.dimensions(); i++) {
+		sizes.push_back(group[i]);
+	}
+
+	if (sizes.empty()) {
+		sizes.push_back(0);
+	}
+
+	m_Entries[key(device, kernel, problem)] = sizes;
+	m_Changed = true;
+}
+
+bool TuningDatabase::save() {
+	if (!m_Changed) {
+		return true;
+	}
+
+	std::ofstream file(m_FileName);
+	file << "# StereoVisionCL work-groups: device, driver, kernel, problem, work-group (0 for the runtime's choice)" << std::endl;
+
+	for (const auto& entry : m_Entries) {
+		file << entry.first << separator;
+
+		for (size_t i = 0; i < entry.second.size(); i++) {
+			file << (i ? " " : "") << entry.second[i];
+		}
+
+		file << std::endl;
+	}
+
+	m_Changed = false;
+	return (bool)file;
+}
+
+// Divisors of value up to limit
+static std::vector<size_t> divisors(const size_t value, const size_t limit) {
+	std::vector<size_t> result;
+
+	for (size_t d = 1; d <= std::min(value, limit); d++) {
+		if (value % d == 0) {
+			result.push_back(d);
+		}
+	}
+
+	return result;
+}
+
+std::vector<cl::NDRange> divisorWorkGroups(const cl::Device& device, const cl::Kernel& kernel, const cl::NDRange& global) {
+	const size_t maxWorkGroupSize = kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device);
+	const std::vector<size_t> maxItems = device.getInfo<CL_DEVICE_MAX_WORK_ITEM_SIZES>();
+
+	std::vector<cl::NDRange> groups = { cl::NullRange };
+
+	if (global.dimensions() == 1) {
+		for (size_t size : divisors(global[0], std::min(maxWorkGroupSize, maxItems[0]))) {
+			groups.push_back(cl::NDRange(size));
+		}
+
+		return groups;
+	}
+
+	for (size_t rows : divisors(global[0], std::min(maxWorkGroupSize, maxItems[0]))) {
+		for (size_t columns : divisors(global[1], std::min(maxWorkGroupSize / rows, maxItems[1]))) {
+			groups.push_back(cl::NDRange(rows, columns));
+		}
+	}
+
+	return groups;
+}
+
+double timeLaunch(const cl::CommandQueue& queue, const cl::Kernel& kernel, const cl::NDRange& global, const cl::NDRange& local, const int repeats) {
+	std::vector<cl::Event> events(repeats);
+
+	// A work-group the kernel can't run with is never the fastest
+	for (cl::Event& event : events) {
+		if (queue.enqueueNDRangeKernel(kernel, cl::NullRange, global, local, nullptr, &event)) {
+			CLCall(queue.finish());
+			return std::numeric_limits<double>::max();
+		}
+	}
+
+	CLCall(queue.finish());
+
+	double best = 0;
+
+	for (int i = 0; i < repeats; i++) {
+		double seconds = (events[i].getProfilingInfo<CL_PROFILING_COMMAND_END>() - events[i].getProfilingInfo<CL_PROFILING_COMMAND_START>()) * 1e-9;
+
+		if (i == 0 || seconds < best) {
+			best = seconds;
+		}
+	}
+
+	return best;
+}
+
+std::string workGroupString(const cl::NDRange& group) {
+	if (!group.dimensions()) {
+		return "auto";
+	}
+
+	std::string text = std::to_string(group[0]);
+
+	for (size_t i = 1; i < group.dimensions(); i++) {
+		text += " x " + std::to_string(group[i]);
+	}
+
+	return text;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <CL/cl.hpp>
+#include <map>
+#include <string>
+#include <vector>
+
+/*
+Work-groups of the kernels measured by the autotuner (see StereoCL::tune), kept in a text file between runs.
+* An entry is keyed by the device, its driver, the kernel and the problem (image size and parameters),
+  so another device, driver or image size is tuned again instead of reusing a work-group measured for something else.
+* One line per entry, tab separated: device, driver, kernel, problem, then the sizes of the work-group,
+  0 for cl::NullRange (the runtime picks the work-group).
+*/
+class TuningDatabase {
+private:
+	std::string m_FileName;
+	std::map<std::string, std::vector<size_t>> m_Entries;
+	bool m_Changed = false;
+
+	static std::string key(const cl::Device& device, const std::string& kernel, const std::string& problem);
+
+public:
+	// Reads the entries of the file, a missing file is an empty database
+	explicit TuningDatabase(const std::string& fileName);
+
+	// Returns false if there is no entry
+	bool find(const cl::Device& device, const std::string& kernel, const std::string& problem, cl::NDRange& group) const;
+	void store(const cl::Device& device, const std::string& kernel, const std::string& problem, const cl::NDRange& group);
+
+	// Writes the file if entries were stored, returns false on errors
+	bool save();
+
+	inline const std::string& FileName() const { return m_FileName; }
+};
+
+/*
+Work-groups of 1 or 2 dimensions that divide global, for the kernels that don't check their global ids against the image size.
+* Only the ones within the work-group limits of the kernel on the device, and cl::NullRange.
+*/
+std::vector<cl::NDRange> divisorWorkGroups(const cl::Device& device, const cl::Kernel& kernel, const cl::NDRange& global);
+
+/*
+Device time of the fastest of repeats launches of the kernel, in seconds.
+* The queue has to have profiling enabled, it is finished before returning.
+* Returns the largest double if the kernel can't be launched with local.
+*/
+double timeLaunch(const cl::CommandQueue& queue, const cl::Kernel& kernel, const cl::NDRange& global, const cl::NDRange& local, const int repeats);
+
+// "rows x columns" of a work-group, "auto" for cl::NullRange
+std::string workGroupString(const cl::NDRange& group);
@@ -0,0 +1,167 @@
+#include "cl_zncc.h"
+
+#include <algorithm>
+
+#include "cl_call.h"
+
+ZnccKernels::ZnccKernels(
+	const cl::Program& program,
+	const cl::Device& device,
+	const bool tiled,
+	const bool images,
+	const int windowWidth,
+	const int windowHeight,
+	const int maxDisp
+) : m_Tiled(tiled && !images), m_Images(images), m_WindowWidth(windowWidth), m_WindowHeight(windowHeight), m_MaxDisp(maxDisp) {
+	if (tiled && images) {
+		std::cout << "Zncc Tile: the gray images are images, using ZnccImage" << std::endl;
+	}
+
+	m_Kernels[0] = cl::Kernel(program, KernelName());
+	m_Group = znccWorkGroupSize(device, m_Kernels[0], windowWidth, windowHeight, maxDisp, m_Tiled);
+
+	if (m_Tiled && !m_Group.dimensions()) {
+		std::cout << "Zncc Tile: the local memory is too small, using Zncc" << std::endl;
+		m_Tiled = false;
+
+		m_Kernels[0] = cl::Kernel(program, "Zncc");
+		m_Group = znccWorkGroupSize(device, m_Kernels[0], windowWidth, windowHeight, maxDisp, false);
+	}
+
+	m_Kernels[1] = cl::Kernel(program, KernelName());
+
+	const int disparities[2][2] = { { 0, maxDisp }, { -maxDisp, 0 } };
+
+	for (int k = 0; k < 2; k++) {
+		CLCall(m_Kernels[k].setArg(5, disparities[k][0]));
+		CLCall(m_Kernels[k].setArg(6, disparities[k][1]));
+		CLCall(m_Kernels[k].setArg(7, windowWidth));
+		CLCall(m_Kernels[k].setArg(8, windowHeight));
+	}
+
+	setTiles();
+}
+
+void ZnccKernels::setTiles() {
+	if (!m_Tiled) {
+		return;
+	}
+
+	for (cl::Kernel& kernel : m_Kernels) {
+		CLCall(kernel.setArg(9, cl::Local(znccTileBytes(m_Group[0], m_Group[1], m_WindowWidth, m_WindowHeight, 0))));
+		CLCall(kernel.setArg(10, cl::Local(znccTileBytes(m_Group[0], m_Group[1], m_WindowWidth, m_WindowHeight, m_MaxDisp))));
+	}
+}
+
+void ZnccKernels::setWorkGroup(const cl::NDRange& group) {
+	m_Group = group;
+	setTiles();
+}
+
+std::vector<cl::NDRange> ZnccKernels::candidateWorkGroups(const cl::Device& device) const {
+	const size_t localMemory = device.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>();
+	const size_t maxWorkGroupSize = m_Kernels[0].getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device);
+	const std::vector<size_t> maxItems = device.getInfo<CL_DEVICE_MAX_WORK_ITEM_SIZES>();
+
+	std::vector<cl::NDRange> groups;
+
+	// Powers of two, the global size is rounded up to whole work-groups anyway
+	for (size_t tileHeight = 1; tileHeight <= std::min<size_t>(16, maxItems[0]); tileHeight *= 2) {
+		for (size_t tileWidth = 4; tileWidth <= std::min<size_t>(32, maxItems[1]); tileWidth *= 2) {
+			size_t bytes = znccTileBytes(tileHeight, tileWidth, m_WindowWidth, m_WindowHeight, 0) +
+				znccTileBytes(tileHeight, tileWidth, m_WindowWidth, m_WindowHeight, m_MaxDisp);
+
+			if (tileHeight * tileWidth <= maxWorkGroupSize && (!m_Tiled || bytes <= localMemory)) {
+				groups.push_back(cl::NDRange(tileHeight, tileWidth));
+			}
+		}
+	}
+
+	return groups;
+}
+
+void ZnccKernels::setArgs(
+	const cl::Memory& grayL,
+	const cl::Memory& grayR,
+	const cl::Buffer& dispLR,
+	const cl::Buffer& dispRL,
+	const unsigned width,
+	const unsigned height
+) {
+	const cl::Memory* images[2][2] = { { &grayL, &grayR }, { &grayR, &grayL } };
+	const cl::Buffer* maps[2] = { &dispLR, &dispRL };
+
+	for (int k = 0; k < 2; k++) {
+		CLCall(m_Kernels[k].setArg(0, *images[k][0]));
+		CLCall(m_Kernels[k].setArg(1, *images[k][1]));
+		CLCall(m_Kernels[k].setArg(2, *maps[k]));
+		CLCall(m_Kernels[k].setArg(3, width));
+		CLCall(m_Kernels[k].setArg(4, height));
+	}
+
+	m_Width = width;
+	m_Height = height;
+}
+
+void ZnccKernels::enqueue(const cl::CommandQueue& queue, const std::vector<cl::Event>* events, cl::Event* dispLREvent, cl::Event* dispRLEvent) {
+	CLCall(queue.enqueueNDRangeKernel(m_Kernels[0], cl::NullRange, GlobalRange(), m_Group, events, dispLREvent));
+	CLCall(queue.enqueueNDRangeKernel(m_Kernels[1], cl::NullRange, GlobalRange(), m_Group, events, dispRLEvent));
+}
+
+cl::NDRange ZnccKernels::GlobalRange() const {
+	// The global size is rounded up to whole work-groups, the kernels skip the pixels outside the image
+	return cl::NDRange(roundUp(m_Height, m_Group[0]), roundUp(m_Width, m_Group[1]));
+}
+
+size_t ZnccKernels::LocalBytes() const {
+	if (!m_Tiled) {
+		return 0;
+	}
+
+	return znccTileBytes(m_Group[0], m_Group[1], m_WindowWidth, m_WindowHeight, 0) +
+		znccTileBytes(m_Group[0], m_Group[1], m_WindowWidth, m_WindowHeight, m_MaxDisp);
+}
+
+/*
+Work-group size (rows, columns) of Zncc or, if tiled, ZnccTiled, where it is also the size of the tiles.
+* Work-groups are up to 16 x 16 pixels, as large as the work-group limits of the kernel allow.
+* For ZnccTiled lower and then narrower tiles are taken if they don't fit in the local memory of the device,
+  the right strip grows with the disparities, so a large maxDisp needs small tiles.
+  Returns an empty range if not even a single pixel fits.
+*/
+cl::NDRange znccWorkGroupSize(
+	const cl::Device& device,
+	const cl::Kernel& kernel,
+	const int windowWidth,
+	const int windowHeight,
+	const int maxDisp,
+	const bool tiled
+) {
+	const size_t localMemory = device.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>();
+	const size_t maxWorkGroupSize = kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device);
+	const std::vector<size_t> maxItems = device.getInfo<CL_DEVICE_MAX_WORK_ITEM_SIZES>();
+
+	for (size_t tileWidth = std::min<size_t>({ 16, maxWorkGroupSize, maxItems[1] }); tileWidth > 0; tileWidth /= 2) {
+		for (size_t tileHeight = std::min<size_t>({ 16, maxWorkGroupSize / tileWidth, maxItems[0] }); tileHeight > 0; tileHeight--) {
+			size_t bytes = znccTileBytes(tileHeight, tileWidth, windowWidth, windowHeight, 0) +
+				znccTileBytes(tileHeight, tileWidth, windowWidth, windowHeight, maxDisp);
+
+			if (!tiled || bytes <= localMemory) {
+				return cl::NDRange(tileHeight, tileWidth);
+			}
+		}
+	}
+
+	return cl::NullRange;
+}
+
+// Size of the leftTile (disparities = 0) or rightTile argument of ZnccTiled
+size_t znccTileBytes(
+	const size_t tileHeight,
+	const size_t tileWidth,
+	const int windowWidth,
+	const int windowHeight,
+	const int disparities
+) {
+	return (tileHeight + windowHeight - 1) * (tileWidth + windowWidth - 1 + disparities) * sizeof(cl_uchar);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <CL/cl.hpp>
+#include <vector>
+
+/*
+The two Zncc launches of the pipeline, left to right and right to left (images swapped, disparities -maxDisp to 0).
+* The kernel is ZnccImage if the gray images are images, otherwise ZnccTiled if tiled and its tiles fit in the local memory
+  of the device, Zncc otherwise.
+* The work-group is up to 16 x 16 pixels, the global size is rounded up to whole work-groups.
+*/
+class ZnccKernels {
+private:
+	cl::Kernel m_Kernels[2];
+	cl::NDRange m_Group;
+	bool m_Tiled, m_Images;
+	int m_WindowWidth, m_WindowHeight, m_MaxDisp;
+	unsigned m_Width = 0, m_Height = 0;
+
+	// The local memory arguments of ZnccTiled, sized by the work-group
+	void setTiles();
+
+public:
+	ZnccKernels(
+		const cl::Program& program,
+		const cl::Device& device,
+		const bool tiled,
+		const bool images,
+		const int windowWidth,
+		const int windowHeight,
+		const int maxDisp
+	);
+
+	// The maps of the gray images are computed for width x height pixels, the gray images are images for ZnccImage
+	void setArgs(
+		const cl::Memory& grayL,
+		const cl::Memory& grayR,
+		const cl::Buffer& dispLR,
+		const cl::Buffer& dispRL,
+		const unsigned width,
+		const unsigned height
+	);
+
+	void enqueue(const cl::CommandQueue& queue, const std::vector<cl::Event>* events, cl::Event* dispLREvent, cl::Event* dispRLEvent);
+
+	// Replaces the work-group of znccWorkGroupSize, a tuned one for example
+	void setWorkGroup(const cl::NDRange& group);
+
+	// Work-groups worth trying on the device, the tiles of all of them fit in its local memory
+	std::vector<cl::NDRange> candidateWorkGroups(const cl::Device& device) const;
+
+	inline bool Tiled() const { return m_Tiled; }
+	inline bool Images() const { return m_Images; }
+	inline const char* KernelName() const { return m_Images ? "ZnccImage" : m_Tiled ? "ZnccTiled" : "Zncc"; }
+	inline const cl::NDRange& WorkGroup() const { return m_Group; }
+
+	// The left to right kernel and its global size, for timing the work-groups
+	inline const cl::Kernel& LeftKernel() const { return m_Kernels[0]; }
+	cl::NDRange GlobalRange() const;
+
+	// Local memory of both tiles of ZnccTiled
+	size_t LocalBytes() const;
+};
+
+inline size_t roundUp(const size_t value, const size_t multiple) {
+	return (value + multiple - 1) / multiple * multiple;
+}
+
+cl::NDRange znccWorkGroupSize(const cl::Device&, const cl::Kernel&, const int, const int, const int, const bool);
+size_t znccTileBytes(const size_t, const size_t, const int, const int, const int);
@@ -3,78 +3,19 @@
 #include <fstream>
 #include <chrono>
 #include <cassert>
-
+#include <algorithm>
+#include <climits>
+
+#include "backend_options.h"
+#include "cl_call.h"
+#include "cl_devices.h"
+#include "cl_options.h"
+#include "cl_stereo.h"
 #include "lodepng.h"
+#include "profiler.h"
 
 cl_int err;
 
-// Efficient error handling
-#define CLCall(x) \
-	err = x; \
-	if (err) \
-		std::cout << "Error [" << err << "]: " << __FILE__ << ":" << __LINE__ << std::endl
-
-/*
-Class to handle multiple opencl kernel files
-*/
-class CLProgram {
-private:
-	cl::Program m_Program;
-	
-public:
-	CLProgram(cl::Context context, cl::Device device, const std::string& fileName) {
-		// Read the kernel codes
-		std::ifstream fileStream(fileName);
-		std::string src(std::istreambuf_iterator<char>(fileStream), (std::istreambuf_iterator<char>()));
-
-		// Load the kernel code
-		cl::Program::Sources sources(1, std::make_pair(src.c_str(), src.length() + 1));
-
-		m_Program = cl::Program(context, sources);
-
-		CLCall(m_Program.build("-cl-std=CL1.2"));
-
-		cl_build_status status = m_Program.getBuildInfo<CL_PROGRAM_BUILD_STATUS>(device);
-		if (status == CL_BUILD_ERROR) {
-			std::string log = m_Program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(device);
-			std::cerr << log << std::endl;
-		}
-	}
-
-	inline cl::Program GetProgram() { return m_Program; }
-};
-
-/*
-Class to calculate time taken by functions in seconds.
-* Creating an object of the class in a function, calls the constructor which starts the timer.
-* At the end of the function, the destructor is called which stops the timer and calculates the duration.
-* We can get the duration manually using the getElapsedTime method.
-*/
-class Timer {
-private:
-	std::chrono::time_point<std::chrono::steady_clock> m_Start, m_End;
-	std::chrono::duration<float> m_Duration;
-
-public:
-	Timer() {
-		m_Start = std::chrono::high_resolution_clock::now();
-	}
-
-	~Timer() {
-		m_End = std::chrono::high_resolution_clock::now();
-		m_Duration = m_End - m_Start;
-
-		std::cout << "Done (" << m_Duration.count() << " s)" << std::endl;
-	}
-
-	float getElapsedTime() {
-		m_End = std::chrono::high_resolution_clock::now();
-		m_Duration = m_End - m_Start;
-
-		return m_Duration.count();
-	}
-};
-
 constexpr int maxDisparity = 64;
 
 constexpr int windowWidth = 15;
@@ -89,25 +30,37 @@ constexpr int scaleFactor = 4;
 std::vector<unsigned char> loadImage(const char*, unsigned&, unsigned&);
 std::vector<unsigned char> normalize(std::vector<unsigned>, const unsigned, const unsigned);
 
-int main() {
-	Timer timer;
+int main(int argc, char** argv) {
+	// The options shared by all backends, see backend_options.h
+	BackendOptions options(windowWidth, windowHeight, maxDisparity);
+	ClOptions clOptions;
+	if (!parseClOptions(argc, argv, clOptions) || !parseBackendOptions(argc, argv, options)) {
+		return -1;
+	}
+
+	ProfileOutput profileOutput(options.profileFile);
+	Profiler::instance().setThreadName("main");
 
-	// Get the list of platforms available
-	std::vector<cl::Platform> platforms;
-	cl::Platform::get(&platforms);
+	ProfileZone programZone("program");
+
+	// The devices of every platform, GPUs first, so CPU OpenCL runtimes work without a GPU
+	std::vector<cl::Device> devices = findDevices(clOptions.deviceName);
+
+	if (devices.empty()) {
+		std::cout << "No OpenCL device found" << std::endl;
+		return exitNoDevice;
+	}
 
-	// Get the list of devices from the first platform
-	cl::Platform platform = platforms.front();
-	std::vector<cl::Device> devices;
-	platform.getDevices(CL_DEVICE_TYPE_GPU, &devices);
+	// Zncc is split over the first deviceCount devices if there are several
+	const size_t deviceCount = clOptions.split ? std::min<size_t>(clOptions.split, devices.size()) : devices.size();
+	devices.resize(deviceCount);
 
 	cl::Device device = devices.front();
-	cl::Context context(device);
 
 	// Get the maximum number of work items per work group supported by the GPU
 	unsigned maxWorkGroupSize = device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>();
 
-	std::cout << "Device: " << device.getInfo<CL_DEVICE_VENDOR>() << std::endl;
+	std::cout << "Device: " << device.getInfo<CL_DEVICE_NAME>() << " (" << device.getInfo<CL_DEVICE_VENDOR>() << ")" << std::endl;
 	std::cout << "OpenCL Version: " << device.getInfo<CL_DEVICE_VERSION>() << std::endl;
 	std::cout << "Max Workgroup Size: " << maxWorkGroupSize << std::endl;
 	std::cout << "Max Local Memory Size: " << device.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>() << std::endl;
@@ -117,141 +70,97 @@ int main() {
 	unsigned width, height, rightWidth, rightHeight;
 
 	std::cout << "Reading Left Image...";
-	leftPixels = loadImage("imageL.png", width, height);
+	leftPixels = loadImage(options.leftFile, width, height);
 
 	std::cout << "Reading Right Image...";
-	rightPixels = loadImage("imageR.png", rightWidth, rightHeight);
+	rightPixels = loadImage(options.rightFile, rightWidth, rightHeight);
 
 	// left and right images are assumed to be of same dimensions
 	assert(width == rightWidth && height == rightHeight);
 
-	width /= scaleFactor;
-	height /= scaleFactor;
-	unsigned imgSize = width * height;
-	
-	// Create Programs
-	CLProgram scaleProg(context, device, "ScaleAndGray.cl");
-	CLProgram znccProg(context, device, "Zncc.cl");
-	CLProgram crossCheckProg(context, device, "CrossCheck.cl");
-	CLProgram ocFillProg(context, device, "OcclusionFill.cl");
-	
-	// Array to copy output back into
-	std::vector<unsigned> output(imgSize);
-
-	// Create buffers
-	cl::Buffer lBuff(context, CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR, 
-		sizeof(leftPixels[0]) * leftPixels.size(), leftPixels.data());
-	cl::Buffer rBuff(context, CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
-		sizeof(rightPixels[0]) * rightPixels.size(), rightPixels.data());
-	cl::Buffer grayLBuff(context, CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
-		sizeof(output[0]) * imgSize, output.data());
-	cl::Buffer grayRBuff(context, CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
-		sizeof(output[0]) * imgSize, output.data());
-	cl::Buffer dispLRBuff(context, CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
-		sizeof(output[0]) * imgSize, output.data());
-	cl::Buffer dispRLBuff(context, CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
-		sizeof(output[0]) * imgSize, output.data());
-	cl::Buffer dispCCBuff(context, CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS | CL_MEM_COPY_HOST_PTR,
-		sizeof(output[0]) * imgSize, output.data());
-	cl::Buffer outputBuff(context, CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY | CL_MEM_COPY_HOST_PTR,
-		sizeof(output[0]) * imgSize, output.data());
-
-	// Create Kernels
-	cl::Kernel scaleKernel(scaleProg.GetProgram(), "ScaleAndGray");
-	CLCall(scaleKernel.setArg(0, lBuff));
-	CLCall(scaleKernel.setArg(1, rBuff));
-	CLCall(scaleKernel.setArg(2, grayLBuff));
-	CLCall(scaleKernel.setArg(3, grayRBuff));
-	CLCall(scaleKernel.setArg(4, width * scaleFactor));
-	CLCall(scaleKernel.setArg(5, height * scaleFactor));
-	CLCall(scaleKernel.setArg(6, scaleFactor));
-
-	cl::Kernel dispKernel(znccProg.GetProgram(), "Zncc");
-	CLCall(dispKernel.setArg(0, grayLBuff));
-	CLCall(dispKernel.setArg(1, grayRBuff));
-	CLCall(dispKernel.setArg(2, dispLRBuff));
-	CLCall(dispKernel.setArg(3, dispRLBuff));
-	CLCall(dispKernel.setArg(4, width));
-	CLCall(dispKernel.setArg(5, height));
-	CLCall(dispKernel.setArg(6, 0));
-	CLCall(dispKernel.setArg(7, maxDisparity));
-	CLCall(dispKernel.setArg(8, windowWidth));
-	CLCall(dispKernel.setArg(9, windowHeight));
-
-	cl::Kernel dispCCKernel(crossCheckProg.GetProgram(), "CrossCheck");
-	CLCall(dispCCKernel.setArg(0, dispLRBuff));
-	CLCall(dispCCKernel.setArg(1, dispRLBuff));
-	CLCall(dispCCKernel.setArg(2, dispCCBuff));
-	CLCall(dispCCKernel.setArg(3, crossCheckingThreshold));
-
-	cl::Kernel ocFillKernel(ocFillProg.GetProgram(), "OcclusionFill");
-	CLCall(ocFillKernel.setArg(0, dispCCBuff));
-	CLCall(ocFillKernel.setArg(1, outputBuff));
-	CLCall(ocFillKernel.setArg(2, width));
-	CLCall(ocFillKernel.setArg(3, height));
-	CLCall(ocFillKernel.setArg(4, occlusionNeighbours));
-
-	// Events
-	double elapsed = 0;
-
-	cl::Event scaleLEvent;
-	cl::Event scaleREvent;
-	cl::Event dispLREvent;
-	cl::Event dispRLEvent;
-	cl::Event dispCCEvent;
-	cl::Event ocFillEvent;
-
-	// Enqueue Tasks
-	cl::CommandQueue queue(context, device, CL_QUEUE_PROFILING_ENABLE);
-
-	// Scale and gray left
-	std::cout << "Converting Images to grayscale...";
-	CLCall(queue.enqueueNDRangeKernel(scaleKernel, cl::NullRange, 
-		cl::NDRange(height, width), cl::NullRange, nullptr, &scaleLEvent));
-	scaleLEvent.wait();
-	elapsed = scaleLEvent.getProfilingInfo<CL_PROFILING_COMMAND_END>() -
-		scaleLEvent.getProfilingInfo<CL_PROFILING_COMMAND_START>();
-	std::cout << "Done (" << elapsed * 1e-9 << " s)" << std::endl;
-
-	// Disparity Maps
-	std::cout << "Calculating Disparity Maps...";
-	CLCall(queue.enqueueNDRangeKernel(dispKernel, cl::NullRange,
-		cl::NDRange(height, width), cl::NDRange(2, 15), nullptr, &dispLREvent));
-	dispLREvent.wait();
-	elapsed = dispLREvent.getProfilingInfo<CL_PROFILING_COMMAND_END>() -
-		dispLREvent.getProfilingInfo<CL_PROFILING_COMMAND_START>();
-	std::cout << "Done (" << elapsed * 1e-9 << " s)" << std::endl;
-
-	// Cross Checking
-	std::cout << "Performing Cross Checking...";
-	CLCall(queue.enqueueNDRangeKernel(dispCCKernel, cl::NullRange, 
-		cl::NDRange(height * width), cl::NullRange, nullptr, &dispCCEvent));
-	dispCCEvent.wait();
-	elapsed = dispCCEvent.getProfilingInfo<CL_PROFILING_COMMAND_END>() -
-		dispCCEvent.getProfilingInfo<CL_PROFILING_COMMAND_START>();
-	std::cout << "Done (" << elapsed * 1e-9 << " s)" << std::endl;
-
-	// Occlusion Filling
-	std::cout << "Performing Occlusion Filling...";
-	CLCall(queue.enqueueNDRangeKernel(ocFillKernel, cl::NullRange,
-		cl::NDRange(height, width), cl::NullRange, nullptr, &ocFillEvent));
-	ocFillEvent.wait();
-	elapsed = ocFillEvent.getProfilingInfo<CL_PROFILING_COMMAND_END>() -
-		ocFillEvent.getProfilingInfo<CL_PROFILING_COMMAND_START>();
-	std::cout << "Done (" << elapsed * 1e-9 << " s)" << std::endl;
-
-	// Read output
-	CLCall(cl::enqueueReadBuffer(outputBuff, CL_TRUE, 0, sizeof(output[0])* output.size(), output.data()));
+	// The context, program, kernels and buffers, made once for all the frames
+	StereoCL stereo(devices, options, clOptions, width, height, scaleFactor, crossCheckingThreshold, occlusionNeighbours);
+
+	width = stereo.Width();
+	height = stereo.Height();
+
+	// Work-groups tuned by an earlier run with --tune, or measured now
+	TuningDatabase tuning(clOptions.tuningFile);
+
+	if (clOptions.tune) {
+		stereo.tune(leftPixels.data(), rightPixels.data(), tuning);
+
+		if (!tuning.save()) {
+			std::cout << "Failed to write " << tuning.FileName() << std::endl;
+		}
+	}
+
+	stereo.applyTuning(tuning);
+
+	// The pair is processed clOptions.frames times as a stream, a frame is submitted before the one before it is received
+	std::vector<unsigned> output;
+	FrameTimes totalTimes;
+	float streamTime;
+
+	{
+		ProfileZone streamZone("stream");
+
+		for (unsigned frame = 0; frame <= clOptions.frames; frame++) {
+			if (frame < clOptions.frames) {
+				stereo.submit(leftPixels.data(), rightPixels.data());
+			}
+
+			if (frame > 0) {
+				FrameTimes times;
+				output = stereo.receive(times);
+				totalTimes += times;
+			}
+		}
+
+		streamTime = streamZone.getElapsedTime();
+	}
+
+	// Device times of the stages, per frame
+	const double frames = clOptions.frames;
+
+	if (clOptions.frames > 1) {
+		std::cout << "Average of " << clOptions.frames << " frames:" << std::endl;
+	}
+
+	std::cout << "Uploading Images...Done (" << totalTimes.upload / frames << " s)" << std::endl;
+	std::cout << "Converting Images to grayscale...Done (" << totalTimes.scale / frames << " s)" << std::endl;
+	if (totalTimes.bands.empty()) {
+		std::cout << "Calculating Disparity Maps...Done (" << totalTimes.zncc / frames << " s)" << std::endl;
+	} else {
+		std::cout << "Calculating Disparity Maps...Done (" << totalTimes.zncc / frames << " s on the host)" << std::endl;
+
+		for (size_t d = 0; d < totalTimes.bands.size(); d++) {
+			std::cout << "  Band " << d << ": " << totalTimes.bands[d] / frames << " s on " << devices[d].getInfo<CL_DEVICE_NAME>() << std::endl;
+		}
+	}
+	std::cout << "Performing Cross Checking...Done (" << totalTimes.crossCheck / frames << " s)" << std::endl;
+	std::cout << "Performing Occlusion Filling...Done (" << totalTimes.occlusionFill / frames << " s)" << std::endl;
+	std::cout << "Reading Output...Done (" << totalTimes.read / frames << " s)" << std::endl;
+	std::cout << "Device Pipeline: " << totalTimes.device / frames << " s" << std::endl;
+
+	// Frames overlap, so the throughput is above the inverse of the device time of a frame
+	std::cout << "Throughput: " << clOptions.frames << " frames in " << streamTime << " s, " << frames / streamTime << " frames/s" << std::endl;
+
 	lodepng::encode("output.png", normalize(output, width, height), width, height);
 
-	std::cout << "The program took " << timer.getElapsedTime() << " s" << std::endl;
+	if (options.outputFile && writeDisparityPgm(options.outputFile, output, width, height)) {
+		std::cout << "Failed to write " << options.outputFile << std::endl;
+		return -1;
+	}
+
+	std::cout << "The program took " << programZone.getElapsedTime() << " s" << std::endl;
 
 	std::cin.get();
 	return 0;
 }
 
 std::vector<unsigned char> loadImage(const char* filename, unsigned& width, unsigned& height) {
-	Timer timer;
+	ProfileZone zone("load image", true);
 
 	std::vector<unsigned char> pixels;
 
@@ -293,4 +202,4 @@ std::vector<unsigned char> normalize(
 	}
 
 	return result;
-}
\ No newline at end of file
+}
@@ -0,0 +1,181 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+
+static thread_local Profiler::ThreadBuffer* threadBufferCache = nullptr;
+
+Profiler::Profiler() : m_Start(std::chrono::steady_clock::now()) {}
+
+Profiler& Profiler::instance() {
+	static Profiler profiler;
+	return profiler;
+}
+
+Profiler::ThreadBuffer& Profiler::threadBuffer() {
+	if (!threadBufferCache) {
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		unsigned id = (unsigned)m_Buffers.size() + 1;
+		m_Buffers.emplace_back(new ThreadBuffer(id, "thread " + std::to_string(id)));
+
+		threadBufferCache = m_Buffers.back().get();
+	}
+
+	return *threadBufferCache;
+}
+
+void Profiler::setThreadName(const std::string& name) {
+	ThreadBuffer& buffer = threadBuffer();
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	buffer.name = name;
+}
+
+void Profiler::report(std::ostream& out) {
+	struct Path {
+		std::vector<double> durations; // Milliseconds
+		std::vector<long long> order; // First start of the path and of each of its parents, outermost first
+		int depth;
+		const char* name;
+	};
+
+	std::map<std::string, Path> paths;
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	for (const std::unique_ptr<ThreadBuffer>& buffer : m_Buffers) {
+		// Key of every zone, built from the key of its parent which always comes first in the buffer
+		std::vector<std::string> keys(buffer->zones.size());
+
+		for (size_t i = 0; i < buffer->zones.size(); i++) {
+			const Zone& zone = buffer->zones[i];
+			keys[i] = (zone.parent < 0 ? std::string() : keys[zone.parent] + "/") + zone.name;
+
+			if (zone.end < 0) continue;
+
+			Path& path = paths[keys[i]];
+			path.name = zone.name;
+			path.durations.push_back((zone.end - zone.begin) / 1e6);
+
+			if (path.order.empty() || zone.begin < path.order.back()) {
+				path.order.clear();
+				for (int k = (int)i; k >= 0; k = buffer->zones[k].parent) {
+					path.order.insert(path.order.begin(), buffer->zones[k].begin);
+				}
+				path.depth = (int)path.order.size() - 1;
+			}
+		}
+	}
+
+	// Children right after their parent, siblings in the order they first ran
+	std::vector<Path*> sorted;
+	for (auto& entry : paths) {
+		sorted.push_back(&entry.second);
+	}
+	std::sort(sorted.begin(), sorted.end(), [](const Path* a, const Path* b) { return a->order < b->order; });
+
+	out << std::left << std::setw(40) << "Zone" << std::right
+		<< std::setw(8) << "calls" << std::setw(12) << "total ms" << std::setw(10) << "min" << std::setw(10) << "median"
+		<< std::setw(10) << "p99" << std::setw(10) << "max" << std::endl;
+
+	for (Path* path : sorted) {
+		std::vector<double>& durations = path->durations;
+		std::sort(durations.begin(), durations.end());
+
+		double total = 0;
+		for (double duration : durations) {
+			total += duration;
+		}
+
+		size_t p99 = (size_t)std::ceil(durations.size() * 0.99) - 1;
+
+		out << std::left << std::setw(40) << (std::string(2 * path->depth, ' ') + path->name) << std::right << std::fixed << std::setprecision(3)
+			<< std::setw(8) << durations.size() << std::setw(12) << total << std::setw(10) << durations.front()
+			<< std::setw(10) << durations[durations.size() / 2] << std::setw(10) << durations[p99] << std::setw(10) << durations.back()
+			<< std::defaultfloat << std::endl;
+	}
+}
+
+// Zone names are literals of our own, only quotes and backslashes need escaping
+static std::string jsonString(const std::string& text) {
+	std::string result = "\"";
+	for (char c : text) {
+		if (c == '"' || c == '\\') result += '\\';
+		result += c;
+	}
+
+	return result + "\"";
+}
+
+bool Profiler::writeChromeTrace(const char* filename) {
+	std::ofstream out(filename);
+	if (!out) return false;
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	out << "{\"traceEvents\":[\n";
+
+	bool first = true;
+	auto separator = [&]() -> const char* {
+		const char* text = first ? "" : ",\n";
+		first = false;
+		return text;
+	};
+
+	char times[64];
+
+	for (const std::unique_ptr<ThreadBuffer>& buffer : m_Buffers) {
+		out << separator() << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->id
+			<< ",\"args\":{\"name\":" << jsonString(buffer->name) << "}}";
+
+		for (const Zone& zone : buffer->zones) {
+			if (zone.end < 0) continue;
+
+			// Complete events, timestamps in microseconds
+			snprintf(times, sizeof(times), "\"ts\":%.3f,\"dur\":%.3f", zone.begin / 1e3, (zone.end - zone.begin) / 1e3);
+
+			out << separator() << "{\"name\":" << jsonString(zone.name) << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->id
+				<< "," << times << "}";
+		}
+	}
+
+	out << "\n]}\n";
+
+	return (bool)out;
+}
+
+ProfileZone::ProfileZone(const char* name, const bool print) :
+	m_Buffer(Profiler::instance().threadBuffer()), m_Index((int)m_Buffer.zones.size()), m_Print(print) {
+	m_Buffer.zones.push_back(Profiler::Zone{ name, Profiler::instance().now(), -1, m_Buffer.open });
+	m_Buffer.open = m_Index;
+}
+
+ProfileZone::~ProfileZone() {
+	Profiler::Zone& zone = m_Buffer.zones[m_Index];
+	zone.end = Profiler::instance().now();
+	m_Buffer.open = zone.parent;
+
+	if (m_Print) {
+		std::cout << "Done (" << (zone.end - zone.begin) / 1e9 << " s)" << std::endl;
+	}
+}
+
+float ProfileZone::getElapsedTime() const {
+	return (Profiler::instance().now() - m_Buffer.zones[m_Index].begin) / 1e9f;
+}
+
+ProfileOutput::~ProfileOutput() {
+	if (!m_File) return;
+
+	Profiler::instance().report(std::cout);
+
+	if (!Profiler::instance().writeChromeTrace(m_File)) {
+		std::cout << "Failed to write " << m_File << std::endl;
+	}
+}
@@ -0,0 +1,486 @@
+#include <iostream>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "lodepng.h"
+#include "mapped_file.h"
+#include "stereo.h"
+#include "synthetic.h"
+
+/*
+Regression harness across the backends (StereoVisionCpp, StereoVisionParallelCpp, StereoVisionCL, StereoVisionCuda).
+* Every backend that is built runs as its own process on the same image pair with the same window and disparity range,
+  through the options all of them take (--left, --right, --window, --max-disparity, --output, --profile).
+* The input is the given pair or a synthetic pair (see synthetic.h) of the given size, written as PNG.
+* Each final disparity map is compared pixel by pixel with the one of the reference backend:
+  pixels differing by more than the tolerance are counted as mismatches, a backend passes if their share
+  stays within the allowed percentage.
+* The wall clock time of every backend process and the time of its "program" profiler zone are recorded,
+  the fastest of the runs is reported. The results are printed and written as JSON.
+* Backends are looked for in the Visual Studio output directories of the solution (x64/Release, x64/Debug, Release, Debug)
+  and next to their sources, --backend name=executable overrides that. They run in a scratch directory of their own
+  (compare_<name>), so the images they write for debugging stay out of their project directory. The OpenCL backend
+  reads its kernels from its project directory (--kernel-dir), StereoVisionCpp writes no debug images (--verbosity 0).
+* A backend that exits with exitNoDevice (no GPU for CUDA, no OpenCL device) is reported as unavailable,
+  so on machines without a GPU only the CPU backends and OpenCL on a CPU runtime are compared.
+* Returns 1 if a backend failed or mismatched, 0 otherwise.
+*/
+
+// Exit code of a backend without a device, see backend_options.h of the backends
+constexpr int exitNoDevice = 2;
+
+struct Backend {
+	std::string name;
+	std::string executable = ""; // Empty if it isn't built
+	std::string directory = "";
+	std::string workDirectory = ""; // Scratch directory the backend runs in
+};
+
+struct Options {
+	const char* leftFile = nullptr;
+	const char* rightFile = nullptr;
+	unsigned width = 735, height = 504; // Size of the synthetic pair after downscaling, the one of the sample pair
+	int window = windowWidth;
+	int maxDisp = maxDisparity;
+	unsigned tolerance = 0;
+	double maxMismatch = 0; // Percent
+	int runs = 1;
+	std::string solution = ".";
+	std::string reference = "StereoVisionCpp";
+	std::vector<std::pair<std::string, std::string>> executables;
+	const char* jsonFile = "compare.json";
+};
+
+struct Result {
+	std::string name;
+	std::string status; // ok, not built, unavailable, failed
+	double wallMs, programMs;
+	double mismatchPercent, meanDifference;
+	unsigned maxDifference;
+	bool compared, passed;
+};
+
+struct DisparityMap {
+	unsigned width = 0, height = 0;
+	std::vector<unsigned> values;
+};
+
+// Prototypes
+bool parseOptions(int, char**, Options&);
+std::string currentDirectory();
+std::string absolutePath(const std::string&);
+bool makeDirectory(const std::string&);
+void findBackend(Backend&, const Options&);
+int runBackend(const Backend&, const std::string&, const std::string&, const Options&, const std::string&, const std::string&, const std::string&);
+bool readPgm(const std::string&, DisparityMap&);
+double readProgramTime(const std::string&);
+bool writeJson(const char*, const Options&, const std::vector<Result>&, const std::string&);
+
+int main(int argc, char** argv) {
+	Options options;
+	if (!parseOptions(argc, argv, options)) {
+		std::cout << "Usage: " << argv[0] << " [--left file --right file | --size WIDTHxHEIGHT] [--window n] [--max-disparity n]"
+			<< " [--tolerance n] [--max-mismatch percent] [--runs n] [--solution dir] [--reference name]"
+			<< " [--backend name=executable]... [--json compare.json]" << std::endl;
+		return -1;
+	}
+
+	const std::string directory = currentDirectory() + "/";
+
+	std::string leftFile, rightFile;
+
+	if (options.leftFile) {
+		// The backends run in their own directory, so the paths must be absolute
+		leftFile = absolutePath(options.leftFile);
+		rightFile = absolutePath(options.rightFile);
+	} else {
+		std::cout << "Creating a synthetic " << options.width << "x" << options.height << " pair..." << std::endl;
+
+		SyntheticPair pair;
+		makeSyntheticPair(pair, options.width, options.height, options.maxDisp);
+
+		leftFile = directory + "compare_left.png";
+		rightFile = directory + "compare_right.png";
+
+		unsigned error = lodepng::encode(leftFile, grayToRgba(pair.left, options.width, options.height, scaleFactor),
+			options.width * scaleFactor, options.height * scaleFactor);
+		if (!error) {
+			error = lodepng::encode(rightFile, grayToRgba(pair.right, options.width, options.height, scaleFactor),
+				options.width * scaleFactor, options.height * scaleFactor);
+		}
+
+		if (error) {
+			std::cout << "Failed to write the synthetic pair: " << lodepng_error_text(error) << std::endl;
+			return -1;
+		}
+	}
+
+	std::vector<Backend> backends = {
+		{ "StereoVisionCpp" }, { "StereoVisionParallelCpp" }, { "StereoVisionCL" }, { "StereoVisionCuda" }
+	};
+
+	// The reference runs first, the others are compared with it
+	std::stable_partition(backends.begin(), backends.end(), [&](const Backend& backend) { return backend.name == options.reference; });
+
+	std::vector<Result> results;
+	DisparityMap reference;
+	// The backend the map in reference comes from, empty until one ran
+	std::string referenceName;
+	bool failed = false;
+
+	for (Backend& backend : backends) {
+		findBackend(backend, options);
+
+		Result result = { backend.name, "not built", 0, 0, 0, 0, 0, false, false };
+
+		const std::string outputFile = directory + "compare_" + backend.name + ".pgm";
+		const std::string traceFile = directory + "compare_" + backend.name + ".json";
+		const std::string logFile = directory + "compare_" + backend.name + ".log";
+
+		backend.workDirectory = directory + "compare_" + backend.name;
+
+		if (!backend.executable.empty() && !makeDirectory(backend.workDirectory)) {
+			std::cout << "Failed to create " << backend.workDirectory << std::endl;
+			return -1;
+		}
+
+		for (int run = 0; run < options.runs && !backend.executable.empty(); run++) {
+			remove(outputFile.c_str());
+
+			auto start = std::chrono::steady_clock::now();
+			int code = runBackend(backend, leftFile, rightFile, options, outputFile, traceFile, logFile);
+			std::chrono::duration<double, std::milli> duration = std::chrono::steady_clock::now() - start;
+
+			if (code == exitNoDevice) {
+				result.status = "unavailable";
+				break;
+			}
+
+			if (code != 0 || !fileExists(outputFile.c_str())) {
+				result.status = "failed";
+				break;
+			}
+
+			double programMs = readProgramTime(traceFile);
+
+			if (run == 0 || duration.count() < result.wallMs) result.wallMs = duration.count();
+			if (run == 0 || programMs < result.programMs) result.programMs = programMs;
+
+			result.status = "ok";
+		}
+
+		DisparityMap map;
+
+		if (result.status == "ok" && !readPgm(outputFile, map)) {
+			result.status = "failed";
+		}
+
+		if (result.status == "failed") {
+			failed = true;
+		}
+
+		if (result.status == "ok") {
+			if (reference.values.empty()) {
+				// The first backend that ran is the reference, the preferred one if it is available
+				reference = map;
+				referenceName = backend.name;
+				result.compared = result.passed = true;
+			} else if (map.width != reference.width || map.height != reference.height) {
+				result.compared = true;
+				result.mismatchPercent = 100;
+			} else {
+				unsigned long long mismatches = 0, differences = 0;
+
+				for (size_t i = 0; i < map.values.size(); i++) {
+					unsigned difference = (unsigned)abs((int)map.values[i] - (int)reference.values[i]);
+
+					differences += difference;
+					if (difference > options.tolerance) mismatches++;
+					result.maxDifference = std::max(result.maxDifference, difference);
+				}
+
+				result.compared = true;
+				result.mismatchPercent = 100.0 * mismatches / map.values.size();
+				result.meanDifference = (double)differences / map.values.size();
+				result.passed = result.mismatchPercent <= options.maxMismatch;
+			}
+
+			if (!result.passed) failed = true;
+		}
+
+		results.push_back(result);
+	}
+
+	std::cout << std::endl << "Backend                     status         wall ms  program ms  mismatch %  max diff  mean diff" << std::endl;
+
+	for (const Result& result : results) {
+		char line[200];
+
+		if (result.status != "ok") {
+			snprintf(line, sizeof(line), "%-27s %-12s", result.name.c_str(), result.status.c_str());
+		} else {
+			snprintf(line, sizeof(line), "%-27s %-12s %10.1f %11.1f %11.3f %9u %10.4f  %s",
+				result.name.c_str(), result.status.c_str(), result.wallMs, result.programMs, result.mismatchPercent,
+				result.maxDifference, result.meanDifference,
+				result.name == referenceName ? "reference" : result.passed ? "pass" : "FAIL");
+		}
+
+		std::cout << line << std::endl;
+	}
+
+	if (!writeJson(options.jsonFile, options, results, referenceName)) {
+		std::cout << "Failed to write " << options.jsonFile << std::endl;
+		return -1;
+	}
+
+	return failed ? 1 : 0;
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+	for (int i = 1; i < argc; i++) {
+		if (i + 1 >= argc) {
+			return false;
+		} else if (!strcmp(argv[i], "--left")) {
+			options.leftFile = argv[++i];
+		} else if (!strcmp(argv[i], "--right")) {
+			options.rightFile = argv[++i];
+		} else if (!strcmp(argv[i], "--size")) {
+			if (sscanf(argv[++i], "%ux%u", &options.width, &options.height) != 2 || !options.width || !options.height) return false;
+		} else if (!strcmp(argv[i], "--window")) {
+			options.window = atoi(argv[++i]);
+			if (options.window <= 0) return false;
+		} else if (!strcmp(argv[i], "--max-disparity")) {
+			options.maxDisp = atoi(argv[++i]);
+			if (options.maxDisp <= 0) return false;
+		} else if (!strcmp(argv[i], "--tolerance")) {
+			options.tolerance = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "--max-mismatch")) {
+			options.maxMismatch = atof(argv[++i]);
+		} else if (!strcmp(argv[i], "--runs")) {
+			options.runs = atoi(argv[++i]);
+			if (options.runs <= 0) return false;
+		} else if (!strcmp(argv[i], "--solution")) {
+			options.solution = argv[++i];
+		} else if (!strcmp(argv[i], "--reference")) {
+			options.reference = argv[++i];
+		} else if (!strcmp(argv[i], "--backend")) {
+			const char* separator = strchr(argv[++i], '=');
+			if (!separator) return false;
+			options.executables.emplace_back(std::string(argv[i], separator - argv[i]), std::string(separator + 1));
+		} else if (!strcmp(argv[i], "--json")) {
+			options.jsonFile = argv[++i];
+		} else {
+			return false;
+		}
+	}
+
+	// Both images or none
+	return !options.leftFile == !options.rightFile;
+}
+
+std::string currentDirectory() {
+	char buffer[4096];
+
+#ifdef _WIN32
+	if (!_getcwd(buffer, sizeof(buffer))) return ".";
+#else
+	if (!getcwd(buffer, sizeof(buffer))) return ".";
+#endif
+
+	return buffer;
+}
+
+std::string absolutePath(const std::string& path) {
+	if (path[0] == '/' || path[0] == '\\' || (path.size() > 1 && path[1] == ':')) {
+		return path;
+	}
+
+	return currentDirectory() + "/" + path;
+}
+
+// Creates the directory if it doesn't exist yet
+bool makeDirectory(const std::string& path) {
+#ifdef _WIN32
+	return !_mkdir(path.c_str()) || errno == EEXIST;
+#else
+	return !mkdir(path.c_str(), 0755) || errno == EEXIST;
+#endif
+}
+
+void findBackend(Backend& backend, const Options& options) {
+	backend.directory = options.solution + "/" + backend.name;
+	backend.executable.clear();
+
+	for (const auto& executable : options.executables) {
+		if (executable.first == backend.name) {
+			backend.executable = executable.second;
+			return;
+		}
+	}
+
+	const std::string candidates[] = {
+		options.solution + "/x64/Release/" + backend.name + ".exe",
+		options.solution + "/x64/Debug/" + backend.name + ".exe",
+		options.solution + "/Release/" + backend.name + ".exe",
+		options.solution + "/Debug/" + backend.name + ".exe",
+		backend.directory + "/" + backend.name
+	};
+
+	for (const std::string& candidate : candidates) {
+		if (fileExists(candidate.c_str())) {
+			backend.executable = candidate;
+			return;
+		}
+	}
+}
+
+/*
+Runs a backend in its scratch directory with the shared options, its console output goes to logFile.
+* Standard input is the null device, so the backends don't wait for a key press at the end.
+* The backends that write more than the shared options ask for get options of their own to avoid it.
+* Returns the exit code of the process.
+*/
+int runBackend(
+	const Backend& backend,
+	const std::string& leftFile,
+	const std::string& rightFile,
+	const Options& options,
+	const std::string& outputFile,
+	const std::string& traceFile,
+	const std::string& logFile
+) {
+	// Relative executables are found from the directory of the harness, not from the one of the backend
+	const std::string executable = absolutePath(backend.executable);
+
+	std::ostringstream command;
+
+#ifdef _WIN32
+	// cmd strips the outer quotes of a command starting with one, the extra pair keeps the inner ones
+	command << "\"cd /d \"" << backend.workDirectory << "\" && \"" << executable << "\"";
+#else
+	command << "cd \"" << backend.workDirectory << "\" && \"" << executable << "\"";
+#endif
+
+	command << " --left \"" << leftFile << "\" --right \"" << rightFile << "\""
+		<< " --window " << options.window << " --max-disparity " << options.maxDisp
+		<< " --output \"" << outputFile << "\" --profile \"" << traceFile << "\"";
+
+	if (backend.name == "StereoVisionCpp") {
+		command << " --verbosity 0";
+	} else if (backend.name == "StereoVisionCL") {
+		command << " --kernel-dir \"" << absolutePath(backend.directory) << "\"";
+	}
+
+#ifdef _WIN32
+	command << " < NUL > \"" << logFile << "\" 2>&1\"";
+#else
+	command << " < /dev/null > \"" << logFile << "\" 2>&1";
+#endif
+
+	std::cout << "Running " << backend.name << "..." << std::endl;
+
+	int status = system(command.str().c_str());
+
+#ifdef _WIN32
+	return status;
+#else
+	return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+#endif
+}
+
+// Binary PGM with 8 or 16 bit samples, as written by the backends
+bool readPgm(const std::string& filename, DisparityMap& map) {
+	std::ifstream file(filename, std::ios::binary);
+
+	std::string magic;
+	unsigned maxValue = 0;
+
+	file >> magic >> map.width >> map.height >> maxValue;
+	file.get(); // The single whitespace before the samples
+
+	if (!file || magic != "P5" || !maxValue || maxValue > 65535) return false;
+
+	const size_t size = (size_t)map.width * map.height;
+	const size_t sampleBytes = maxValue > 255 ? 2 : 1;
+
+	std::vector<unsigned char> samples(size * sampleBytes);
+	if (!file.read((char*)samples.data(), samples.size())) return false;
+
+	map.values.resize(size);
+	for (size_t i = 0; i < size; i++) {
+		map.values[i] = sampleBytes == 2 ? (samples[2 * i] << 8) | samples[2 * i + 1] : samples[i];
+	}
+
+	return true;
+}
+
+// Duration of the "program" zone in the Chrome trace of a backend in ms, 0 if there is none
+double readProgramTime(const std::string& filename) {
+	std::ifstream file(filename);
+	std::string line;
+
+	// The trace has one event per line
+	while (std::getline(file, line)) {
+		if (line.find("\"name\":\"program\"") == std::string::npos) continue;
+
+		size_t position = line.find("\"dur\":");
+		if (position != std::string::npos) {
+			return atof(line.c_str() + position + 6) / 1000;
+		}
+	}
+
+	return 0;
+}
+
+bool writeJson(const char* filename, const Options& options, const std::vector<Result>& results, const std::string& referenceName) {
+	std::ofstream out(filename);
+	if (!out) return false;
+
+	out << "{\n  \"window\": " << options.window << ",\n  \"maxDisparity\": " << options.maxDisp
+		<< ",\n  \"tolerance\": " << options.tolerance << ",\n  \"maxMismatchPercent\": " << options.maxMismatch
+		<< ",\n  \"reference\": ";
+
+	// null if no backend ran
+	if (referenceName.empty()) {
+		out << "null";
+	} else {
+		out << "\"" << referenceName << "\"";
+	}
+
+	out << ",\n  \"backends\": [";
+
+	char line[512];
+
+	for (size_t i = 0; i < results.size(); i++) {
+		const Result& result = results[i];
+
+		snprintf(line, sizeof(line),
+			"%s\n    {\"name\": \"%s\", \"status\": \"%s\", \"wallMs\": %.3f, \"programMs\": %.3f, \"compared\": %s,"
+			" \"mismatchPercent\": %.4f, \"maxDifference\": %u, \"meanDifference\": %.5f, \"passed\": %s}",
+			i ? "," : "", result.name.c_str(), result.status.c_str(), result.wallMs, result.programMs,
+			result.compared ? "true" : "false", result.mismatchPercent, result.maxDifference, result.meanDifference,
+			result.passed ? "true" : "false");
+
+		out << line;
+	}
+
+	out << "\n  ]\n}\n";
+
+	return (bool)out;
+}
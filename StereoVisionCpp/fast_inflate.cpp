@@ -0,0 +1,565 @@
+#include "fast_inflate.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+static const unsigned short lengthBase[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const unsigned char lengthExtra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const unsigned short distanceBase[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const unsigned char distanceExtra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+static const unsigned char codeLengthOrder[19] = {
+	16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+constexpr unsigned litLenBits = 11;
+constexpr unsigned distanceBits = 9;
+constexpr unsigned codeLengthBits = 7;
+
+// Room kept free at the end of the output for a whole match, plus the 7 bytes a match copy may write past its end
+constexpr size_t outputSlack = 258 + 8;
+
+/*
+Lookup table and canonical code of a huffman tree.
+* An entry holds the number of bits it consumes in bits 0-7, 0 if the code is longer than the table.
+* Bits 8-9 hold the number of literals in the entry (0 for other symbols or for trees that aren't literal/length trees),
+  bits 16-31 the literals, first one in the low byte, or the symbol.
+*/
+struct HuffmanTable {
+	unsigned table[1 << litLenBits];
+	unsigned short count[16];
+	unsigned short symbol[288];
+};
+
+/*
+Builds the table for codes up to bits long.
+* With literals, an entry whose literal code leaves room for a second complete literal code holds both.
+* Incomplete codes are allowed (deflate uses them for distance trees with a single code), over subscribed ones are not.
+*/
+static unsigned buildTable(HuffmanTable& h, const unsigned char* lengths, const unsigned n, const unsigned bits, const bool literals) {
+	memset(h.count, 0, sizeof(h.count));
+	for (unsigned i = 0; i < n; i++) {
+		h.count[lengths[i]]++;
+	}
+	h.count[0] = 0;
+
+	int left = 1;
+	for (int len = 1; len < 16; len++) {
+		left <<= 1;
+		left -= h.count[len];
+		if (left < 0) return 55;
+	}
+
+	unsigned short offsets[16];
+	offsets[1] = 0;
+	for (int len = 1; len < 15; len++) {
+		offsets[len + 1] = offsets[len] + h.count[len];
+	}
+
+	for (unsigned i = 0; i < n; i++) {
+		if (lengths[i]) {
+			h.symbol[offsets[lengths[i]]++] = i;
+		}
+	}
+
+	const unsigned size = 1u << bits;
+	unsigned single[1 << litLenBits];
+	memset(single, 0, size * sizeof(unsigned));
+
+	unsigned code = 0, index = 0;
+	for (unsigned len = 1; len <= bits; len++) {
+		for (unsigned k = 0; k < h.count[len]; k++, code++, index++) {
+			// Bits arrive least significant first, so the table is indexed by the reversed code
+			unsigned reversed = 0;
+			for (unsigned b = 0; b < len; b++) {
+				reversed |= ((code >> b) & 1) << (len - 1 - b);
+			}
+
+			unsigned symbol = h.symbol[index];
+			unsigned entry = len | (symbol << 16) | (literals && symbol < 256 ? 1u << 8 : 0);
+			for (unsigned fill = reversed; fill < size; fill += 1u << len) {
+				single[fill] = entry;
+			}
+		}
+		code <<= 1;
+	}
+
+	for (unsigned i = 0; i < size; i++) {
+		unsigned first = single[i];
+		unsigned len = first & 255;
+		h.table[i] = first;
+
+		if (!literals || len == 0 || len >= bits || ((first >> 8) & 3) != 1) continue;
+
+		// The bits after the first code are the low bits of i >> len, enough of them if the second code is short
+		unsigned second = single[i >> len];
+		unsigned secondLen = second & 255;
+
+		if (secondLen == 0 || len + secondLen > bits || ((second >> 8) & 3) != 1) continue;
+
+		h.table[i] = (len + secondLen) | (2u << 8) | (first & 0xff0000u) | ((second & 0xff0000u) << 8);
+	}
+
+	return 0;
+}
+
+/*
+Input of the decoder, read through a 64 bit buffer.
+* Past the end of the input the buffer is filled with zero bytes which are counted in overrun,
+  it is an error once any of them is consumed.
+* A plain struct, so the hot loop can keep a copy in registers, writes to the output could alias members of the decoder.
+*/
+struct BitReader {
+	const unsigned char* in;
+	const unsigned char* inEnd;
+	unsigned long long buffer;
+	unsigned count;
+	unsigned overrun;
+
+	static inline unsigned long long load64(const unsigned char* p) {
+		// Compilers turn this into a single load on little endian machines
+		return (unsigned long long)p[0] | ((unsigned long long)p[1] << 8) | ((unsigned long long)p[2] << 16) |
+			((unsigned long long)p[3] << 24) | ((unsigned long long)p[4] << 32) | ((unsigned long long)p[5] << 40) |
+			((unsigned long long)p[6] << 48) | ((unsigned long long)p[7] << 56);
+	}
+
+	// Fills the bit buffer to at least 56 bits, false if bits past the end of the input were consumed
+	inline bool refill() {
+		if (inEnd - in >= 8) {
+			// Only the whole bytes that fit are counted, the rest of the word is loaded again next time
+			buffer |= load64(in) << count;
+			in += (63 - count) >> 3;
+			count |= 56;
+			return true;
+		}
+
+		if (overrun * 8 > count) return false;
+
+		while (count <= 56) {
+			if (in < inEnd) {
+				buffer |= (unsigned long long)*in++ << count;
+			} else {
+				overrun++;
+			}
+			count += 8;
+		}
+
+		return true;
+	}
+
+	inline unsigned take(const unsigned n) {
+		unsigned value = (unsigned)(buffer & ((1ull << n) - 1));
+		buffer >>= n;
+		count -= n;
+
+		return value;
+	}
+
+	// Bit by bit decoding of codes longer than the table, the bit buffer must hold at least 15 bits
+	unsigned slowDecode(const HuffmanTable& h, unsigned& symbol) {
+		int code = 0, first = 0, index = 0;
+		for (unsigned len = 1; len < 16; len++) {
+			code |= (buffer >> (len - 1)) & 1;
+			int codes = h.count[len];
+			if (code - codes < first) {
+				symbol = h.symbol[index + (code - first)];
+				take(len);
+				return 0;
+			}
+			index += codes;
+			first += codes;
+			first <<= 1;
+			code <<= 1;
+		}
+
+		return 11;
+	}
+
+	inline unsigned decode(const HuffmanTable& h, const unsigned bits, unsigned& symbol) {
+		unsigned entry = h.table[buffer & ((1u << bits) - 1)];
+		unsigned len = entry & 255;
+		if (!len) return slowDecode(h, symbol);
+
+		take(len);
+		symbol = entry >> 16;
+		return 0;
+	}
+};
+
+class FastInflater {
+private:
+	BitReader m_Bits;
+
+	unsigned char* m_Out;
+	size_t m_Start, m_Pos, m_Capacity;
+
+	bool m_IgnoreNlen;
+
+	HuffmanTable m_LitLen, m_Distance;
+
+	bool grow(const size_t needed) {
+		size_t capacity = m_Capacity * 2;
+		if (capacity < needed) capacity = needed;
+
+		unsigned char* data = (unsigned char*)realloc(m_Out, capacity);
+		if (!data) return false;
+
+		m_Out = data;
+		m_Capacity = capacity;
+		return true;
+	}
+
+	unsigned storedBlock() {
+		BitReader& bits = m_Bits;
+
+		// Byte align, then give the whole bytes still in the bit buffer back to the input
+		bits.take(bits.count & 7);
+		if (bits.overrun * 8 > bits.count) return 52;
+
+		bits.in -= (bits.count >> 3) - bits.overrun;
+		bits.buffer = 0;
+		bits.count = 0;
+		bits.overrun = 0;
+
+		if (bits.inEnd - bits.in < 4) return 52;
+
+		unsigned length = bits.in[0] | (bits.in[1] << 8);
+		unsigned nlength = bits.in[2] | (bits.in[3] << 8);
+		bits.in += 4;
+
+		if (!m_IgnoreNlen && length + nlength != 65535) return 21;
+		if ((size_t)(bits.inEnd - bits.in) < length) return 23;
+
+		if (m_Capacity - m_Pos < length + outputSlack && !grow(m_Pos + length + outputSlack)) return 83;
+
+		memcpy(m_Out + m_Pos, bits.in, length);
+		m_Pos += length;
+		bits.in += length;
+
+		return 0;
+	}
+
+	unsigned dynamicTrees() {
+		BitReader& bits = m_Bits;
+
+		if (!bits.refill()) return 49;
+
+		unsigned nlen = bits.take(5) + 257;
+		unsigned ndist = bits.take(5) + 1;
+		unsigned ncode = bits.take(4) + 4;
+
+		if (nlen > 286 || ndist > 30) return 13;
+
+		unsigned char lengths[320] = { 0 };
+
+		for (unsigned i = 0; i < ncode; i++) {
+			// 19 lengths of 3 bits don't fit into one refill
+			if (bits.count < 3 && !bits.refill()) return 50;
+			lengths[codeLengthOrder[i]] = (unsigned char)bits.take(3);
+		}
+
+		HuffmanTable& codeLengths = m_Distance; // Not needed anymore once the other trees are built
+		if (buildTable(codeLengths, lengths, 19, codeLengthBits, false)) return 16;
+
+		unsigned char treeLengths[320] = { 0 };
+		unsigned index = 0;
+		while (index < nlen + ndist) {
+			if (!bits.refill()) return 50;
+
+			unsigned symbol;
+			unsigned error = bits.decode(codeLengths, codeLengthBits, symbol);
+			if (error) return error;
+
+			if (symbol < 16) {
+				treeLengths[index++] = (unsigned char)symbol;
+				continue;
+			}
+
+			unsigned char value = 0;
+			unsigned repeat;
+
+			if (symbol == 16) {
+				if (index == 0) return 54;
+				value = treeLengths[index - 1];
+				repeat = 3 + bits.take(2);
+			} else if (symbol == 17) {
+				repeat = 3 + bits.take(3);
+			} else {
+				repeat = 11 + bits.take(7);
+			}
+
+			if (index + repeat > nlen + ndist) return symbol == 16 ? 13 : (symbol == 17 ? 14 : 15);
+
+			while (repeat--) {
+				treeLengths[index++] = value;
+			}
+		}
+
+		if (treeLengths[256] == 0) return 64;
+
+		if (buildTable(m_LitLen, treeLengths, nlen, litLenBits, true)) return 55;
+		if (buildTable(m_Distance, treeLengths + nlen, ndist, distanceBits, false)) return 55;
+
+		return 0;
+	}
+
+	// Decodes symbols until the end code, the state is copied to locals and stored back when done
+	unsigned huffmanBlock(const HuffmanTable& litLen, const HuffmanTable& distance) {
+		BitReader bits = m_Bits;
+		unsigned char* out = m_Out;
+		size_t pos = m_Pos;
+
+		unsigned error = decodeSymbols(bits, out, pos, litLen, distance);
+
+		m_Bits = bits;
+		m_Pos = pos;
+
+		return error;
+	}
+
+	inline unsigned decodeSymbols(BitReader& bits, unsigned char*& out, size_t& pos, const HuffmanTable& litLen, const HuffmanTable& distance) {
+		const unsigned litLenMask = (1u << litLenBits) - 1;
+		const size_t start = m_Start;
+		size_t limit = m_Capacity - outputSlack;
+
+		for (;;) {
+			if (pos > limit) {
+				m_Pos = pos;
+				if (!grow(pos + outputSlack)) return 83;
+
+				out = m_Out;
+				limit = m_Capacity - outputSlack;
+			}
+
+			// A whole sequence needs at most 15 + 5 + 15 + 13 bits, one refill covers it
+			if (bits.count < 48 && !bits.refill()) return 10;
+
+			unsigned entry = litLen.table[bits.buffer & litLenMask];
+			unsigned symbol;
+
+			if (entry & 255) {
+				bits.take(entry & 255);
+
+				unsigned count = (entry >> 8) & 3;
+				if (count) {
+					out[pos] = (unsigned char)(entry >> 16);
+					out[pos + 1] = (unsigned char)(entry >> 24);
+					pos += count;
+					continue;
+				}
+
+				symbol = entry >> 16;
+			} else {
+				unsigned error = bits.slowDecode(litLen, symbol);
+				if (error) return error;
+
+				if (symbol < 256) {
+					out[pos++] = (unsigned char)symbol;
+					continue;
+				}
+			}
+
+			if (symbol == 256) return 0;
+
+			symbol -= 257;
+			if (symbol >= 29) return 16;
+
+			unsigned length = lengthBase[symbol] + bits.take(lengthExtra[symbol]);
+
+			unsigned error = bits.decode(distance, distanceBits, symbol);
+			if (error) return error;
+			if (symbol >= 30) return 18;
+
+			unsigned dist = distanceBase[symbol] + bits.take(distanceExtra[symbol]);
+			if (dist > pos - start) return 52;
+
+			unsigned char* dst = out + pos;
+			const unsigned char* src = dst - dist;
+
+			if (dist >= 8) {
+				// Every 8 byte copy reads bytes that were completely written before, may run up to 7 bytes past the end
+				unsigned char* end = dst + length;
+				do {
+					memcpy(dst, src, 8);
+					dst += 8;
+					src += 8;
+				} while (dst < end);
+			} else if (dist == 1) {
+				memset(dst, *src, length);
+			} else {
+				for (unsigned i = 0; i < length; i++) {
+					dst[i] = src[i];
+				}
+			}
+
+			pos += length;
+		}
+	}
+
+public:
+	// The output is appended to the size bytes already in out, like lodepng_zlib_decompress does
+	FastInflater(const unsigned char* in, const size_t insize, unsigned char* out, const size_t size, const bool ignoreNlen) :
+		m_Bits{ in, in + insize, 0, 0, 0 }, m_Out(out), m_Start(size), m_Pos(size), m_Capacity(size), m_IgnoreNlen(ignoreNlen) {}
+
+	unsigned run() {
+		// Built once on first use, function local statics are thread safe to initialize
+		struct FixedTrees {
+			HuffmanTable litLen, distance;
+
+			FixedTrees() {
+				unsigned char lengths[288];
+				for (int i = 0; i < 144; i++) lengths[i] = 8;
+				for (int i = 144; i < 256; i++) lengths[i] = 9;
+				for (int i = 256; i < 280; i++) lengths[i] = 7;
+				for (int i = 280; i < 288; i++) lengths[i] = 8;
+				buildTable(litLen, lengths, 288, litLenBits, true);
+
+				for (int i = 0; i < 30; i++) lengths[i] = 5;
+				buildTable(distance, lengths, 30, distanceBits, false);
+			}
+		};
+		static const FixedTrees fixed;
+
+		// PNG data usually inflates to a few times its size
+		if (!grow(m_Pos + (m_Bits.inEnd - m_Bits.in) * 4 + 65536)) return 83;
+
+		bool last = false;
+		while (!last) {
+			if (!m_Bits.refill()) return 23;
+
+			last = m_Bits.take(1);
+			unsigned type = m_Bits.take(2);
+
+			unsigned error;
+			if (type == 0) {
+				error = storedBlock();
+			} else if (type == 1) {
+				error = huffmanBlock(fixed.litLen, fixed.distance);
+			} else if (type == 2) {
+				error = dynamicTrees();
+				if (!error) error = huffmanBlock(m_LitLen, m_Distance);
+			} else {
+				error = 20;
+			}
+
+			if (error) return error;
+		}
+
+		// The end code must not have been read from the zero bytes past the end of the input
+		if (m_Bits.overrun * 8 > m_Bits.count) return 10;
+
+		return 0;
+	}
+
+	inline unsigned char* data() { return m_Out; }
+	inline size_t size() const { return m_Pos; }
+};
+
+unsigned fastInflate(
+	unsigned char** out,
+	size_t* outsize,
+	const unsigned char* in,
+	size_t insize,
+	const LodePNGDecompressSettings* settings
+) {
+	// The output is allocated with realloc, which matches lodepng's default allocators.
+	// The inflater is on the heap because its tables take about 17 KB.
+	std::unique_ptr<FastInflater> inflater(new FastInflater(in, insize, *out, *outsize, settings->ignore_nlen != 0));
+	unsigned error = inflater->run();
+
+	*out = inflater->data();
+	*outsize = inflater->size();
+
+	return error;
+}
+
+static unsigned adler32(const unsigned char* data, size_t length) {
+	unsigned s1 = 1, s2 = 0;
+
+	while (length) {
+		// At least 5552 sums can be done before they overflow
+		size_t amount = length > 5552 ? 5552 : length;
+		length -= amount;
+
+		for (; amount >= 8; amount -= 8, data += 8) {
+			s1 += data[0]; s2 += s1;
+			s1 += data[1]; s2 += s1;
+			s1 += data[2]; s2 += s1;
+			s1 += data[3]; s2 += s1;
+			s1 += data[4]; s2 += s1;
+			s1 += data[5]; s2 += s1;
+			s1 += data[6]; s2 += s1;
+			s1 += data[7]; s2 += s1;
+		}
+		for (; amount; amount--) {
+			s1 += *data++;
+			s2 += s1;
+		}
+
+		s1 %= 65521;
+		s2 %= 65521;
+	}
+
+	return (s2 << 16) | s1;
+}
+
+unsigned fastZlibDecompress(
+	unsigned char** out,
+	size_t* outsize,
+	const unsigned char* in,
+	size_t insize,
+	const LodePNGDecompressSettings* settings
+) {
+	if (insize < 2) return 53;
+
+	if ((in[0] * 256 + in[1]) % 31 != 0) return 24;
+	if ((in[0] & 15) != 8 || (in[0] >> 4) > 7) return 25;
+	if ((in[1] >> 5) & 1) return 26;
+
+	const size_t start = *outsize;
+
+	unsigned error = fastInflate(out, outsize, in + 2, insize - 2, settings);
+	if (error) return error;
+
+	if (!settings->ignore_adler32) {
+		if (insize < 6) return 53;
+
+		unsigned checksum = ((unsigned)in[insize - 4] << 24) | ((unsigned)in[insize - 3] << 16) |
+			((unsigned)in[insize - 2] << 8) | in[insize - 1];
+		if (checksum != adler32(*out + start, *outsize - start)) return 58;
+	}
+
+	return 0;
+}
+
+unsigned fastDecode(
+	std::vector<unsigned char>& out,
+	unsigned& width,
+	unsigned& height,
+	const char* filename,
+	LodePNGColorType colorType,
+	unsigned bitDepth
+) {
+	std::vector<unsigned char> png;
+	unsigned error = lodepng::load_file(png, filename);
+	if (error) return error;
+
+	lodepng::State state;
+	state.info_raw.colortype = colorType;
+	state.info_raw.bitdepth = bitDepth;
+	useFastInflate(state.decoder.zlibsettings);
+
+	return lodepng::decode(out, width, height, state, png);
+}
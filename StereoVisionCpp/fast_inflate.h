@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "lodepng.h"
+
+/*
+Deflate decoder for whole buffers, faster than the one built into lodepng.
+* The bit buffer is 64 bits wide and refilled with up to 8 bytes at once, so a whole literal/length/distance
+  sequence can be decoded without checking the input in between.
+* The literal/length codes are decoded with an 11 bit lookup table whose entries hold up to two literals,
+  the distance codes with a 9 bit table. Only longer codes are decoded bit by bit.
+* Matches are copied 8 bytes at a time, the output buffer keeps some slack at its end for that.
+* The functions have the signatures of the custom_zlib and custom_inflate hooks of LodePNGDecompressSettings,
+  and return the same error codes as lodepng.
+* settings->ignore_nlen skips the length check of stored blocks, like in lodepng.
+*/
+unsigned fastInflate(
+	unsigned char** out,
+	size_t* outsize,
+	const unsigned char* in,
+	size_t insize,
+	const LodePNGDecompressSettings* settings
+);
+
+// zlib header, fastInflate and the adler32 check (unless settings->ignore_adler32)
+unsigned fastZlibDecompress(
+	unsigned char** out,
+	size_t* outsize,
+	const unsigned char* in,
+	size_t insize,
+	const LodePNGDecompressSettings* settings
+);
+
+// Makes lodepng decode with fastZlibDecompress
+inline void useFastInflate(LodePNGDecompressSettings& settings) {
+	settings.custom_zlib = fastZlibDecompress;
+}
+
+// lodepng::decode of a PNG file with fastZlibDecompress
+unsigned fastDecode(
+	std::vector<unsigned char>& out,
+	unsigned& width,
+	unsigned& height,
+	const char* filename,
+	LodePNGColorType colorType = LCT_RGBA,
+	unsigned bitDepth = 8
+);
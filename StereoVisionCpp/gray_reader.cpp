@@ -0,0 +1,106 @@
+#include "gray_reader.h"
+
+#include <cctype>
+#include <cstring>
+
+#include "ground_truth.h"
+#include "lodepng.h"
+#include "png_gray.h"
+#include "raw_gray.h"
+#include "tile_container.h"
+
+// Case insensitive check of the file extension
+static bool hasExtension(const char* filename, const char* extension) {
+	size_t length = strlen(filename);
+	size_t extensionLength = strlen(extension);
+
+	if (length < extensionLength) return false;
+
+	for (size_t i = 0; i < extensionLength; i++) {
+		if (tolower((unsigned char)filename[length - extensionLength + i]) != extension[i]) return false;
+	}
+
+	return true;
+}
+
+unsigned openGrayReader(
+	std::unique_ptr<GrayReader>& reader,
+	const char* filename,
+	const int scaleFactor,
+	const RawFormat* raw
+) {
+	// The scale factor is fixed when a reader is created
+	if (reader && reader->getScaleFactor() != scaleFactor) {
+		reader.reset();
+	}
+
+	if (raw || hasExtension(filename, ".pgm") || hasExtension(filename, ".ppm") || hasExtension(filename, ".pnm")) {
+		RawGrayReader* rawReader = dynamic_cast<RawGrayReader*>(reader.get());
+		if (!rawReader) {
+			rawReader = new RawGrayReader(scaleFactor);
+			reader.reset(rawReader);
+		}
+
+		return raw ? rawReader->openRaw(filename, *raw) : rawReader->open(filename);
+	}
+
+	PngGrayReader* pngReader = dynamic_cast<PngGrayReader*>(reader.get());
+	if (!pngReader) {
+		pngReader = new PngGrayReader(scaleFactor);
+		reader.reset(pngReader);
+	}
+
+	return pngReader->open(filename);
+}
+
+unsigned decodeScaledGray(
+	std::vector<unsigned>& gray,
+	unsigned& width,
+	unsigned& height,
+	const char* filename,
+	const int scaleFactor,
+	const RawFormat* raw
+) {
+	std::unique_ptr<GrayReader> reader;
+
+	return decodeScaledGray(gray, width, height, reader, filename, scaleFactor, raw);
+}
+
+unsigned decodeScaledGray(
+	std::vector<unsigned>& gray,
+	unsigned& width,
+	unsigned& height,
+	std::unique_ptr<GrayReader>& reader,
+	const char* filename,
+	const int scaleFactor,
+	const RawFormat* raw
+) {
+	unsigned error = openGrayReader(reader, filename, scaleFactor, raw);
+	if (error) return error;
+
+	width = reader->fullWidth();
+	height = reader->fullHeight();
+
+	gray.resize(reader->width() * reader->height());
+
+	for (unsigned i = 0; i < reader->height() && !error; i++) {
+		error = reader->nextRow(&gray[i * reader->width()]);
+	}
+
+	return error;
+}
+
+const char* imageErrorText(const unsigned error) {
+	switch (error) {
+	case errorInvalidPnmHeader: return "invalid PGM/PPM header, only binary P5 and P6 files are supported";
+	case errorFileTooSmall: return "file is too small for the given image dimensions";
+	case errorInvalidRawFormat: return "invalid raw format, width and height must be nonzero and channels 1, 3 or 4";
+	case errorInvalidContainer: return "invalid or unfinished tile container";
+	case errorMissingTile: return "the tile was never written to the container";
+	case errorRegionOutside: return "the region is outside of the map";
+	case errorInvalidPfm: return "invalid PFM file, only single channel Pf files are supported";
+	case errorGroundTruthSize: return "the ground truth is not an integer multiple of the disparity map size";
+	}
+
+	return lodepng_error_text(error);
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+/*
+Common interface of the readers that turn an input image into the downscaled grayscale rows of the stereo pipeline.
+* Every reader picks the same source pixels and uses the same weights as scaleAndGray.
+* Rows are produced top to bottom, one per nextRow call.
+* All methods return an error code, 0 on success, see imageErrorText.
+*/
+class GrayReader {
+protected:
+	int m_ScaleFactor;
+	unsigned m_Width, m_Height;
+
+public:
+	GrayReader(const int scaleFactor) : m_ScaleFactor(scaleFactor), m_Width(0), m_Height(0) {}
+	virtual ~GrayReader() {}
+
+	// Converts the next downscaled gray row into out, which must hold width() values
+	virtual unsigned nextRow(unsigned* out) = 0;
+
+	// Size of the downscaled image
+	inline unsigned width() const { return m_Width / m_ScaleFactor; }
+	inline unsigned height() const { return m_Height / m_ScaleFactor; }
+
+	// Size of the original image
+	inline unsigned fullWidth() const { return m_Width; }
+	inline unsigned fullHeight() const { return m_Height; }
+
+	inline int getScaleFactor() const { return m_ScaleFactor; }
+};
+
+/*
+Dimensions of a raw headerless image, 8 bits per sample with 1 (gray), 3 (RGB) or 4 (RGBA) interleaved channels.
+*/
+struct RawFormat {
+	unsigned width, height, channels;
+};
+
+// Error codes of the PGM/PPM and raw readers, above the ones used by lodepng
+constexpr unsigned errorInvalidPnmHeader = 200;
+constexpr unsigned errorFileTooSmall = 201;
+constexpr unsigned errorInvalidRawFormat = 202;
+
+/*
+Opens a reader for the given file.
+* With a raw format the file is read as raw headerless samples.
+  Otherwise .pgm, .ppm and .pnm files are read as binary PGM/PPM and everything else as PNG.
+* An existing reader of the right type is opened again instead of being replaced, so its buffers are reused.
+*/
+unsigned openGrayReader(
+	std::unique_ptr<GrayReader>& reader,
+	const char* filename,
+	const int scaleFactor,
+	const RawFormat* raw = nullptr
+);
+
+/*
+Reads a whole image with openGrayReader.
+* width and height receive the size of the original image, the result is (width / scaleFactor) * (height / scaleFactor).
+* The second version reuses the given reader and the capacity of gray, for decoding one frame after another.
+*/
+unsigned decodeScaledGray(
+	std::vector<unsigned>& gray,
+	unsigned& width,
+	unsigned& height,
+	const char* filename,
+	const int scaleFactor,
+	const RawFormat* raw = nullptr
+);
+unsigned decodeScaledGray(
+	std::vector<unsigned>& gray,
+	unsigned& width,
+	unsigned& height,
+	std::unique_ptr<GrayReader>& reader,
+	const char* filename,
+	const int scaleFactor,
+	const RawFormat* raw = nullptr
+);
+
+// Description of the error codes of the readers, the tile container and the ground truth, including the lodepng ones
+const char* imageErrorText(const unsigned error);
@@ -0,0 +1,144 @@
+#include "ground_truth.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <string>
+
+#include "lodepng.h"
+
+static unsigned loadPfm(GroundTruth& truth, const char* filename) {
+	std::ifstream file(filename, std::ios::binary);
+	if (!file) return 78; // lodepng's error for files that can't be opened
+
+	std::string magic;
+	double scale = 0;
+
+	file >> magic >> truth.width >> truth.height >> scale;
+	file.get(); // The single whitespace before the samples
+
+	if (!file || magic != "Pf" || !truth.width || !truth.height || scale == 0) return errorInvalidPfm;
+
+	// A negative scale means little endian samples
+	const bool littleEndian = scale < 0;
+	const size_t size = (size_t)truth.width * truth.height;
+
+	std::vector<unsigned char> samples(size * 4);
+	if (!file.read((char*)samples.data(), samples.size())) return errorInvalidPfm;
+
+	truth.disparity.resize(size);
+
+	for (unsigned i = 0; i < truth.height; i++) {
+		// The bottom row comes first
+		const unsigned char* row = &samples[(size_t)(truth.height - 1 - i) * truth.width * 4];
+
+		for (unsigned j = 0; j < truth.width; j++) {
+			const unsigned char* bytes = &row[j * 4];
+
+			uint32_t bits = littleEndian
+				? bytes[0] | bytes[1] << 8 | bytes[2] << 16 | (uint32_t)bytes[3] << 24
+				: bytes[3] | bytes[2] << 8 | bytes[1] << 16 | (uint32_t)bytes[0] << 24;
+
+			float value;
+			memcpy(&value, &bits, sizeof(value));
+
+			truth.disparity[(size_t)i * truth.width + j] = std::isfinite(value) ? value : std::numeric_limits<float>::infinity();
+		}
+	}
+
+	return 0;
+}
+
+static unsigned loadPng(GroundTruth& truth, const char* filename, const float pngScale) {
+	std::vector<unsigned char> png, pixels;
+
+	unsigned error = lodepng::load_file(png, filename);
+	if (error) return error;
+
+	// Decoded as 16 bit gray, the original bit depth tells how 8 bit values were widened
+	lodepng::State state;
+	state.info_raw.colortype = LCT_GREY;
+	state.info_raw.bitdepth = 16;
+
+	error = lodepng::decode(pixels, truth.width, truth.height, state, png);
+	if (error) return error;
+
+	const unsigned divisor = state.info_png.color.bitdepth == 16 ? 1 : 257;
+	const size_t size = (size_t)truth.width * truth.height;
+
+	truth.disparity.resize(size);
+
+	for (size_t i = 0; i < size; i++) {
+		unsigned value = (pixels[2 * i] << 8 | pixels[2 * i + 1]) / divisor;
+
+		truth.disparity[i] = value ? value / pngScale : std::numeric_limits<float>::infinity();
+	}
+
+	return 0;
+}
+
+unsigned loadGroundTruth(GroundTruth& truth, const char* filename, const float pngScale) {
+	const std::string name(filename);
+	const std::string extension = name.size() > 4 ? name.substr(name.size() - 4) : "";
+
+	if (extension == ".pfm" || extension == ".PFM") {
+		return loadPfm(truth, filename);
+	}
+
+	return loadPng(truth, filename, pngScale);
+}
+
+unsigned evaluateDisparity(
+	DisparityErrors& errors,
+	const std::vector<unsigned>& disparity,
+	const unsigned width,
+	const unsigned height,
+	const GroundTruth& truth,
+	const std::vector<unsigned char>* mask
+) {
+	memset(&errors, 0, sizeof(errors));
+
+	if (!width || !height) return errorGroundTruthSize;
+
+	const unsigned factor = truth.width / width;
+	if (!factor || truth.height / height != factor) return errorGroundTruthSize;
+
+	size_t bad[badThresholdCount] = {};
+	double errorSum = 0, squareSum = 0;
+
+	for (unsigned i = 0; i < height; i++) {
+		// The same source pixel as scaleAndGray
+		const unsigned row = factor * i - (i > 0 && factor > 1);
+
+		for (unsigned j = 0; j < width; j++) {
+			const size_t index = (size_t)i * width + j;
+			const unsigned column = factor * j - (j > 0 && factor > 1);
+
+			float expected = truth.disparity[(size_t)row * truth.width + column];
+			if (std::isinf(expected) || (mask && (*mask)[index])) continue;
+
+			double error = std::fabs((double)disparity[index] - expected / factor);
+
+			errors.pixels++;
+			errorSum += error;
+			squareSum += error * error;
+
+			for (int k = 0; k < badThresholdCount; k++) {
+				if (error > badThresholds[k]) bad[k]++;
+			}
+		}
+	}
+
+	if (errors.pixels) {
+		for (int k = 0; k < badThresholdCount; k++) {
+			errors.bad[k] = 100.0 * bad[k] / errors.pixels;
+		}
+
+		errors.meanError = errorSum / errors.pixels;
+		errors.rmse = std::sqrt(squareSum / errors.pixels);
+	}
+
+	return 0;
+}
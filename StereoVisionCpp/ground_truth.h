@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+/*
+Ground truth disparity of a stereo pair, at the resolution of the input images.
+* Unknown pixels are infinity, like in the PFM files of the Middlebury 2014 benchmark.
+*/
+struct GroundTruth {
+	unsigned width, height;
+	std::vector<float> disparity;
+};
+
+// Error codes of the ground truth, above the ones of the tile container
+constexpr unsigned errorInvalidPfm = 206;
+constexpr unsigned errorGroundTruthSize = 207;
+
+/*
+Loads ground truth disparity from a PFM or PNG file, recognized by the extension.
+* PFM: single channel "Pf" files of either byte order, rows stored bottom to top, infinite values are unknown.
+* PNG: gray values divided by pngScale, 0 is unknown. 16 bit files with a scale of 256 are the KITTI format,
+  8 bit files like the Middlebury 2001 and 2003 ones need the scale of their dataset (usually 4 or 8).
+* Returns a lodepng error code or errorInvalidPfm (see imageErrorText), 0 on success.
+*/
+unsigned loadGroundTruth(GroundTruth& truth, const char* filename, const float pngScale = 256);
+
+// Error thresholds of DisparityErrors::bad in pixels of the evaluated map
+constexpr int badThresholdCount = 3;
+constexpr float badThresholds[badThresholdCount] = { 1, 2, 4 };
+
+struct DisparityErrors {
+	size_t pixels; // Evaluated pixels, the ones with ground truth that aren't masked out
+	double bad[badThresholdCount]; // Percent of the pixels whose error is larger than the threshold
+	double meanError, rmse;
+};
+
+/*
+Compares a disparity map with the ground truth.
+* The map may be smaller than the ground truth by an integer factor, like the downscaled maps of the pipeline.
+  Every map pixel is compared with the ground truth pixel scaleAndGray took its gray value from,
+  divided by the factor, so the errors are in pixels of the map.
+* Pixels where mask is nonzero (e.g. SyntheticPair::occluded, at the resolution of the map) are left out.
+* Returns errorGroundTruthSize if the sizes don't match, 0 on success.
+*/
+unsigned evaluateDisparity(
+	DisparityErrors& errors,
+	const std::vector<unsigned>& disparity,
+	const unsigned width,
+	const unsigned height,
+	const GroundTruth& truth,
+	const std::vector<unsigned char>* mask = nullptr
+);
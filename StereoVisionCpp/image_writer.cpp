@@ -0,0 +1,204 @@
+#include "image_writer.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "lodepng.h"
+#include "profiler.h"
+#include "stereo.h"
+#include "tile_container.h"
+
+// Images with more filtered bytes than this are deflated in parallel chunks of this size, like pigz
+constexpr unsigned deflateChunkSize = 128 * 1024;
+
+const char* imageExtension(const ImageFormat format) {
+	switch (format) {
+	case ImageFormat::Pgm: return ".pgm";
+	case ImageFormat::Tiles: return ".zdt";
+	default: return ".png";
+	}
+}
+
+// Values as 16 bit big endian samples, the byte order of both PNG and PGM
+static std::vector<unsigned char> toBigEndian16(const std::vector<unsigned>& map) {
+	std::vector<unsigned char> result(map.size() * 2);
+
+	for (size_t i = 0; i < map.size(); i++) {
+		unsigned value = std::min(map[i], 65535u);
+		result[2 * i] = (unsigned char)(value >> 8);
+		result[2 * i + 1] = (unsigned char)value;
+	}
+
+	return result;
+}
+
+static unsigned savePgm(const std::string& filename, const std::vector<unsigned>& map, const unsigned width, const unsigned height) {
+	const bool wide = !map.empty() && *std::max_element(map.begin(), map.end()) > 255;
+
+	char header[64];
+	int headerSize = snprintf(header, sizeof(header), "P5\n%u %u\n%u\n", width, height, wide ? 65535 : 255);
+
+	std::vector<unsigned char> file(header, header + headerSize);
+
+	if (wide) {
+		std::vector<unsigned char> samples = toBigEndian16(map);
+		file.insert(file.end(), samples.begin(), samples.end());
+	} else {
+		file.insert(file.end(), map.begin(), map.end());
+	}
+
+	return lodepng::save_file(file, filename);
+}
+
+static unsigned saveTiles(const std::string& filename, const std::vector<unsigned>& map, const unsigned width, const unsigned height) {
+	const bool wide = !map.empty() && *std::max_element(map.begin(), map.end()) > 255;
+
+	TileContainerWriter container;
+	unsigned error = container.create(filename.c_str(), width, height, containerTileSize, wide ? 2 : 1);
+
+	std::vector<unsigned> tile;
+
+	for (unsigned tileY = 0; !error && tileY < container.tilesY(); tileY++) {
+		for (unsigned tileX = 0; !error && tileX < container.tilesX(); tileX++) {
+			tile.clear();
+			for (unsigned i = 0; i < container.tileHeight(tileY); i++) {
+				const unsigned* row = &map[(size_t)(tileY * containerTileSize + i) * width + tileX * containerTileSize];
+				tile.insert(tile.end(), row, row + container.tileWidth(tileX));
+			}
+
+			error = container.writeTile(tileX, tileY, tile.data());
+		}
+	}
+
+	if (!error) error = container.finish();
+
+	return error;
+}
+
+// Converts a map to the format and writes it, state holds the encoder settings for the PNG formats
+static unsigned saveImage(
+	const ImageFormat format,
+	const std::string& filename,
+	const std::vector<unsigned>& map,
+	const unsigned width,
+	const unsigned height,
+	lodepng::State& state,
+	std::vector<unsigned char>& png
+) {
+	png.clear();
+	unsigned error = 0;
+
+	switch (format) {
+	case ImageFormat::Rgba:
+		error = lodepng::encode(png, normalize(map, width, height), width, height, state);
+		break;
+	case ImageFormat::Gray8:
+		error = lodepng::encode(png, normalizeGray(map, width, height), width, height, state);
+		break;
+	case ImageFormat::Gray16:
+		error = lodepng::encode(png, toBigEndian16(map), width, height, state);
+		break;
+	case ImageFormat::Pgm:
+		return savePgm(filename, map, width, height);
+	case ImageFormat::Tiles:
+		return saveTiles(filename, map, width, height);
+	}
+
+	if (!error) error = lodepng::save_file(png, filename);
+
+	return error;
+}
+
+ImageWriter::ImageWriter(const ImageFormat format, const unsigned threads, const size_t capacity) :
+	m_Format(format), m_Capacity(capacity), m_Busy(0), m_Stopping(false), m_Error(0), m_EncodeTime(0) {
+	for (unsigned i = 0; i < threads; i++) {
+		m_Threads.emplace_back(&ImageWriter::work, this);
+	}
+}
+
+ImageWriter::~ImageWriter() {
+	flush();
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Stopping = true;
+	}
+	m_Changed.notify_all();
+
+	for (std::thread& thread : m_Threads) {
+		thread.join();
+	}
+}
+
+void ImageWriter::write(const std::string& filename, std::vector<unsigned> map, const unsigned width, const unsigned height) {
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_Changed.wait(lock, [&] { return m_Queue.size() < m_Capacity; });
+
+	m_Queue.push_back(Job{ filename, std::move(map), width, height });
+
+	lock.unlock();
+	m_Changed.notify_all();
+}
+
+unsigned ImageWriter::flush() {
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_Changed.wait(lock, [&] { return m_Queue.empty() && m_Busy == 0; });
+
+	return m_Error;
+}
+
+double ImageWriter::getEncodeTime() {
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_EncodeTime;
+}
+
+void ImageWriter::work() {
+	Profiler::instance().setThreadName("image writer");
+
+	lodepng::State state;
+	state.encoder.zlibsettings.parallel_chunksize = deflateChunkSize;
+
+	if (m_Format == ImageFormat::Gray8) {
+		state.info_raw.colortype = LCT_GREY;
+	} else if (m_Format == ImageFormat::Gray16) {
+		state.info_raw.colortype = LCT_GREY;
+		state.info_raw.bitdepth = 16;
+
+		// The automatic color choice would store maps whose samples all have equal bytes as 8 bit
+		state.encoder.auto_convert = 0;
+		state.info_png.color.colortype = LCT_GREY;
+		state.info_png.color.bitdepth = 16;
+	}
+
+	std::vector<unsigned char> png;
+
+	std::unique_lock<std::mutex> lock(m_Mutex);
+
+	while (true) {
+		m_Changed.wait(lock, [&] { return m_Stopping || !m_Queue.empty(); });
+		if (m_Queue.empty()) return;
+
+		Job job = std::move(m_Queue.front());
+		m_Queue.pop_front();
+		m_Busy++;
+
+		// A slot in the queue is free again
+		lock.unlock();
+		m_Changed.notify_all();
+
+		unsigned error;
+		double duration;
+		{
+			ProfileZone zone("encode image");
+			error = saveImage(m_Format, job.filename, job.map, job.width, job.height, state, png);
+			duration = zone.getElapsedTime();
+		}
+
+		lock.lock();
+		m_Busy--;
+		m_EncodeTime += duration;
+		if (error && !m_Error) m_Error = error;
+
+		m_Changed.notify_all();
+	}
+}
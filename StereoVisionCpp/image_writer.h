@@ -0,0 +1,68 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+File format of the images written by ImageWriter.
+* Rgba: normalized 8 bit RGBA PNG, the gray value replicated three times plus alpha.
+* Gray8: normalized 8 bit gray PNG, looks the same as Rgba with a quarter of the encoder input.
+* Gray16: the raw values as 16 bit gray PNG, keeps the absolute disparity scale.
+* Pgm: the raw values as uncompressed binary PGM, 8 bit if they all fit in a byte, 16 bit (big endian) otherwise.
+* Tiles: the raw values as tile container (see tile_container.h), 8 or 16 bit like Pgm.
+*/
+enum class ImageFormat { Rgba, Gray8, Gray16, Pgm, Tiles };
+
+// File extension of a format including the dot
+const char* imageExtension(const ImageFormat format);
+
+/*
+Class to encode and write images on background threads, so the encoding is off the critical path of the pipeline.
+* write hands a map over to the queue, it is converted to the writer's format on the writer thread.
+  When the queue is full write blocks until a writer thread picks up an image, so the number of buffers
+  waiting in memory is bounded.
+* flush waits until every queued image is written, the destructor flushes as well, so all images exist at exit.
+* Large images are deflated in parallel chunks (see LodePNGCompressSettings::parallel_chunksize).
+* The first lodepng error code is kept and returned by flush.
+*/
+class ImageWriter {
+private:
+	struct Job {
+		std::string filename;
+		std::vector<unsigned> map;
+		unsigned width, height;
+	};
+
+	const ImageFormat m_Format;
+
+	std::deque<Job> m_Queue;
+	size_t m_Capacity;
+	unsigned m_Busy; // Jobs taken from the queue that are still being encoded
+	bool m_Stopping;
+	unsigned m_Error;
+	double m_EncodeTime;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_Changed;
+	std::vector<std::thread> m_Threads;
+
+	void work();
+
+public:
+	ImageWriter(const ImageFormat format = ImageFormat::Gray8, const unsigned threads = 1, const size_t capacity = 4);
+	~ImageWriter();
+
+	ImageWriter(const ImageWriter&) = delete;
+	ImageWriter& operator=(const ImageWriter&) = delete;
+
+	void write(const std::string& filename, std::vector<unsigned> map, const unsigned width, const unsigned height);
+
+	unsigned flush();
+
+	// Time spent converting and encoding so far in seconds, summed over the writer threads
+	double getEncodeTime();
+};
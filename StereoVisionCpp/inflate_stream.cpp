@@ -0,0 +1,452 @@
+#include "inflate_stream.h"
+
+#include <cstring>
+
+static const unsigned short lengthBase[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const unsigned char lengthExtra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const unsigned short distanceBase[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const unsigned char distanceExtra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+static const unsigned char codeLengthOrder[19] = {
+	16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+InflateStream::InflateStream(ReadFunc read, bool zlib) :
+	m_Read(read), m_Input(inputSize), m_InPos(0), m_InSize(0), m_InEnd(false), m_BitBuf(0), m_BitCount(0),
+	m_State(zlib ? State::Header : State::BlockHeader), m_Zlib(zlib), m_LastBlock(false), m_StoredRemaining(0),
+	m_CurrentLen(nullptr), m_CurrentDist(nullptr), m_Error(0),
+	m_Window(windowSize), m_OutPos(0), m_Flushed(0), m_Adler(1) {}
+
+void InflateStream::reset(bool zlib) {
+	m_InPos = m_InSize = 0;
+	m_InEnd = false;
+	m_BitBuf = 0;
+	m_BitCount = 0;
+	m_State = zlib ? State::Header : State::BlockHeader;
+	m_Zlib = zlib;
+	m_LastBlock = false;
+	m_StoredRemaining = 0;
+	m_CurrentLen = m_CurrentDist = nullptr;
+	m_Error = 0;
+	m_OutPos = m_Flushed = 0;
+	m_Adler = 1;
+}
+
+unsigned InflateStream::read(unsigned char* out, size_t size, size_t& produced) {
+	produced = 0;
+
+	while (!m_Error && produced < size) {
+		if (m_Flushed < m_OutPos) {
+			drain(out, size, produced);
+		} else if (m_State == State::Done) {
+			break;
+		} else {
+			m_Error = advance();
+		}
+	}
+
+	return m_Error;
+}
+
+/*
+Decodes the next piece of the stream into the window.
+* At most about half a window is decoded per call, so the bytes that weren't handed out yet are never overwritten.
+*/
+unsigned InflateStream::advance() {
+	switch (m_State) {
+	case State::Header:
+		return zlibHeader();
+	case State::BlockHeader:
+		return blockHeader();
+	case State::Stored:
+		return storedBlock();
+	case State::Huffman:
+		return huffmanBlock();
+	case State::Trailer:
+		return zlibTrailer();
+	default:
+		return 0;
+	}
+}
+
+void InflateStream::drain(unsigned char* out, size_t size, size_t& produced) {
+	size_t start = m_Flushed & (windowSize - 1);
+	size_t length = m_OutPos - m_Flushed;
+	if (start + length > windowSize) {
+		length = windowSize - start;
+	}
+	if (length > size - produced) {
+		length = size - produced;
+	}
+
+	const unsigned char* data = m_Window.data() + start;
+
+	if (m_Zlib) {
+		// Same as lodepng's update_adler32, the sums are reduced at most every 5552 bytes
+		unsigned s1 = m_Adler & 0xffff, s2 = m_Adler >> 16;
+		size_t remaining = length;
+		while (remaining) {
+			size_t amount = remaining > 5552 ? 5552 : remaining;
+			remaining -= amount;
+			for (size_t i = 0; i < amount; i++) {
+				s1 += *data++;
+				s2 += s1;
+			}
+			s1 %= 65521;
+			s2 %= 65521;
+		}
+		m_Adler = (s2 << 16) | s1;
+		data = m_Window.data() + start;
+	}
+
+	memcpy(out + produced, data, length);
+	produced += length;
+	m_Flushed += length;
+}
+
+bool InflateStream::refill() {
+	if (m_InEnd) return false;
+
+	m_InSize = m_Read(m_Input.data(), m_Input.size());
+	m_InPos = 0;
+
+	if (m_InSize == 0) {
+		m_InEnd = true;
+		return false;
+	}
+
+	return true;
+}
+
+unsigned InflateStream::needBits(unsigned n) {
+	while (m_BitCount < n) {
+		if (m_InPos == m_InSize && !refill()) return 23;
+
+		m_BitBuf |= (unsigned long long)m_Input[m_InPos++] << m_BitCount;
+		m_BitCount += 8;
+	}
+
+	return 0;
+}
+
+unsigned InflateStream::takeBits(unsigned n) {
+	unsigned value = (unsigned)(m_BitBuf & ((1ull << n) - 1));
+	m_BitBuf >>= n;
+	m_BitCount -= n;
+
+	return value;
+}
+
+/*
+Builds the canonical huffman code from the code lengths.
+* Codes up to tableBits long are resolved with a single lookup, longer ones are decoded bit by bit.
+* Incomplete codes are allowed (deflate uses them for distance trees with a single code), over subscribed ones are not.
+*/
+unsigned InflateStream::build(Huffman& h, const unsigned char* lengths, unsigned n) {
+	memset(h.count, 0, sizeof(h.count));
+	for (unsigned i = 0; i < n; i++) {
+		h.count[lengths[i]]++;
+	}
+	h.count[0] = 0;
+
+	int left = 1;
+	for (int len = 1; len < 16; len++) {
+		left <<= 1;
+		left -= h.count[len];
+		if (left < 0) return 55;
+	}
+
+	unsigned short offsets[16];
+	offsets[1] = 0;
+	for (int len = 1; len < 15; len++) {
+		offsets[len + 1] = offsets[len] + h.count[len];
+	}
+
+	for (unsigned i = 0; i < n; i++) {
+		if (lengths[i]) {
+			h.symbol[offsets[lengths[i]]++] = i;
+		}
+	}
+
+	h.table.assign(1 << tableBits, 0);
+
+	unsigned code = 0, index = 0;
+	for (unsigned len = 1; len <= tableBits; len++) {
+		for (unsigned k = 0; k < h.count[len]; k++, code++, index++) {
+			// Bits arrive least significant first, so the table is indexed by the reversed code
+			unsigned reversed = 0;
+			for (unsigned b = 0; b < len; b++) {
+				reversed |= ((code >> b) & 1) << (len - 1 - b);
+			}
+
+			unsigned short entry = (unsigned short)((h.symbol[index] << 4) | len);
+			for (unsigned fill = reversed; fill < (1u << tableBits); fill += 1u << len) {
+				h.table[fill] = entry;
+			}
+		}
+		code <<= 1;
+	}
+
+	return 0;
+}
+
+unsigned InflateStream::decodeSymbol(const Huffman& h, unsigned& symbol) {
+	// Near the end of the input fewer than 15 bits may be left, which is fine as long as the code fits
+	needBits(15);
+
+	unsigned entry = h.table[m_BitBuf & ((1u << tableBits) - 1)];
+	unsigned len = entry & 15;
+
+	if (len) {
+		if (len > m_BitCount) return 10;
+
+		symbol = entry >> 4;
+		takeBits(len);
+		return 0;
+	}
+
+	int code = 0, first = 0, index = 0;
+	for (len = 1; len < 16; len++) {
+		if (len > m_BitCount) return 10;
+
+		code |= (m_BitBuf >> (len - 1)) & 1;
+		int count = h.count[len];
+		if (code - count < first) {
+			symbol = h.symbol[index + (code - first)];
+			takeBits(len);
+			return 0;
+		}
+		index += count;
+		first += count;
+		first <<= 1;
+		code <<= 1;
+	}
+
+	return 11;
+}
+
+unsigned InflateStream::zlibHeader() {
+	if (needBits(16)) return 53; // size of zlib data too small
+
+	unsigned cmf = takeBits(8);
+	unsigned flg = takeBits(8);
+
+	if ((cmf * 256 + flg) % 31 != 0) return 24;
+	if ((cmf & 15) != 8 || (cmf >> 4) > 7) return 25;
+	if ((flg >> 5) & 1) return 26;
+
+	m_State = State::BlockHeader;
+	return 0;
+}
+
+unsigned InflateStream::blockHeader() {
+	// Built once on first use, function local statics are thread safe to initialize
+	struct FixedTrees {
+		Huffman len, dist;
+
+		FixedTrees() {
+			unsigned char lengths[288];
+			for (int i = 0; i < 144; i++) lengths[i] = 8;
+			for (int i = 144; i < 256; i++) lengths[i] = 9;
+			for (int i = 256; i < 280; i++) lengths[i] = 7;
+			for (int i = 280; i < 288; i++) lengths[i] = 8;
+			build(len, lengths, 288);
+
+			for (int i = 0; i < 30; i++) lengths[i] = 5;
+			build(dist, lengths, 30);
+		}
+	};
+	static const FixedTrees fixed;
+
+	if (needBits(3)) return 23;
+
+	m_LastBlock = takeBits(1);
+	unsigned type = takeBits(2);
+
+	if (type == 0) {
+		takeBits(m_BitCount & 7);
+		if (needBits(32)) return 52;
+
+		unsigned length = takeBits(16);
+		unsigned nlength = takeBits(16);
+		if (length + nlength != 65535) return 21;
+
+		m_StoredRemaining = length;
+		m_State = State::Stored;
+	} else if (type == 1) {
+		m_CurrentLen = &fixed.len;
+		m_CurrentDist = &fixed.dist;
+		m_State = State::Huffman;
+	} else if (type == 2) {
+		unsigned error = dynamicTrees();
+		if (error) return error;
+
+		m_CurrentLen = &m_LenCode;
+		m_CurrentDist = &m_DistCode;
+		m_State = State::Huffman;
+	} else {
+		return 20;
+	}
+
+	return 0;
+}
+
+void InflateStream::endBlock() {
+	if (!m_LastBlock) {
+		m_State = State::BlockHeader;
+	} else {
+		m_State = m_Zlib ? State::Trailer : State::Done;
+	}
+}
+
+unsigned InflateStream::storedBlock() {
+	size_t amount = m_StoredRemaining < windowSize / 2 ? m_StoredRemaining : windowSize / 2;
+	m_StoredRemaining -= (unsigned)amount;
+
+	while (amount--) {
+		unsigned char byte;
+		if (m_BitCount) {
+			byte = (unsigned char)takeBits(8);
+		} else {
+			if (m_InPos == m_InSize && !refill()) return 23;
+			byte = m_Input[m_InPos++];
+		}
+
+		m_Window[m_OutPos++ & (windowSize - 1)] = byte;
+	}
+
+	if (m_StoredRemaining == 0) {
+		endBlock();
+	}
+
+	return 0;
+}
+
+unsigned InflateStream::dynamicTrees() {
+	if (needBits(14)) return 49;
+
+	unsigned nlen = takeBits(5) + 257;
+	unsigned ndist = takeBits(5) + 1;
+	unsigned ncode = takeBits(4) + 4;
+
+	if (nlen > 286 || ndist > 30) return 13;
+
+	unsigned char lengths[320] = { 0 };
+
+	for (unsigned i = 0; i < ncode; i++) {
+		if (needBits(3)) return 50;
+		lengths[codeLengthOrder[i]] = (unsigned char)takeBits(3);
+	}
+
+	Huffman clcode;
+	if (build(clcode, lengths, 19)) return 16;
+
+	unsigned index = 0;
+	while (index < nlen + ndist) {
+		unsigned symbol;
+		unsigned error = decodeSymbol(clcode, symbol);
+		if (error) return error;
+
+		if (symbol < 16) {
+			lengths[index++] = (unsigned char)symbol;
+			continue;
+		}
+
+		unsigned char value = 0;
+		unsigned repeat;
+
+		if (symbol == 16) {
+			if (index == 0) return 54;
+			value = lengths[index - 1];
+			if (needBits(2)) return 50;
+			repeat = 3 + takeBits(2);
+		} else if (symbol == 17) {
+			if (needBits(3)) return 50;
+			repeat = 3 + takeBits(3);
+		} else {
+			if (needBits(7)) return 50;
+			repeat = 11 + takeBits(7);
+		}
+
+		if (index + repeat > nlen + ndist) return symbol == 16 ? 13 : (symbol == 17 ? 14 : 15);
+
+		while (repeat--) {
+			lengths[index++] = value;
+		}
+	}
+
+	if (lengths[256] == 0) return 64;
+
+	if (build(m_LenCode, lengths, nlen)) return 55;
+	if (build(m_DistCode, lengths + nlen, ndist)) return 55;
+
+	return 0;
+}
+
+unsigned InflateStream::huffmanBlock() {
+	const size_t mask = windowSize - 1;
+	const size_t limit = m_Flushed + windowSize / 2;
+	unsigned char* window = m_Window.data();
+
+	while (m_OutPos < limit) {
+		unsigned symbol;
+		unsigned error = decodeSymbol(*m_CurrentLen, symbol);
+		if (error) return error;
+
+		if (symbol < 256) {
+			window[m_OutPos++ & mask] = (unsigned char)symbol;
+		} else if (symbol == 256) {
+			endBlock();
+			return 0;
+		} else {
+			symbol -= 257;
+			if (symbol >= 29) return 16;
+
+			if (needBits(lengthExtra[symbol])) return 51;
+			unsigned length = lengthBase[symbol] + takeBits(lengthExtra[symbol]);
+
+			error = decodeSymbol(*m_CurrentDist, symbol);
+			if (error) return error;
+			if (symbol >= 30) return 18;
+
+			if (needBits(distanceExtra[symbol])) return 51;
+			unsigned distance = distanceBase[symbol] + takeBits(distanceExtra[symbol]);
+
+			if (distance > m_OutPos) return 52;
+
+			size_t from = m_OutPos - distance;
+			while (length--) {
+				window[m_OutPos++ & mask] = window[from++ & mask];
+			}
+		}
+	}
+
+	return 0;
+}
+
+unsigned InflateStream::zlibTrailer() {
+	// The checksum is stored big endian right after the byte aligned end of the deflate data
+	takeBits(m_BitCount & 7);
+	if (needBits(32)) return 53;
+
+	unsigned checksum = 0;
+	for (int i = 0; i < 4; i++) {
+		checksum = (checksum << 8) | takeBits(8);
+	}
+
+	if (checksum != m_Adler) return 58;
+
+	m_State = State::Done;
+	return 0;
+}
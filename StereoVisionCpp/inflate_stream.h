@@ -0,0 +1,85 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+/*
+Streaming zlib/deflate decoder.
+* Compressed bytes are pulled from the read callback as they are needed, and decompressed bytes are
+  handed out in whatever amounts the caller asks for, so neither the whole input nor the whole output
+  has to be in memory.
+* Only the 32 KB deflate history window is kept between calls.
+* Error codes are the ones used by lodepng, so lodepng_error_text() can describe them.
+*/
+class InflateStream {
+public:
+	// Fills the buffer with up to size compressed bytes and returns how many were written (0 at end of input)
+	typedef std::function<size_t(unsigned char*, size_t)> ReadFunc;
+
+	static constexpr unsigned windowSize = 32768;
+
+	// zlib selects between a zlib stream (header, deflate data and adler32 checksum) and raw deflate data
+	InflateStream(ReadFunc read, bool zlib = true);
+
+	/*
+	Decompresses up to size bytes into out, produced receives how many were written.
+	* Fewer than size bytes are only produced at the end of the stream.
+	* Errors are sticky, every later call returns the same error.
+	*/
+	unsigned read(unsigned char* out, size_t size, size_t& produced);
+
+	// Starts over with a new stream from the same read callback, the buffers are kept
+	void reset(bool zlib = true);
+
+	inline bool finished() const { return m_State == State::Done && m_Flushed == m_OutPos; }
+
+private:
+	struct Huffman {
+		std::vector<unsigned short> table; // (symbol << 4) | length, indexed by the next tableBits bits
+		unsigned short count[16];
+		unsigned short symbol[288];
+	};
+
+	enum class State { Header, BlockHeader, Stored, Huffman, Trailer, Done };
+
+	static constexpr unsigned tableBits = 10;
+	static constexpr size_t inputSize = 65536;
+
+	ReadFunc m_Read;
+
+	std::vector<unsigned char> m_Input;
+	size_t m_InPos, m_InSize;
+	bool m_InEnd;
+
+	unsigned long long m_BitBuf;
+	unsigned m_BitCount;
+
+	State m_State;
+	bool m_Zlib, m_LastBlock;
+	unsigned m_StoredRemaining;
+	Huffman m_LenCode, m_DistCode;
+	const Huffman* m_CurrentLen;
+	const Huffman* m_CurrentDist;
+	unsigned m_Error;
+
+	std::vector<unsigned char> m_Window;
+	size_t m_OutPos, m_Flushed; // Total bytes decoded, and how many of them were handed out
+	unsigned m_Adler;
+
+	bool refill();
+	unsigned needBits(unsigned n);
+	unsigned takeBits(unsigned n);
+	unsigned advance();
+	void drain(unsigned char* out, size_t size, size_t& produced);
+
+	static unsigned build(Huffman& h, const unsigned char* lengths, unsigned n);
+	unsigned decodeSymbol(const Huffman& h, unsigned& symbol);
+
+	unsigned zlibHeader();
+	unsigned blockHeader();
+	unsigned storedBlock();
+	unsigned dynamicTrees();
+	unsigned huffmanBlock();
+	void endBlock();
+	unsigned zlibTrailer();
+};
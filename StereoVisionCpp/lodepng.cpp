@@ -39,6 +39,11 @@ Rename this file to lodepng.cpp to use it for C++, or to lodepng.c to use it for
 #include <stdlib.h> /* allocations */
 #endif /* LODEPNG_COMPILE_ALLOCATORS */
 
+#if defined(LODEPNG_COMPILE_CPP) && defined(LODEPNG_COMPILE_ENCODER)
+#include <thread> /* parallel deflate */
+#include <vector>
+#endif /* LODEPNG_COMPILE_CPP && LODEPNG_COMPILE_ENCODER */
+
 #if defined(_MSC_VER) && (_MSC_VER >= 1310) /*Visual Studio: A few warning types are not desired here.*/
 #pragma warning( disable : 4244 ) /*implicit conversions: not warned by gcc -Wall -Wextra and requires too much casts*/
 #pragma warning( disable : 4996 ) /*VS does not like fopen, but fopen_s is not standard C so unusable here*/
@@ -1804,7 +1809,7 @@ static unsigned encodeLZ77(uivector* out, Hash* hash,
 
 /* /////////////////////////////////////////////////////////////////////////// */
 
-static unsigned deflateNoCompression(ucvector* out, const unsigned char* data, size_t datasize) {
+static unsigned deflateNoCompression(ucvector* out, const unsigned char* data, size_t datasize, unsigned last) {
     /*non compressed deflate block data: 1 bit BFINAL,2 bits BTYPE,(5 bits): it jumps to start of next byte,
     2 bytes LEN, 2 bytes NLEN, LEN bytes literal DATA*/
 
@@ -1814,7 +1819,7 @@ static unsigned deflateNoCompression(ucvector* out, const unsigned char* data, s
         unsigned BFINAL, BTYPE, LEN, NLEN;
         unsigned char firstbyte;
 
-        BFINAL = (i == numdeflateblocks - 1);
+        BFINAL = last && (i == numdeflateblocks - 1);
         BTYPE = 0;
 
         firstbyte = (unsigned char)(BFINAL + ((BTYPE & 1u) << 1u) + ((BTYPE & 2u) << 1u));
@@ -2140,8 +2145,10 @@ static unsigned deflateFixed(LodePNGBitWriter* writer, Hash* hash,
     return error;
 }
 
-static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t insize,
-    const LodePNGCompressSettings* settings) {
+/*deflates the data, if last is 0 the final block flag isn't set and the stream ends with a sync flush instead:
+an empty stored block, which moves the output to a byte boundary so another deflate stream can follow it*/
+static unsigned deflatePart(ucvector* out, const unsigned char* in, size_t insize,
+    const LodePNGCompressSettings* settings, unsigned last) {
     unsigned error = 0;
     size_t i, blocksize, numdeflateblocks;
     Hash hash;
@@ -2150,7 +2157,7 @@ static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t
     LodePNGBitWriter_init(&writer, out);
 
     if (settings->btype > 2) return 61;
-    else if (settings->btype == 0) return deflateNoCompression(out, in, insize);
+    else if (settings->btype == 0) return deflateNoCompression(out, in, insize, last); /*always byte aligned*/
     else if (settings->btype == 1) blocksize = insize;
     else /*if(settings->btype == 2)*/ {
         /*on PNGs, deflate blocks of 65-262k seem to give most dense encoding*/
@@ -2166,7 +2173,7 @@ static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t
     if (error) return error;
 
     for (i = 0; i != numdeflateblocks && !error; ++i) {
-        unsigned final = (i == numdeflateblocks - 1);
+        unsigned final = last && (i == numdeflateblocks - 1);
         size_t start = i * blocksize;
         size_t end = start + blocksize;
         if (end > insize) end = insize;
@@ -2177,9 +2184,23 @@ static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t
 
     hash_cleanup(&hash);
 
+    if (!error && !last) {
+        /*BFINAL 0, BTYPE 00, the rest of the byte is padding, then LEN 0 and NLEN 65535*/
+        writeBits(&writer, 0, 3);
+        ucvector_push_back(out, 0);
+        ucvector_push_back(out, 0);
+        ucvector_push_back(out, 255);
+        ucvector_push_back(out, 255);
+    }
+
     return error;
 }
 
+static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t insize,
+    const LodePNGCompressSettings* settings) {
+    return deflatePart(out, in, insize, settings, 1);
+}
+
 unsigned lodepng_deflate(unsigned char** out, size_t* outsize,
     const unsigned char* in, size_t insize,
     const LodePNGCompressSettings* settings) {
@@ -2234,6 +2255,26 @@ static unsigned adler32(const unsigned char* data, unsigned len) {
     return update_adler32(1u, data, len);
 }
 
+#ifdef LODEPNG_COMPILE_ENCODER
+/*Return the adler32 of the concatenation of two byte sequences, given the adler32 of each and the size of the second*/
+static unsigned adler32_combine(unsigned adler1, unsigned adler2, size_t len2) {
+    const unsigned base = 65521u;
+    unsigned rem = (unsigned)(len2 % base);
+    unsigned s1 = adler1 & 0xffffu;
+    unsigned s2 = (rem * s1) % base;
+
+    /*the second sequence starts from s1 of the first one instead of 1, which adds (s1 - 1) to every byte's sum*/
+    s1 += (adler2 & 0xffffu) + base - 1u;
+    s2 += ((adler1 >> 16u) & 0xffffu) + ((adler2 >> 16u) & 0xffffu) + base - rem;
+    if (s1 >= base) s1 -= base;
+    if (s1 >= base) s1 -= base;
+    if (s2 >= base * 2u) s2 -= base * 2u;
+    if (s2 >= base) s2 -= base;
+
+    return (s2 << 16u) | s1;
+}
+#endif /*LODEPNG_COMPILE_ENCODER*/
+
 /* ////////////////////////////////////////////////////////////////////////// */
 /* / Zlib                                                                   / */
 /* ////////////////////////////////////////////////////////////////////////// */
@@ -2294,14 +2335,91 @@ static unsigned zlib_decompress(unsigned char** out, size_t* outsize, const unsi
 
 #ifdef LODEPNG_COMPILE_ENCODER
 
+typedef struct {
+    ucvector data;
+    unsigned adler;
+    unsigned error;
+} DeflateChunk;
+
+/*compresses the chunks first, first + step, ... of the input*/
+static void deflateChunks(DeflateChunk* chunks, size_t numchunks, size_t first, size_t step,
+    const unsigned char* in, size_t insize, const LodePNGCompressSettings* settings) {
+    size_t i;
+    for (i = first; i < numchunks; i += step) {
+        size_t start = i * settings->parallel_chunksize;
+        size_t size = insize - start < settings->parallel_chunksize ? insize - start : settings->parallel_chunksize;
+        chunks[i].error = deflatePart(&chunks[i].data, in + start, size, settings, i == numchunks - 1);
+        chunks[i].adler = adler32(in + start, (unsigned)size);
+    }
+}
+
+/*
+Deflate in independent chunks of settings->parallel_chunksize bytes, like pigz does.
+Every chunk but the last ends with a sync flush, so the compressed chunks are concatenated into one valid deflate
+stream. The adler32 of the chunks is computed by the same threads and combined into the one of the whole input.
+Without C++ threads the chunks are compressed one after the other, which gives the same output.
+*/
+static unsigned deflateParallel(unsigned char** out, size_t* outsize, unsigned* adler,
+    const unsigned char* in, size_t insize, const LodePNGCompressSettings* settings) {
+    unsigned error = 0;
+    size_t i, numchunks = (insize + settings->parallel_chunksize - 1) / settings->parallel_chunksize;
+    size_t numthreads = settings->parallel_threads;
+    ucvector v;
+    DeflateChunk* chunks = (DeflateChunk*)lodepng_malloc(numchunks * sizeof(DeflateChunk));
+    if (!chunks) return 83; /*alloc fail*/
+
+    for (i = 0; i != numchunks; ++i) ucvector_init(&chunks[i].data);
+
+#ifdef LODEPNG_COMPILE_CPP
+    if (numthreads == 0) numthreads = std::thread::hardware_concurrency();
+    if (numthreads == 0) numthreads = 1;
+    if (numthreads > numchunks) numthreads = numchunks;
+    {
+        std::vector<std::thread> threads;
+        for (i = 1; i < numthreads; ++i) {
+            threads.emplace_back(deflateChunks, chunks, numchunks, i, numthreads, in, insize, settings);
+        }
+        deflateChunks(chunks, numchunks, 0, numthreads, in, insize, settings);
+        for (i = 0; i != threads.size(); ++i) threads[i].join();
+    }
+#else /*LODEPNG_COMPILE_CPP*/
+    (void)numthreads;
+    deflateChunks(chunks, numchunks, 0, 1, in, insize, settings);
+#endif /*LODEPNG_COMPILE_CPP*/
+
+    ucvector_init(&v);
+    *adler = 1;
+    for (i = 0; i != numchunks; ++i) {
+        size_t size = insize - i * settings->parallel_chunksize;
+        if (size > settings->parallel_chunksize) size = settings->parallel_chunksize;
+
+        if (!error) error = chunks[i].error;
+        if (!error && !ucvector_resize(&v, v.size + chunks[i].data.size)) error = 83; /*alloc fail*/
+        if (!error) {
+            lodepng_memcpy(v.data + v.size - chunks[i].data.size, chunks[i].data.data, chunks[i].data.size);
+            *adler = i == 0 ? chunks[i].adler : adler32_combine(*adler, chunks[i].adler, size);
+        }
+        ucvector_cleanup(&chunks[i].data);
+    }
+
+    lodepng_free(chunks);
+    *out = v.data;
+    *outsize = v.size;
+    return error;
+}
+
 unsigned lodepng_zlib_compress(unsigned char** out, size_t* outsize, const unsigned char* in,
     size_t insize, const LodePNGCompressSettings* settings) {
     size_t i;
     unsigned error;
     unsigned char* deflatedata = 0;
     size_t deflatesize = 0;
+    unsigned ADLER32 = 0;
+    unsigned parallel = settings->parallel_chunksize != 0 && insize > settings->parallel_chunksize
+        && !settings->custom_deflate;
 
-    error = deflate(&deflatedata, &deflatesize, in, insize, settings);
+    if (parallel) error = deflateParallel(&deflatedata, &deflatesize, &ADLER32, in, insize, settings);
+    else error = deflate(&deflatedata, &deflatesize, in, insize, settings);
 
     *out = NULL;
     *outsize = 0;
@@ -2312,7 +2430,7 @@ unsigned lodepng_zlib_compress(unsigned char** out, size_t* outsize, const unsig
     }
 
     if (!error) {
-        unsigned ADLER32 = adler32(in, (unsigned)insize);
+        if (!parallel) ADLER32 = adler32(in, (unsigned)insize);
         /*zlib data: 1 byte CMF (CM+CINFO), 1 byte FLG, deflate data, 4 byte ADLER32 checksum of the Decompressed data*/
         unsigned CMF = 120; /*0b01111000: CM 8, CINFO 7. With CINFO 7, any window size up to 32768 can be used.*/
         unsigned FLEVEL = 0;
@@ -2379,12 +2497,15 @@ void lodepng_compress_settings_init(LodePNGCompressSettings* settings) {
     settings->nicematch = 128;
     settings->lazymatching = 1;
 
+    settings->parallel_chunksize = 0;
+    settings->parallel_threads = 0;
+
     settings->custom_zlib = 0;
     settings->custom_deflate = 0;
     settings->custom_context = 0;
 }
 
-const LodePNGCompressSettings lodepng_default_compress_settings = { 2, 1, DEFAULT_WINDOWSIZE, 3, 128, 1, 0, 0, 0 };
+const LodePNGCompressSettings lodepng_default_compress_settings = { 2, 1, DEFAULT_WINDOWSIZE, 3, 128, 1, 0, 0, 0, 0, 0 };
 
 
 #endif /*LODEPNG_COMPILE_ENCODER*/
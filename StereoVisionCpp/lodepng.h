@@ -303,6 +303,13 @@ struct LodePNGCompressSettings /*deflate = compress*/ {
     unsigned nicematch; /*stop searching if >= this length found. Set to 258 for best compression. Default: 128*/
     unsigned lazymatching; /*use lazy matching: better compression but a bit slower. Default: true*/
 
+    /*Parallel compression settings, like pigz. If parallel_chunksize is nonzero, the data is split in chunks of
+    that many bytes which are deflated independently, each chunk ending with a sync flush (empty stored block) so
+    they can be concatenated into one deflate stream. The output only depends on the chunk size, not on the
+    number of threads. Compresses slightly worse since matches can't reach into the previous chunk.*/
+    unsigned parallel_chunksize; /*bytes per independently compressed chunk, 0 to disable. Default: 0*/
+    unsigned parallel_threads; /*threads compressing the chunks, 0 for all hardware threads. Default: 0*/
+
     /*use custom zlib encoder instead of built in one (default: null)*/
     unsigned (*custom_zlib)(unsigned char**, size_t*,
         const unsigned char*, size_t,
@@ -1748,6 +1755,8 @@ state.encoder.zlibsettings.windowsize: tweak LZ77 windowsize
 state.encoder.zlibsettings.minmatch: tweak min LZ77 length to match
 state.encoder.zlibsettings.nicematch: tweak LZ77 match where to stop searching
 state.encoder.zlibsettings.lazymatching: try one more LZ77 matching
+state.encoder.zlibsettings.parallel_chunksize: deflate independent chunks on multiple threads
+state.encoder.zlibsettings.parallel_threads: number of threads for the chunks
 state.encoder.zlibsettings.custom_...: use custom deflate function
 state.encoder.auto_convert: choose optimal PNG color type, if 0 uses info_png
 state.encoder.filter_palette_zero: PNG filter strategy for palette
@@ -1,365 +1,571 @@
 #include <iostream>
 #include <cassert>
-#include <chrono>
-
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <string>
+
+#include "fast_inflate.h"
+#include "gray_reader.h"
+#include "image_writer.h"
 #include "lodepng.h"
+#include "pair_decoder.h"
+#include "profiler.h"
+#include "stereo.h"
+#include "streaming.h"
+#include "tile_container.h"
+#include "tiled.h"
 
 /*
-Class to calculate time taken by functions in seconds.
-* Creating an object of the class in a function, calls the constructor which starts the timer.
-* At the end of the function, the destructor is called which stops the timer and calculates the duration.
-* We can get the duration manually using the getElapsedTime method.
+Command line options.
+* --stream or --tiled select another pipeline, --benchmark-decode compares the input decoders,
+  --benchmark-inflate compares lodepng's inflate with fastInflate.
+* --left and --right replace imageL.png and imageR.png, PGM/PPM files are recognized by their extension.
+* --raw width height channels reads both inputs as raw headerless 8 bit images.
+* --verbosity selects the images written by the default pipeline: 0 only output, 1 adds dispCC,
+  2 (default) adds all intermediate images.
+* --format selects their file format, see ImageFormat: rgba, gray8 (default), gray16, pgm or tiles.
+  With tiles the tiled pipeline writes output.zdt next to output.pgm.
+* --crop file x y width height reads a region of a tile container and writes it to crop.pgm.
+* --profile file prints the profiler report at the end and writes the zones as Chrome trace to the file.
+* --counters adds the hardware counters of every zone to the profiler report and trace (Linux perf_event_open),
+  it needs --profile.
+* --window n (square ZNCC window) and --max-disparity n replace the constants of stereo.h in the default pipeline,
+  --output file also writes its final map there as PGM with the raw disparities.
+  Together with --left and --right these are the options every backend takes, see StereoVisionCompare.
 */
-class Timer {
-private:
-	std::chrono::time_point<std::chrono::steady_clock> start, end;
-	std::chrono::duration<float> duration;
-
-public:
-	Timer() {
-		start = std::chrono::high_resolution_clock::now();
+struct Options {
+	const char* mode = nullptr;
+	const char* leftFile = "imageL.png";
+	const char* rightFile = "imageR.png";
+	bool isRaw = false;
+	RawFormat raw;
+	int verbosity = 2;
+	ImageFormat format = ImageFormat::Gray8;
+	const char* cropFile = nullptr;
+	unsigned crop[4] = { 0, 0, 0, 0 };
+	const char* profileFile = nullptr;
+	bool counters = false;
+	int window = windowWidth;
+	int maxDisp = maxDisparity;
+	const char* outputFile = nullptr;
+};
+
+// Prototypes
+bool parseOptions(int, char**, Options&);
+void enableCounters();
+void loadImagePair(PairDecoder&, const char*, const char*);
+int runStreaming(const char*, const char*, const RawFormat*);
+int runTiled(const char*, const char*, const RawFormat*, const char*);
+int runCrop(const char*, const unsigned*);
+int runDecodeBenchmark(const char*);
+int runInflateBenchmark(const char*);
+
+int main(int argc, char** argv) {
+	Options options;
+	if (!parseOptions(argc, argv, options)) {
+		std::cout << "Usage: " << argv[0] << " [--stream | --tiled | --benchmark-decode | --benchmark-inflate | --crop file x y width height]"
+			<< " [--left file] [--right file] [--raw width height channels] [--verbosity 0-2]"
+			<< " [--format rgba | gray8 | gray16 | pgm | tiles] [--profile trace.json [--counters]]"
+			<< " [--window n] [--max-disparity n] [--output file.pgm]" << std::endl;
+		return -1;
 	}
 
-	~Timer() {
-		end = std::chrono::high_resolution_clock::now();
-		duration = end - start;
+	Profiler::instance().setThreadName("main");
 
-		std::cout << "Done (" << duration.count() << " s)" << std::endl;
+	// Destroyed last, after every other object of main and with that every zone and thread of the pipeline has ended
+	ProfileOutput profileOutput(options.profileFile);
+
+	if (options.counters) {
+		enableCounters();
 	}
 
-	float getElapsedTime() {
-		end = std::chrono::high_resolution_clock::now();
-		duration = end - start;
+	const RawFormat* raw = options.isRaw ? &options.raw : nullptr;
 
-		return duration.count();
-	}
-};
+	if (options.mode) {
+		// With --stream the images are processed row by row with bounded memory, see streaming.h
+		if (!strcmp(options.mode, "--stream")) {
+			return runStreaming(options.leftFile, options.rightFile, raw);
+		}
 
-constexpr int maxDisparity = 64;
+		// With --tiled the images are processed tile by tile through memory mapped files, see tiled.h
+		if (!strcmp(options.mode, "--tiled")) {
+			return runTiled(options.leftFile, options.rightFile, raw, options.format == ImageFormat::Tiles ? "output.zdt" : nullptr);
+		}
 
-constexpr int windowWidth = 9;
-constexpr int windowHeight = 9;
+		if (!strcmp(options.mode, "--crop")) {
+			return runCrop(options.cropFile, options.crop);
+		}
 
-constexpr int crossCheckingThreshold = 2;
+		if (!strcmp(options.mode, "--benchmark-inflate")) {
+			return runInflateBenchmark(options.leftFile);
+		}
 
-constexpr int occlusionNeighbours = 256;
+		return runDecodeBenchmark(options.leftFile);
+	}
 
-constexpr int scaleFactor = 4;
+	ProfileZone programZone("program"); // For calculating time of entire program
 
-// Prototypes
-std::vector<unsigned char> loadImage(const char*, unsigned&, unsigned&);
-std::vector<unsigned> scaleAndGray(std::vector<unsigned char>, const unsigned, const unsigned);
-std::vector<unsigned> zncc(
-	std::vector<unsigned>, 
-	std::vector<unsigned>, 
-	const unsigned, 
-	const unsigned,
-	const int,
-	const int
-);
-std::vector<unsigned> crossChecking(
-	std::vector<unsigned>,
-	std::vector<unsigned>,
-	const unsigned, 
-	const unsigned
-);
-std::vector<unsigned> occlusionFilling(std::vector<unsigned>, const unsigned, const unsigned);
-std::vector<unsigned char> normalize(std::vector<unsigned>, const unsigned, const unsigned);
-
-
-int main() {
-	Timer timer; // For calculating time of entire program
-
-	std::vector<unsigned char> leftPixels, rightPixels;
-	unsigned width, height, rightWidth, rightHeight;
-
-	std::cout << "Reading Left Image...";
-	leftPixels = loadImage("imageL.png", width, height);
-
-	std::cout << "Reading Right Image...";
-	rightPixels = loadImage("imageR.png", rightWidth, rightHeight);
+	// Both images are decoded at the same time, straight to downscaled grayscale, the full size RGBA images are never stored
+	PairDecoder decoder(scaleFactor, raw);
+
+	std::cout << "Reading Images...";
+	loadImagePair(decoder, options.leftFile, options.rightFile);
+
+	const std::vector<unsigned>& grayL = decoder.left();
+	const std::vector<unsigned>& grayR = decoder.right();
 
 	// left and right images are assumed to be of same dimensions
-	assert(width == rightWidth && height == rightHeight);
+	assert(decoder.leftWidth() == decoder.rightWidth() && decoder.leftHeight() == decoder.rightHeight());
 
-	std::vector<unsigned> grayL = scaleAndGray(leftPixels, width, height);
-	std::vector<unsigned> grayR = scaleAndGray(rightPixels, width, height);
+	unsigned width = decoder.leftWidth() / scaleFactor;
+	unsigned height = decoder.leftHeight() / scaleFactor;
 
-	width /= scaleFactor;
-	height /= scaleFactor;
+	// The PNGs are encoded in the background, images above the selected verbosity are never normalized
+	ImageWriter writer(options.format);
 
-	unsigned error = lodepng::encode("grayL.png", normalize(grayL, width, height), width, height);
-	error = lodepng::encode("grayR.png", normalize(grayR, width, height), width, height);
+	auto writeImage = [&](const int level, const char* name, const std::vector<unsigned>& map) {
+		if (options.verbosity >= level) {
+			writer.write(name + std::string(imageExtension(options.format)), map, width, height);
+		}
+	};
 
-	if (error) {
-		std::cout << lodepng_error_text(error);
-		std::cin.get();
-		return -1;
-	}
+	writeImage(2, "grayL", grayL);
+	writeImage(2, "grayR", grayR);
 
 	// Calculate the disparity maps of left over right and vice versa
 	std::cout << "Calculating Left Disparity Map...";
-	std::vector<unsigned> dispLR = zncc(grayL, grayR, width, height, 0, maxDisparity);
+	std::vector<unsigned> dispLR = zncc(grayL, grayR, width, height, 0, options.maxDisp, options.window, options.window);
 
-	error = lodepng::encode("dispLR.png", normalize(dispLR, width, height), width, height);
+	writeImage(2, "dispLR", dispLR);
 
 	std::cout << "Calculating Right Disparity Map...";
-	std::vector<unsigned> dispRL = zncc(grayR, grayL, width, height, -maxDisparity, 0);
+	std::vector<unsigned> dispRL = zncc(grayR, grayL, width, height, -options.maxDisp, 0, options.window, options.window);
 
-	error = lodepng::encode("dispRL.png", normalize(dispRL, width, height), width, height);
+	writeImage(2, "dispRL", dispRL);
 
 	std::cout << "Performing cross checking...";
 	std::vector<unsigned> dispCC = crossChecking(dispLR, dispRL, width, height);
 
-	error = lodepng::encode("dispCC.png", normalize(dispCC, width, height), width, height);
+	writeImage(1, "dispCC", dispCC);
 
 	std::cout << "Performing Occlusion Filling...";
 	std::vector<unsigned> ocfill = occlusionFilling(dispCC, width, height);
 
-	error = lodepng::encode("output.png", normalize(ocfill, width, height), width, height);
+	writeImage(0, "output", ocfill);
+
+	// The raw map for comparing backends, independent of --format
+	ImageWriter rawWriter(ImageFormat::Pgm);
+	if (options.outputFile) {
+		rawWriter.write(options.outputFile, ocfill, width, height);
+	}
+
+	// Only the part of the encoding that didn't overlap with the computation is on the critical path
+	unsigned error;
+	{
+		std::cout << "Writing images...";
+		ProfileZone zone("write images", true);
+		error = writer.flush();
+
+		unsigned rawError = rawWriter.flush();
+		if (!error) error = rawError;
+	}
+
+	std::cout << "Encoding the images took " << writer.getEncodeTime() << " s in the background" << std::endl;
 
-	std::cout << "The program took " << timer.getElapsedTime() << " s" << std::endl;
+	if (error) {
+		std::cout << lodepng_error_text(error);
+		std::cin.get();
+		return -1;
+	}
+
+	std::cout << "The program took " << programZone.getElapsedTime() << " s" << std::endl;
 
 	std::cin.get();
 	return 0;
 }
 
-std::vector<unsigned char> loadImage(const char* filename, unsigned& width, unsigned& height) {
-	Timer timer;
+bool parseOptions(int argc, char** argv, Options& options) {
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--stream") || !strcmp(argv[i], "--tiled") || !strcmp(argv[i], "--benchmark-decode")
+			|| !strcmp(argv[i], "--benchmark-inflate")) {
+			options.mode = argv[i];
+		} else if (!strcmp(argv[i], "--crop") && i + 5 < argc) {
+			options.mode = argv[i];
+			options.cropFile = argv[++i];
+			for (int k = 0; k < 4; k++) {
+				options.crop[k] = atoi(argv[++i]);
+			}
+		} else if (!strcmp(argv[i], "--profile") && i + 1 < argc) {
+			options.profileFile = argv[++i];
+		} else if (!strcmp(argv[i], "--counters")) {
+			options.counters = true;
+		} else if (!strcmp(argv[i], "--left") && i + 1 < argc) {
+			options.leftFile = argv[++i];
+		} else if (!strcmp(argv[i], "--right") && i + 1 < argc) {
+			options.rightFile = argv[++i];
+		} else if (!strcmp(argv[i], "--window") && i + 1 < argc) {
+			options.window = atoi(argv[++i]);
+			if (options.window <= 0) return false;
+		} else if (!strcmp(argv[i], "--max-disparity") && i + 1 < argc) {
+			options.maxDisp = atoi(argv[++i]);
+			if (options.maxDisp <= 0) return false;
+		} else if (!strcmp(argv[i], "--output") && i + 1 < argc) {
+			options.outputFile = argv[++i];
+		} else if (!strcmp(argv[i], "--verbosity") && i + 1 < argc) {
+			options.verbosity = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "--format") && i + 1 < argc) {
+			const char* format = argv[++i];
+			if (!strcmp(format, "rgba")) {
+				options.format = ImageFormat::Rgba;
+			} else if (!strcmp(format, "gray8")) {
+				options.format = ImageFormat::Gray8;
+			} else if (!strcmp(format, "gray16")) {
+				options.format = ImageFormat::Gray16;
+			} else if (!strcmp(format, "pgm")) {
+				options.format = ImageFormat::Pgm;
+			} else if (!strcmp(format, "tiles")) {
+				options.format = ImageFormat::Tiles;
+			} else {
+				return false;
+			}
+		} else if (!strcmp(argv[i], "--raw") && i + 3 < argc) {
+			options.isRaw = true;
+			options.raw.width = atoi(argv[++i]);
+			options.raw.height = atoi(argv[++i]);
+			options.raw.channels = atoi(argv[++i]);
+		} else {
+			return false;
+		}
+	}
+
+	// The counters are only shown in the profiler report
+	return !options.counters || options.profileFile;
+}
+
+// Counters that can't be opened are left out, without any the zones are only timed
+void enableCounters() {
+	std::string error;
 
-	std::vector<unsigned char> pixels;
+	if (!Profiler::instance().enableCounters(error)) {
+		std::cout << "Hardware counters unavailable (" << error << "), only timing is recorded" << std::endl;
+	} else if (!error.empty()) {
+		std::cout << "Some hardware counters unavailable (" << error << ")" << std::endl;
+	}
+}
 
-	unsigned error = lodepng::decode(pixels, width, height, filename);
+void loadImagePair(PairDecoder& decoder, const char* leftFile, const char* rightFile) {
+	ProfileZone zone("load image pair", true);
+
+	unsigned error = decoder.decode(leftFile, rightFile);
 	if (error) {
-		std::cout << "Failed to load image: " << lodepng_error_text(error) << std::endl;
+		std::cout << "Failed to load image: " << imageErrorText(error) << std::endl;
 		std::cin.get();
 		exit(-1);
 	}
-
-	return pixels;
 }
 
-std::vector<unsigned> scaleAndGray(
-	std::vector<unsigned char> origPixels, 
-	const unsigned width, 
-	const unsigned height
-) {
-	unsigned newWidth = width / scaleFactor;
-	unsigned newHeight = height / scaleFactor;
-
-	std::vector<unsigned> result(newWidth * newHeight);
-
-	// Downscaling and conversion to grayscale
-	for (int i = 0; i < newHeight; i++) {
-		for (int j = 0; j < newWidth; j++) {
-			int x = (scaleFactor * i - 1 * (i > 0));
-			int y = (scaleFactor * j - 1 * (j > 0));
-
-			result[i * newWidth + j] = 
-				0.3 * origPixels[x * (4 * width) + 4 * y] + 
-				0.59 * origPixels[x * (4 * width) + 4 * y + 1] + 
-				0.11 * origPixels[x * (4 * width) + 4 * y + 2];
+/*
+Runs the streaming pipeline and writes the disparity rows to output.pgm as they are produced.
+* The full map is never in memory, so it can't be normalized like output.png.
+  The raw disparities are stored instead, as 8 bit PGM with maximum value 255 like ImageFormat::Pgm.
+*/
+int runStreaming(const char* leftFile, const char* rightFile, const RawFormat* raw) {
+	ProfileZone zone("streaming", true);
+
+	std::unique_ptr<GrayReader> left, right;
+
+	unsigned error = openGrayReader(left, leftFile, scaleFactor, raw);
+	if (!error) error = openGrayReader(right, rightFile, scaleFactor, raw);
+
+	if (error) {
+		std::cout << "Failed to load image: " << imageErrorText(error) << std::endl;
+		std::cin.get();
+		return -1;
+	}
+
+	// left and right images are assumed to be of same dimensions
+	assert(left->fullWidth() == right->fullWidth() && left->fullHeight() == right->fullHeight());
+
+	unsigned width = left->width();
+	unsigned height = left->height();
+
+	std::ofstream output("output.pgm", std::ios::binary);
+	output << "P5\n" << width << " " << height << "\n255\n";
+
+	std::vector<unsigned char> line(width);
+
+	std::cout << "Streaming Disparity Map...";
+	error = streamDisparity(
+		[&](unsigned* row) { return left->nextRow(row); },
+		[&](unsigned* row) { return right->nextRow(row); },
+		width,
+		height,
+		[&](unsigned, const unsigned* disparity) {
+			for (unsigned j = 0; j < width; j++) {
+				line[j] = (unsigned char)disparity[j];
+			}
+			output.write((const char*)line.data(), width);
 		}
+	);
+
+	if (error) {
+		std::cout << "Failed to load image: " << imageErrorText(error) << std::endl;
+		std::cin.get();
+		return -1;
 	}
 
-	return result;
+	std::cin.get();
+	return 0;
 }
 
-std::vector<unsigned> zncc(
-	std::vector<unsigned> leftPixels, 
-	std::vector<unsigned> rightPixels, 
-	const unsigned width, 
-	const unsigned height,
-	const int minDisp,
-	const int maxDisp
-) {
-	Timer timer;
-
-	std::vector<unsigned> disparityMap(width * height);
-
-	const unsigned windowSize = windowWidth * windowHeight;
-
-	float meanLBlock, meanRBlock;
-	float stdLBlock, stdRBlock;
-
-	float currentZncc;
-	float bestDisparity, bestZncc;
-
-	for (int i = 0; i < height; i++) {
-		for (int j = 0; j < width; j++) {
-			bestDisparity = maxDisp;
-			bestZncc = -1;
-
-			// Select the best disparity value for the current pixel
-			for (int d = minDisp; d <= maxDisp; d++) {
-				// Calculating mean of blocks using the sliding window method
-				meanLBlock = meanRBlock = 0;
-
-				for (int x = -windowHeight / 2; x < windowHeight / 2; x++) {
-					for (int y = -windowWidth / 2; y < windowWidth / 2; y++) {
-						// Check for image borders
-						if (
-							!(i + x >= 0) || 
-							!(i + x < height) || 
-							!(j + y >= 0) || 
-							!(j + y < width) || 
-							!(j + y - d >= 0) || 
-							!(j + y - d < width)
-						) {
-							continue;
-						}
-
-						meanLBlock += leftPixels[(i + x) * width + (j + y)];
-						meanRBlock += rightPixels[(i + x) * width + (j + y - d)];
-					}
-				}
+/*
+Runs the tiled out of core pipeline, the result is written to output.pgm like in the streaming mode.
+* An interrupted run continues from its checkpoint when started again.
+*/
+int runTiled(const char* leftFile, const char* rightFile, const RawFormat* raw, const char* containerFile) {
+	ProfileZone zone("tiled", true);
 
-				meanLBlock /= windowSize;
-				meanRBlock /= windowSize;
-
-				// Calculate ZNCC for current disparity value
-				stdLBlock = stdRBlock = 0;
-				currentZncc = 0;
-
-				for (int x = -windowHeight / 2; x < windowHeight / 2; x++) {
-					for (int y = -windowWidth / 2; y < windowWidth / 2; y++) {
-						// Check for image borders
-						if (
-							!(i + x >= 0) ||
-							!(i + x < height) ||
-							!(j + y >= 0) ||
-							!(j + y < width) ||
-							!(j + y - d >= 0) ||
-							!(j + y - d < width)
-							) {
-							continue;
-						}
-
-						int centerL = leftPixels[(i + x) * width + (j + y)] - meanLBlock;
-						int centerR = rightPixels[(i + x) * width + (j + y - d)] - meanRBlock;
-
-						// standard deviation
-						stdLBlock += centerL * centerL;
-						stdRBlock += centerR * centerR;
-
-						currentZncc += centerL * centerR;
-					}
-				}
+	std::unique_ptr<GrayReader> left, right;
 
-				currentZncc /= sqrt(stdLBlock) * sqrt(stdRBlock);
+	unsigned error = openGrayReader(left, leftFile, scaleFactor, raw);
+	if (!error) error = openGrayReader(right, rightFile, scaleFactor, raw);
 
-				// Selecting best disparity
-				if (currentZncc > bestZncc) {
-					bestZncc = currentZncc;
-					bestDisparity = d;
-				}
-			}
+	std::cout << "Calculating Disparity Map in tiles...";
+	if (!error) error = tiledDisparity(*left, *right, "output.pgm", containerFile);
 
-			disparityMap[i * width + j] = (unsigned)abs(bestDisparity);
-		}
+	if (error) {
+		std::cout << "Failed to compute disparity map: " << imageErrorText(error) << std::endl;
+		std::cin.get();
+		return -1;
 	}
 
-	return disparityMap;
+	std::cin.get();
+	return 0;
 }
 
-std::vector<unsigned> crossChecking(
-	std::vector<unsigned> leftDisp, 
-	std::vector<unsigned> rightDisp, 
-	const unsigned width, 
-	const unsigned height
-) {
-	Timer timer;
+/*
+Reads the region crop = { x, y, width, height } of a tile container and writes it to crop.pgm with its raw values.
+* Only the tiles overlapping the region are decoded.
+*/
+int runCrop(const char* containerFile, const unsigned* crop) {
+	TileContainerReader container;
 
-	const unsigned imageSize = width * height;
+	std::vector<unsigned> region;
 
-	std::vector<unsigned> result(imageSize);
+	unsigned error = container.open(containerFile);
+	if (!error) error = container.readRegion(crop[0], crop[1], crop[2], crop[3], region);
 
-	for (int i = 0; i < imageSize; i++) {
-		if (abs((int)leftDisp[i] - (int)rightDisp[i]) > crossCheckingThreshold) {
-			result[i] = 0;
-		} else {
-			result[i] = leftDisp[i];
-		}
+	if (!error) {
+		ImageWriter writer(ImageFormat::Pgm);
+		writer.write("crop.pgm", std::move(region), crop[2], crop[3]);
+		error = writer.flush();
 	}
 
-	return result;
+	if (error) {
+		std::cout << "Failed to read the region: " << imageErrorText(error) << std::endl;
+		return -1;
+	}
+
+	return 0;
 }
 
-std::vector<unsigned> occlusionFilling(
-	std::vector<unsigned> map,
-	const unsigned width,
-	const unsigned height
-) {
-	Timer timer;
-
-	std::vector<unsigned> result(width * height);
-
-	for (int i = 0; i < height; i++) {
-		for (int j = 0; j < width; j++) {
-			unsigned currentIndex = i * width + j;
-			result[currentIndex] = map[currentIndex];
-
-			// If the pixel value is 0, copy value from nearest non zero neighbour
-			if (map[currentIndex] == 0) {
-				bool stop = false;
-
-				for (int n = 1; n <= occlusionNeighbours / 2 && !stop; n++) {
-					for (int y = -n; y <= n && !stop; y++) {
-						for (int x = -n; x <= n && !stop; x++) {
-							// Checking for borders
-							if (
-								!(i + x >= 0) || 
-								!(i + x < height) || 
-								!(j + y >= 0) || 
-								!(j + y < width) || 
-								(x == 0 && y == 0)
-							) {
-								continue;
-							}
-
-							int currentIndex = (i + x) * width + (j + y);
-
-							if (map[currentIndex] == 0) {
-								result[i * width + j] = map[currentIndex];
-								stop = true;
-								break;
-							}
-						}
-					}
-				}
+/*
+Measures the cost of getting the downscaled gray image from a PNG and from uncompressed copies of it.
+* The PNG is decoded with lodepng (RGBA + scaleAndGray) and with the streaming PngGrayReader,
+  then written as PPM and raw RGB next to it and read back through the memory mapped RawGrayReader.
+* Every decoder runs several times, the fastest run is reported in ms per megapixel of the original image.
+*/
+int runDecodeBenchmark(const char* pngFile) {
+	constexpr int runs = 5;
+
+	unsigned width, height;
+	std::vector<unsigned char> pixels;
+
+	unsigned error = lodepng::decode(pixels, width, height, pngFile, LCT_RGB);
+	if (error) {
+		std::cout << "Failed to load image: " << lodepng_error_text(error) << std::endl;
+		return -1;
+	}
+
+	const std::string ppmFile = std::string(pngFile) + ".benchmark.ppm";
+	const std::string rawFile = std::string(pngFile) + ".benchmark.raw";
+
+	std::ofstream ppm(ppmFile, std::ios::binary);
+	ppm << "P6\n" << width << " " << height << "\n255\n";
+	ppm.write((const char*)pixels.data(), pixels.size());
+	ppm.close();
+
+	std::ofstream(rawFile, std::ios::binary).write((const char*)pixels.data(), pixels.size());
+
+	const RawFormat raw = { width, height, 3 };
+	const double megapixels = width * (double)height / 1e6;
+
+	std::vector<unsigned> reference;
+	unsigned referenceWidth, referenceHeight;
+	decodeScaledGray(reference, referenceWidth, referenceHeight, pngFile, scaleFactor);
+
+	auto measure = [&](const char* name, std::function<unsigned(std::vector<unsigned>&)> decode) {
+		double best = 0;
+		std::vector<unsigned> gray;
+
+		for (int i = 0; i < runs; i++) {
+			auto start = std::chrono::steady_clock::now();
+			unsigned error = decode(gray);
+			std::chrono::duration<double, std::milli> duration = std::chrono::steady_clock::now() - start;
+
+			if (error) {
+				std::cout << name << ": " << imageErrorText(error) << std::endl;
+				return;
 			}
+
+			if (i == 0 || duration.count() < best) best = duration.count();
 		}
-	}
 
-	return result;
-}
+		std::cout << name << ": " << best << " ms, " << best / megapixels << " ms/MP"
+			<< (gray == reference ? "" : " (result differs)") << std::endl;
+	};
+
+	std::cout << "Decoding " << pngFile << " (" << width << "x" << height << ", " << megapixels << " MP)" << std::endl;
+
+	measure("lodepng decode + scaleAndGray", [&](std::vector<unsigned>& gray) {
+		std::vector<unsigned char> rgba;
+		unsigned w, h;
+		unsigned error = lodepng::decode(rgba, w, h, pngFile);
+		if (!error) gray = scaleAndGray(rgba, w, h);
+		return error;
+	});
+
+	unsigned w, h;
+
+	measure("PNG streaming gray", [&](std::vector<unsigned>& gray) {
+		return decodeScaledGray(gray, w, h, pngFile, scaleFactor);
+	});
 
-std::vector<unsigned char> normalize(
-	std::vector<unsigned> in, 
-	const unsigned width, 
-	const unsigned height
-) {
-	std::vector<unsigned char> result(width * height * 4);
+	measure("PPM mapped gray", [&](std::vector<unsigned>& gray) {
+		return decodeScaledGray(gray, w, h, ppmFile.c_str(), scaleFactor);
+	});
 
-	unsigned char max = 0;
-	unsigned char min = UCHAR_MAX;
+	measure("raw mapped gray", [&](std::vector<unsigned>& gray) {
+		return decodeScaledGray(gray, w, h, rawFile.c_str(), scaleFactor, &raw);
+	});
+
+	remove(ppmFile.c_str());
+	remove(rawFile.c_str());
+
+	return 0;
+}
 
-	for (int i = 0; i < width * height; i++) {
-		if (in[i] > max) {
-			max = in[i];
+/*
+Measures lodepng's built in zlib decompression against fastZlibDecompress.
+* The given PNG and a large synthetic one (smooth gradients with noise, like a photo) are decoded to RGBA both ways,
+  the time spent in the zlib hook is measured separately from the whole decode.
+* Every decoder runs several times, the fastest run is reported.
+*/
+int runInflateBenchmark(const char* pngFile) {
+	constexpr int runs = 5;
+	constexpr unsigned syntheticSize = 3000;
+
+	typedef unsigned (*ZlibFunction)(unsigned char**, size_t*, const unsigned char*, size_t, const LodePNGDecompressSettings*);
+
+	// Context of the timing hook, the decompression it wraps and where its time is added up
+	struct TimedZlib {
+		ZlibFunction decompress;
+		double milliseconds;
+	};
+
+	auto timedZlib = [](unsigned char** out, size_t* outsize, const unsigned char* in, size_t insize,
+		const LodePNGDecompressSettings* settings) -> unsigned {
+		TimedZlib* context = (TimedZlib*)settings->custom_context;
+
+		auto start = std::chrono::steady_clock::now();
+		unsigned error = context->decompress(out, outsize, in, insize, settings);
+		std::chrono::duration<double, std::milli> duration = std::chrono::steady_clock::now() - start;
+
+		context->milliseconds += duration.count();
+		return error;
+	};
+
+	auto benchmark = [&](const std::string& name, const std::vector<unsigned char>& png) {
+		std::vector<unsigned char> reference;
+		unsigned width, height;
+
+		unsigned error = lodepng::decode(reference, width, height, png);
+		if (error) {
+			std::cout << "Failed to load image: " << lodepng_error_text(error) << std::endl;
+			return;
 		}
 
-		if (in[i] < min) {
-			min = in[i];
+		// Size of the filtered scanlines the zlib stream inflates to
+		const double megabytes = (width * 4.0 + 1) * height / 1e6;
+
+		std::cout << "Decoding " << name << " (" << width << "x" << height << ", " << png.size() / 1e6 << " MB compressed)" << std::endl;
+
+		auto measure = [&](const char* decoder, ZlibFunction decompress) {
+			double bestDecode = 0, bestZlib = 0;
+			bool same = true;
+
+			for (int i = 0; i < runs; i++) {
+				TimedZlib context = { decompress, 0 };
+
+				lodepng::State state;
+				state.decoder.zlibsettings.custom_zlib = timedZlib;
+				state.decoder.zlibsettings.custom_context = &context;
+
+				std::vector<unsigned char> pixels;
+				unsigned w, h;
+
+				auto start = std::chrono::steady_clock::now();
+				unsigned error = lodepng::decode(pixels, w, h, state, png);
+				std::chrono::duration<double, std::milli> duration = std::chrono::steady_clock::now() - start;
+
+				if (error) {
+					std::cout << decoder << ": " << lodepng_error_text(error) << std::endl;
+					return;
+				}
+
+				same = same && pixels == reference;
+
+				if (i == 0 || duration.count() < bestDecode) bestDecode = duration.count();
+				if (i == 0 || context.milliseconds < bestZlib) bestZlib = context.milliseconds;
+			}
+
+			std::cout << decoder << ": decode " << bestDecode << " ms, zlib " << bestZlib << " ms ("
+				<< megabytes / (bestZlib / 1000) << " MB/s)" << (same ? "" : " (result differs)") << std::endl;
+		};
+
+		measure("lodepng inflate", lodepng_zlib_decompress);
+		measure("fastInflate", fastZlibDecompress);
+	};
+
+	std::vector<unsigned char> png;
+	unsigned error = lodepng::load_file(png, pngFile);
+	if (error) {
+		std::cout << "Failed to load image: " << lodepng_error_text(error) << std::endl;
+		return -1;
+	}
+
+	benchmark(pngFile, png);
+
+	std::vector<unsigned char> synthetic((size_t)syntheticSize * syntheticSize * 3);
+	unsigned seed = 1;
+	for (unsigned i = 0; i < syntheticSize; i++) {
+		for (unsigned j = 0; j < syntheticSize; j++) {
+			for (unsigned c = 0; c < 3; c++) {
+				seed = seed * 1103515245 + 12345;
+				synthetic[((size_t)i * syntheticSize + j) * 3 + c] = (unsigned char)((i * (c + 1) + j) / 16 + ((seed >> 16) & 7));
+			}
 		}
 	}
 
-	// Normalize values to be between 0 and 255
-	int mapIndex = 0;
-	for (int i = 0; i < width * height * 4; i+=4, mapIndex++) {
-		result[i] = result[i + 1] = result[i + 2] = (unsigned char)(255 * (in[mapIndex] - min) / (max - min));
-		result[i + 3] = 255;
+	png.clear();
+	error = lodepng::encode(png, synthetic, syntheticSize, syntheticSize, LCT_RGB);
+	if (error) {
+		std::cout << lodepng_error_text(error) << std::endl;
+		return -1;
 	}
 
-	return result;
+	benchmark("synthetic image", png);
+
+	return 0;
 }
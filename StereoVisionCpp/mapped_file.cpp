@@ -0,0 +1,168 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile() : m_Data(nullptr), m_Size(0), m_File(INVALID_HANDLE_VALUE), m_Mapping(nullptr) {}
+
+unsigned MappedFile::open(const char* filename) {
+	close();
+
+	m_File = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (m_File == INVALID_HANDLE_VALUE) return 78;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_File, &size) || size.QuadPart == 0) {
+		close();
+		return 78;
+	}
+	m_Size = (size_t)size.QuadPart;
+
+	m_Mapping = CreateFileMappingA(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_Mapping) {
+		m_Data = (unsigned char*)MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0);
+	}
+
+	if (!m_Data) {
+		close();
+		return 78;
+	}
+
+	return 0;
+}
+
+unsigned MappedFile::create(const char* filename, const size_t size) {
+	close();
+
+	m_File = CreateFileA(filename, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (m_File == INVALID_HANDLE_VALUE || size == 0) {
+		close();
+		return 79;
+	}
+
+	LARGE_INTEGER end;
+	end.QuadPart = size;
+	if (!SetFilePointerEx(m_File, end, nullptr, FILE_BEGIN) || !SetEndOfFile(m_File)) {
+		close();
+		return 79;
+	}
+	m_Size = size;
+
+	m_Mapping = CreateFileMappingA(m_File, nullptr, PAGE_READWRITE, 0, 0, nullptr);
+	if (m_Mapping) {
+		m_Data = (unsigned char*)MapViewOfFile(m_Mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+	}
+
+	if (!m_Data) {
+		close();
+		return 79;
+	}
+
+	return 0;
+}
+
+void MappedFile::close() {
+	if (m_Data) UnmapViewOfFile(m_Data);
+	if (m_Mapping) CloseHandle(m_Mapping);
+	if (m_File != INVALID_HANDLE_VALUE) CloseHandle(m_File);
+
+	m_Data = nullptr;
+	m_Mapping = nullptr;
+	m_File = INVALID_HANDLE_VALUE;
+	m_Size = 0;
+}
+
+void MappedFile::flush(const size_t offset, const size_t size) {
+	if (m_Data) FlushViewOfFile(m_Data + offset, size);
+}
+
+bool fileExists(const char* filename) {
+	return GetFileAttributesA(filename) != INVALID_FILE_ATTRIBUTES;
+}
+
+#else
+
+MappedFile::MappedFile() : m_Data(nullptr), m_Size(0), m_File(-1) {}
+
+unsigned MappedFile::open(const char* filename) {
+	close();
+
+	m_File = ::open(filename, O_RDONLY);
+	if (m_File < 0) return 78;
+
+	struct stat info;
+	if (fstat(m_File, &info) || info.st_size == 0) {
+		close();
+		return 78;
+	}
+	m_Size = (size_t)info.st_size;
+
+	void* data = mmap(nullptr, m_Size, PROT_READ, MAP_SHARED, m_File, 0);
+	if (data == MAP_FAILED) {
+		close();
+		return 78;
+	}
+	m_Data = (unsigned char*)data;
+
+	return 0;
+}
+
+unsigned MappedFile::create(const char* filename, const size_t size) {
+	close();
+
+	m_File = ::open(filename, O_RDWR | O_CREAT, 0644);
+	if (m_File < 0 || size == 0 || ftruncate(m_File, (off_t)size)) {
+		close();
+		return 79;
+	}
+	m_Size = size;
+
+	void* data = mmap(nullptr, m_Size, PROT_READ | PROT_WRITE, MAP_SHARED, m_File, 0);
+	if (data == MAP_FAILED) {
+		close();
+		return 79;
+	}
+	m_Data = (unsigned char*)data;
+
+	return 0;
+}
+
+void MappedFile::close() {
+	if (m_Data) munmap(m_Data, m_Size);
+	if (m_File >= 0) ::close(m_File);
+
+	m_Data = nullptr;
+	m_File = -1;
+	m_Size = 0;
+}
+
+void MappedFile::flush(const size_t offset, const size_t size) {
+	if (!m_Data) return;
+
+	// msync needs a page aligned address
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	size_t start = offset / page * page;
+
+	msync(m_Data + start, offset + size - start, MS_SYNC);
+}
+
+bool fileExists(const char* filename) {
+	struct stat info;
+	return stat(filename, &info) == 0;
+}
+
+#endif
+
+MappedFile::~MappedFile() {
+	close();
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+
+/*
+Class to map a whole file into memory.
+* Pages are only loaded when they are touched and can be dropped again by the OS,
+  so files larger than the available memory can be used like an array.
+* open returns 78 and create returns 79 on failure, the lodepng error codes for reading and writing files.
+*/
+class MappedFile {
+private:
+	unsigned char* m_Data;
+	size_t m_Size;
+
+#ifdef _WIN32
+	void* m_File;
+	void* m_Mapping;
+#else
+	int m_File;
+#endif
+
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// Maps an existing file read only
+	unsigned open(const char* filename);
+
+	// Maps a file for reading and writing, it is created if needed and resized to the given size
+	unsigned create(const char* filename, const size_t size);
+
+	void close();
+
+	// Writes the modified pages of the given byte range back to the file
+	void flush(const size_t offset, const size_t size);
+
+	inline unsigned char* data() { return m_Data; }
+	inline const unsigned char* data() const { return m_Data; }
+	inline size_t size() const { return m_Size; }
+};
+
+bool fileExists(const char* filename);
@@ -0,0 +1,67 @@
+#include "pair_decoder.h"
+
+#include "profiler.h"
+
+void PairDecoder::Side::decode(const int scaleFactor, const RawFormat* raw) {
+	error = decodeScaledGray(gray, width, height, reader, filename, scaleFactor, raw);
+}
+
+PairDecoder::PairDecoder(const int scaleFactor, const RawFormat* raw) :
+	m_ScaleFactor(scaleFactor), m_Raw(raw), m_HasWork(false), m_Stopping(false) {
+	m_Left.width = m_Left.height = m_Right.width = m_Right.height = 0;
+	m_Left.error = m_Right.error = 0;
+
+	m_Worker = std::thread(&PairDecoder::work, this);
+}
+
+PairDecoder::~PairDecoder() {
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Stopping = true;
+	}
+	m_Changed.notify_all();
+
+	m_Worker.join();
+}
+
+unsigned PairDecoder::decode(const char* leftFile, const char* rightFile) {
+	m_Left.filename = leftFile;
+	m_Right.filename = rightFile;
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_HasWork = true;
+	}
+	m_Changed.notify_all();
+
+	{
+		ProfileZone zone("decode left");
+		m_Left.decode(m_ScaleFactor, m_Raw);
+	}
+
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_Changed.wait(lock, [&] { return !m_HasWork; });
+
+	return m_Left.error ? m_Left.error : m_Right.error;
+}
+
+void PairDecoder::work() {
+	Profiler::instance().setThreadName("pair decoder");
+
+	std::unique_lock<std::mutex> lock(m_Mutex);
+
+	while (true) {
+		m_Changed.wait(lock, [&] { return m_Stopping || m_HasWork; });
+		if (m_Stopping) return;
+
+		lock.unlock();
+		{
+			ProfileZone zone("decode right");
+			m_Right.decode(m_ScaleFactor, m_Raw);
+		}
+		lock.lock();
+
+		m_HasWork = false;
+		m_Changed.notify_all();
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "gray_reader.h"
+
+/*
+Class to decode the left and right image of a stereo pair at the same time, frame after frame.
+* The right image is decoded on a worker thread that lives as long as the decoder, the left one on the calling thread,
+  so decoding a pair takes about as long as decoding one image.
+* Every side keeps its reader and its gray buffer between frames, after the first frame of a given size
+  decoding a pair doesn't allocate anymore.
+* The images are converted straight to the downscaled gray images, like decodeScaledGray.
+*/
+class PairDecoder {
+private:
+	struct Side {
+		std::unique_ptr<GrayReader> reader;
+		std::vector<unsigned> gray;
+		unsigned width, height; // Size of the original image
+		const char* filename;
+		unsigned error;
+
+		void decode(const int scaleFactor, const RawFormat* raw);
+	};
+
+	int m_ScaleFactor;
+	const RawFormat* m_Raw;
+	Side m_Left, m_Right;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_Changed;
+	bool m_HasWork, m_Stopping;
+	std::thread m_Worker;
+
+	void work();
+
+public:
+	// raw is used for both images when it isn't nullptr, it has to outlive the decoder
+	PairDecoder(const int scaleFactor, const RawFormat* raw = nullptr);
+	~PairDecoder();
+
+	PairDecoder(const PairDecoder&) = delete;
+	PairDecoder& operator=(const PairDecoder&) = delete;
+
+	// Returns the error of the left image if there is one, otherwise the one of the right image
+	unsigned decode(const char* leftFile, const char* rightFile);
+
+	// Downscaled gray images of the last pair, valid until the next decode
+	inline const std::vector<unsigned>& left() const { return m_Left.gray; }
+	inline const std::vector<unsigned>& right() const { return m_Right.gray; }
+
+	// Size of the original images
+	inline unsigned leftWidth() const { return m_Left.width; }
+	inline unsigned leftHeight() const { return m_Left.height; }
+	inline unsigned rightWidth() const { return m_Right.width; }
+	inline unsigned rightHeight() const { return m_Right.height; }
+};
@@ -0,0 +1,141 @@
+#include "perf_counters.h"
+
+#include <cstring>
+#include <fstream>
+
+#ifdef __linux__
+#include <cerrno>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+const char* counterName(const int counter) {
+	static const char* names[counterCount] = {
+		"cycles", "instructions", "LLC misses", "branch misses", "FP vector instructions"
+	};
+
+	return names[counter];
+}
+
+HardwareCounters::HardwareCounters() {
+	for (int i = 0; i < counterCount; i++) {
+		m_Files[i] = -1;
+	}
+}
+
+HardwareCounters::~HardwareCounters() {
+	close();
+}
+
+bool HardwareCounters::any() const {
+	for (int i = 0; i < counterCount; i++) {
+		if (m_Files[i] >= 0) return true;
+	}
+
+	return false;
+}
+
+#ifdef __linux__
+
+// The raw FP_ARITH_INST_RETIRED encoding only means that on Intel CPUs
+static bool isIntel() {
+	std::ifstream cpuinfo("/proc/cpuinfo");
+	std::string line;
+
+	while (std::getline(cpuinfo, line)) {
+		if (!line.compare(0, 9, "vendor_id")) {
+			return line.find("GenuineIntel") != std::string::npos;
+		}
+	}
+
+	return false;
+}
+
+int HardwareCounters::open(std::string& error) {
+	close();
+
+	struct Event {
+		unsigned type;
+		unsigned long long config;
+	};
+
+	// Same order as Counter, FP_ARITH_INST_RETIRED is event 0xc7 with umask 0x3c for the packed 128 and 256 bit variants
+	const Event events[counterCount] = {
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+		{ PERF_TYPE_RAW, 0x3cc7 }
+	};
+
+	const bool intel = isIntel();
+	int opened = 0;
+
+	for (int i = 0; i < counterCount; i++) {
+		if (i == (int)Counter::FpVectorInstructions && !intel) {
+			if (error.empty()) error = "FP vector instructions are only counted on Intel CPUs";
+			continue;
+		}
+
+		perf_event_attr attributes;
+		memset(&attributes, 0, sizeof(attributes));
+		attributes.size = sizeof(attributes);
+		attributes.type = events[i].type;
+		attributes.config = events[i].config;
+		attributes.exclude_kernel = 1;
+		attributes.exclude_hv = 1;
+		attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+		// This thread, any CPU, no group
+		m_Files[i] = (int)syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0);
+
+		if (m_Files[i] < 0) {
+			if (error.empty()) error = std::string(counterName(i)) + ": " + strerror(errno);
+		} else {
+			opened++;
+		}
+	}
+
+	return opened;
+}
+
+void HardwareCounters::close() {
+	for (int i = 0; i < counterCount; i++) {
+		if (m_Files[i] >= 0) ::close(m_Files[i]);
+		m_Files[i] = -1;
+	}
+}
+
+void HardwareCounters::read(long long* values) const {
+	for (int i = 0; i < counterCount; i++) {
+		unsigned long long data[3]; // value, time enabled, time running
+		values[i] = 0;
+
+		if (m_Files[i] < 0 || ::read(m_Files[i], data, sizeof(data)) != sizeof(data)) continue;
+
+		// Multiplexed counters only ran part of the time
+		if (data[2] > 0 && data[2] < data[1]) {
+			values[i] = (long long)((double)data[0] * data[1] / data[2]);
+		} else {
+			values[i] = (long long)data[0];
+		}
+	}
+}
+
+#else
+
+int HardwareCounters::open(std::string& error) {
+	error = "hardware counters are only supported on Linux";
+	return 0;
+}
+
+void HardwareCounters::close() {}
+
+void HardwareCounters::read(long long* values) const {
+	for (int i = 0; i < counterCount; i++) {
+		values[i] = 0;
+	}
+}
+
+#endif
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+
+// Events counted by HardwareCounters, in the order of the values it reads
+enum class Counter { Cycles, Instructions, LlcMisses, BranchMisses, FpVectorInstructions };
+
+constexpr int counterCount = 5;
+
+const char* counterName(const int counter);
+
+/*
+Hardware performance counters of the calling thread, read through Linux perf_event_open.
+* Every counter is opened on its own, so an event the CPU or the kernel doesn't offer is just missing.
+  In containers or with a strict perf_event_paranoid usually none can be opened, all values are 0 then.
+* Only user space is counted, which is where the pipeline runs, and is allowed up to perf_event_paranoid 2.
+* LLC misses are the generic cache miss event, which the kernel maps to last level cache misses.
+* FP vector instructions are the packed single and double FP_ARITH_INST_RETIRED events (128 and 256 bit)
+  of Intel CPUs since Skylake, there is no equivalent on other CPUs.
+* Counts are scaled up when the kernel had to multiplex the counters.
+* No counter is available on other systems than Linux.
+*/
+class HardwareCounters {
+private:
+	int m_Files[counterCount];
+
+public:
+	HardwareCounters();
+	~HardwareCounters();
+
+	HardwareCounters(const HardwareCounters&) = delete;
+	HardwareCounters& operator=(const HardwareCounters&) = delete;
+
+	// Starts counting on the calling thread, returns the number of counters opened. error receives why the first one failed.
+	int open(std::string& error);
+
+	void close();
+
+	inline bool available(const int counter) const { return m_Files[counter] >= 0; }
+
+	bool any() const;
+
+	// Current value of every counter, 0 for the ones that aren't available
+	void read(long long* values) const;
+};
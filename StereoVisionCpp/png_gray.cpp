@@ -0,0 +1,432 @@
+#include "png_gray.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+#include "fast_inflate.h"
+#include "inflate_stream.h"
+#include "lodepng.h"
+
+static unsigned readBits32(const unsigned char* buffer) {
+	return ((unsigned)buffer[0] << 24) | ((unsigned)buffer[1] << 16) | ((unsigned)buffer[2] << 8) | buffer[3];
+}
+
+static unsigned crc32Update(unsigned crc, const unsigned char* data, size_t length) {
+	struct CrcTable {
+		unsigned values[256];
+
+		CrcTable() {
+			for (unsigned n = 0; n < 256; n++) {
+				unsigned c = n;
+				for (int k = 0; k < 8; k++) {
+					c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+				}
+				values[n] = c;
+			}
+		}
+	};
+	static const CrcTable table;
+
+	crc = ~crc;
+	for (size_t i = 0; i < length; i++) {
+		crc = table.values[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	}
+
+	return ~crc;
+}
+
+/*
+Reads the chunks of a PNG file sequentially, checking the CRC of every chunk whose data is consumed.
+*/
+class ChunkReader {
+private:
+	FILE* m_File;
+	unsigned m_Remaining;
+	unsigned m_Crc;
+
+public:
+	char type[5];
+	unsigned length;
+
+	ChunkReader(FILE* file) : m_File(file), m_Remaining(0), m_Crc(0), length(0) {
+		type[4] = 0;
+	}
+
+	void reset(FILE* file) {
+		m_File = file;
+		m_Remaining = 0;
+		length = 0;
+	}
+
+	// Reads the length and type of the next chunk
+	unsigned next() {
+		unsigned char header[8];
+		if (fread(header, 1, 8, m_File) != 8) return 30;
+
+		length = readBits32(header);
+		if (length > 2147483647u) return 63;
+
+		memcpy(type, header + 4, 4);
+		m_Remaining = length;
+		m_Crc = crc32Update(0, header + 4, 4);
+
+		return 0;
+	}
+
+	// Reads up to size bytes of the current chunk's data
+	size_t read(unsigned char* buffer, size_t size) {
+		if (size > m_Remaining) size = m_Remaining;
+
+		size = fread(buffer, 1, size, m_File);
+		m_Crc = crc32Update(m_Crc, buffer, size);
+		m_Remaining -= (unsigned)size;
+
+		return size;
+	}
+
+	inline unsigned remaining() const { return m_Remaining; }
+
+	// Reads the CRC at the end of the current chunk, all of its data must have been read
+	unsigned checkCrc() {
+		unsigned char crc[4];
+		if (m_Remaining || fread(crc, 1, 4, m_File) != 4) return 30;
+
+		return readBits32(crc) == m_Crc ? 0 : 57;
+	}
+
+	unsigned skip() {
+		if (fseek(m_File, (long)m_Remaining + 4, SEEK_CUR)) return 30;
+
+		m_Remaining = 0;
+		return 0;
+	}
+};
+
+static unsigned readSample(const unsigned char* line, size_t index, unsigned bitDepth) {
+	size_t bit = index * bitDepth;
+	return (line[bit >> 3] >> (8 - bitDepth - (bit & 7))) & ((1u << bitDepth) - 1);
+}
+
+/*
+Converts the pixels at the sampled columns of an unfiltered scanline to gray.
+* The pixel is first expanded to 8 bit RGB exactly like lodepng does when decoding to RGBA.
+*/
+static void grayRow(
+	unsigned* out,
+	const unsigned char* line,
+	const PngGrayReader::PixelFormat& format,
+	const unsigned newWidth,
+	const int scaleFactor
+) {
+	for (unsigned j = 0; j < newWidth; j++) {
+		size_t y = scaleFactor * j - 1 * (j > 0);
+
+		unsigned char r, g, b;
+
+		switch (format.colorType) {
+		case LCT_GREY:
+			if (format.bitDepth == 8) {
+				r = g = b = line[y];
+			} else if (format.bitDepth == 16) {
+				r = g = b = line[y * 2];
+			} else {
+				r = g = b = readSample(line, y, format.bitDepth) * 255 / ((1u << format.bitDepth) - 1);
+			}
+			break;
+		case LCT_RGB:
+			if (format.bitDepth == 8) {
+				r = line[y * 3]; g = line[y * 3 + 1]; b = line[y * 3 + 2];
+			} else {
+				r = line[y * 6]; g = line[y * 6 + 2]; b = line[y * 6 + 4];
+			}
+			break;
+		case LCT_PALETTE: {
+			unsigned index = format.bitDepth == 8 ? line[y] : readSample(line, y, format.bitDepth);
+			r = format.palette[index * 3]; g = format.palette[index * 3 + 1]; b = format.palette[index * 3 + 2];
+			break;
+		}
+		case LCT_GREY_ALPHA:
+			r = g = b = line[y * format.bitDepth / 4];
+			break;
+		default: // LCT_RGBA
+			if (format.bitDepth == 8) {
+				r = line[y * 4]; g = line[y * 4 + 1]; b = line[y * 4 + 2];
+			} else {
+				r = line[y * 8]; g = line[y * 8 + 2]; b = line[y * 8 + 4];
+			}
+			break;
+		}
+
+		out[j] = 0.3 * r + 0.59 * g + 0.11 * b;
+	}
+}
+
+static unsigned char paethPredictor(int a, int b, int c) {
+	int pa = abs(b - c);
+	int pb = abs(a - c);
+	int pc = abs(a + b - 2 * c);
+
+	if (pa <= pb && pa <= pc) return a;
+	if (pb <= pc) return b;
+	return c;
+}
+
+/*
+Reverses the PNG filter of one scanline in place, precon is the previous unfiltered scanline (all zeros for the first one).
+*/
+static unsigned unfilterScanline(
+	unsigned char* recon,
+	const unsigned char* precon,
+	const unsigned filterType,
+	const size_t byteWidth,
+	const size_t length
+) {
+	size_t i;
+
+	switch (filterType) {
+	case 0:
+		break;
+	case 1:
+		for (i = byteWidth; i < length; i++) recon[i] += recon[i - byteWidth];
+		break;
+	case 2:
+		for (i = 0; i < length; i++) recon[i] += precon[i];
+		break;
+	case 3:
+		for (i = 0; i < byteWidth; i++) recon[i] += precon[i] >> 1;
+		for (i = byteWidth; i < length; i++) recon[i] += (recon[i - byteWidth] + precon[i]) >> 1;
+		break;
+	case 4:
+		for (i = 0; i < byteWidth; i++) recon[i] += precon[i];
+		for (i = byteWidth; i < length; i++) {
+			recon[i] += paethPredictor(recon[i - byteWidth], precon[i], precon[i - byteWidth]);
+		}
+		break;
+	default:
+		return 36;
+	}
+
+	return 0;
+}
+
+PngGrayReader::PngGrayReader(const int scaleFactor) :
+	GrayReader(scaleFactor), m_IsInterlaced(false), m_File(nullptr), m_ReadError(0),
+	m_LineBytes(0), m_ByteWidth(0), m_Row(0), m_GrayRow(0) {}
+
+PngGrayReader::~PngGrayReader() {
+	if (m_File) {
+		fclose(m_File);
+	}
+}
+
+unsigned PngGrayReader::open(const char* filename) {
+	// A reader can be opened again for the next frame, its buffers are reused
+	if (m_File) {
+		fclose(m_File);
+	}
+
+	m_Row = m_GrayRow = 0;
+	m_ReadError = 0;
+	m_Interlaced.clear();
+
+	m_File = fopen(filename, "rb");
+	if (!m_File) return 78;
+
+	if (m_Chunks) {
+		m_Chunks->reset(m_File);
+	} else {
+		m_Chunks.reset(new ChunkReader(m_File));
+	}
+
+	unsigned error = readHeader();
+	if (error) return error;
+
+	if (m_IsInterlaced) {
+		fclose(m_File);
+		m_File = nullptr;
+
+		unsigned width, height;
+		return fastDecode(m_Interlaced, width, height, filename);
+	}
+
+	// Everything up to the first IDAT chunk, only the palette is of interest
+	unsigned paletteSize = 0;
+	memset(m_Format.palette, 0, sizeof(m_Format.palette));
+
+	for (;;) {
+		error = m_Chunks->next();
+		if (error) return error;
+
+		if (!strcmp(m_Chunks->type, "IDAT")) {
+			break;
+		} else if (!strcmp(m_Chunks->type, "PLTE")) {
+			paletteSize = m_Chunks->length / 3;
+			if (paletteSize == 0 || paletteSize > 256 || m_Chunks->length % 3) return 38;
+			if (m_Chunks->read(m_Format.palette, m_Chunks->length) != m_Chunks->length) return 30;
+
+			error = m_Chunks->checkCrc();
+		} else if (!strcmp(m_Chunks->type, "IEND")) {
+			return 91;
+		} else if (!(m_Chunks->type[0] & 32)) {
+			return 69; // unknown critical chunk
+		} else {
+			error = m_Chunks->skip();
+		}
+
+		if (error) return error;
+	}
+
+	if (m_Format.colorType == LCT_PALETTE && paletteSize == 0) return 106;
+
+	const unsigned channels = m_Format.colorType == LCT_RGB ? 3 :
+		m_Format.colorType == LCT_GREY_ALPHA ? 2 :
+		m_Format.colorType == LCT_RGBA ? 4 : 1;
+	const size_t bitsPerPixel = channels * m_Format.bitDepth;
+
+	m_LineBytes = (m_Width * bitsPerPixel + 7) / 8;
+	m_ByteWidth = (bitsPerPixel + 7) / 8;
+
+	m_Current.assign(m_LineBytes + 1, 0);
+	m_Previous.assign(m_LineBytes + 1, 0);
+
+	if (m_Stream) {
+		m_Stream->reset();
+		return 0;
+	}
+
+	m_Stream.reset(new InflateStream([this](unsigned char* buffer, size_t size) -> size_t {
+		while (m_Chunks->remaining() == 0) {
+			// Move on to the next IDAT chunk, the image data ends at the first chunk of another type
+			if (strcmp(m_Chunks->type, "IDAT")) return 0;
+
+			m_ReadError = m_Chunks->checkCrc();
+			if (!m_ReadError) m_ReadError = m_Chunks->next();
+			if (m_ReadError) return 0;
+		}
+
+		return m_Chunks->read(buffer, size);
+	}));
+
+	return 0;
+}
+
+unsigned PngGrayReader::readHeader() {
+	static const unsigned char signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+
+	unsigned char buffer[13];
+	if (fread(buffer, 1, 8, m_File) != 8) return 27;
+	if (memcmp(buffer, signature, 8)) return 28;
+
+	unsigned error = m_Chunks->next();
+	if (error) return error;
+	if (strcmp(m_Chunks->type, "IHDR")) return 29;
+	if (m_Chunks->length != 13) return 94;
+	if (m_Chunks->read(buffer, 13) != 13) return 30;
+
+	error = m_Chunks->checkCrc();
+	if (error) return error;
+
+	m_Width = readBits32(buffer);
+	m_Height = readBits32(buffer + 4);
+	if (m_Width == 0 || m_Height == 0) return 93;
+
+	m_Format.colorType = buffer[9];
+	m_Format.bitDepth = buffer[8];
+
+	switch (m_Format.colorType) {
+	case LCT_GREY:
+		if (m_Format.bitDepth != 1 && m_Format.bitDepth != 2 && m_Format.bitDepth != 4 && m_Format.bitDepth != 8 && m_Format.bitDepth != 16) return 37;
+		break;
+	case LCT_PALETTE:
+		if (m_Format.bitDepth != 1 && m_Format.bitDepth != 2 && m_Format.bitDepth != 4 && m_Format.bitDepth != 8) return 37;
+		break;
+	case LCT_RGB:
+	case LCT_GREY_ALPHA:
+	case LCT_RGBA:
+		if (m_Format.bitDepth != 8 && m_Format.bitDepth != 16) return 37;
+		break;
+	default:
+		return 31;
+	}
+
+	if (buffer[10] != 0) return 32;
+	if (buffer[11] != 0) return 33;
+	if (buffer[12] > 1) return 34;
+
+	m_IsInterlaced = buffer[12] == 1;
+
+	return 0;
+}
+
+unsigned PngGrayReader::readScanline() {
+	size_t produced;
+	unsigned error = m_Stream->read(m_Current.data(), m_LineBytes + 1, produced);
+
+	if (m_ReadError) return m_ReadError;
+	if (error) return error;
+	if (produced != m_LineBytes + 1) return 91; // less data than the image needs
+
+	error = unfilterScanline(&m_Current[1], &m_Previous[1], m_Current[0], m_ByteWidth, m_LineBytes);
+	if (error) return error;
+
+	std::swap(m_Current, m_Previous);
+	m_Row++;
+
+	return 0;
+}
+
+unsigned PngGrayReader::nextRow(unsigned* out) {
+	if (m_GrayRow >= height()) return 91;
+
+	size_t x = m_ScaleFactor * m_GrayRow - 1 * (m_GrayRow > 0);
+
+	if (m_IsInterlaced) {
+		PixelFormat format;
+		format.colorType = LCT_RGBA;
+		format.bitDepth = 8;
+
+		grayRow(out, &m_Interlaced[x * 4 * m_Width], format, width(), m_ScaleFactor);
+		m_GrayRow++;
+
+		return 0;
+	}
+
+	// The source row may already be decoded, with a scale factor of 1 the first row is sampled twice
+	while (m_Row <= x) {
+		unsigned error = readScanline();
+		if (error) return error;
+	}
+
+	grayRow(out, &m_Previous[1], m_Format, width(), m_ScaleFactor);
+	m_GrayRow++;
+
+	if (m_GrayRow == height()) {
+		// Decode the rest of the image anyway, so truncated data and a wrong checksum are still reported
+		while (m_Row < m_Height) {
+			unsigned error = readScanline();
+			if (error) return error;
+		}
+
+		unsigned char extra;
+		size_t produced;
+		unsigned error = m_Stream->read(&extra, 1, produced);
+
+		if (m_ReadError) return m_ReadError;
+		if (error) return error;
+		if (produced) return 91; // more data than the image needs
+
+		// The CRC of the last IDAT chunk is only checked once its remaining bytes are read
+		unsigned char rest[256];
+		while (m_Chunks->remaining()) {
+			m_Chunks->read(rest, sizeof(rest));
+		}
+
+		if (!strcmp(m_Chunks->type, "IDAT")) {
+			return m_Chunks->checkCrc();
+		}
+	}
+
+	return 0;
+}
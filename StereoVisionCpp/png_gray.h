@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "gray_reader.h"
+
+class ChunkReader;
+class InflateStream;
+
+/*
+Decodes a PNG file straight into the downscaled grayscale image used by the stereo pipeline, one row at a time.
+* Picks the same source pixels and uses the same weights as scaleAndGray, so the result is identical
+  to decoding to RGBA with lodepng and calling scaleAndGray on it.
+* The IDAT data is inflated as a stream and unfiltered one scanline at a time, only the previous scanline
+  is kept around, so the full size RGBA (or raw) image is never allocated.
+* Interlaced images can't be unfiltered row by row and fall back to a regular lodepng decode (with fastInflate).
+* All methods return a lodepng error code, 0 on success.
+*/
+class PngGrayReader : public GrayReader {
+public:
+	struct PixelFormat {
+		unsigned colorType, bitDepth;
+		unsigned char palette[256 * 3];
+	};
+
+private:
+	PixelFormat m_Format;
+	bool m_IsInterlaced;
+
+	FILE* m_File;
+	std::unique_ptr<ChunkReader> m_Chunks;
+	std::unique_ptr<InflateStream> m_Stream;
+	unsigned m_ReadError;
+
+	// Filter type byte followed by the scanline, for the current and the previous row
+	std::vector<unsigned char> m_Current, m_Previous;
+	size_t m_LineBytes, m_ByteWidth;
+	unsigned m_Row, m_GrayRow;
+
+	std::vector<unsigned char> m_Interlaced; // Fully decoded RGBA image of an interlaced file
+
+	unsigned readHeader();
+	unsigned readScanline();
+
+public:
+	PngGrayReader(const int scaleFactor);
+	~PngGrayReader();
+
+	// Reads the header, every chunk up to the image data and prepares decoding, the buffers of an earlier image are reused
+	unsigned open(const char* filename);
+
+	// Decodes the next downscaled gray row into out, which must hold width() values
+	unsigned nextRow(unsigned* out) override;
+};
+
@@ -0,0 +1,135 @@
+#include "raw_gray.h"
+
+#include <algorithm>
+#include <cctype>
+
+// Skips whitespace and comments between the fields of a PNM header
+static void skipSeparators(const unsigned char* data, const size_t size, size_t& position) {
+	while (position < size) {
+		if (data[position] == '#') {
+			while (position < size && data[position] != '\n') position++;
+		} else if (isspace(data[position])) {
+			position++;
+		} else {
+			break;
+		}
+	}
+}
+
+static bool readNumber(const unsigned char* data, const size_t size, size_t& position, unsigned& value) {
+	skipSeparators(data, size, position);
+
+	if (position == size || !isdigit(data[position])) return false;
+
+	value = 0;
+	while (position < size && isdigit(data[position])) {
+		if (value > 100000000) return false;
+		value = value * 10 + (data[position++] - '0');
+	}
+
+	return true;
+}
+
+RawGrayReader::RawGrayReader(const int scaleFactor) :
+	GrayReader(scaleFactor), m_Pixels(nullptr), m_RowBytes(0), m_Channels(0), m_BytesPerSample(1), m_MaxValue(255), m_GrayRow(0) {}
+
+unsigned RawGrayReader::open(const char* filename) {
+	unsigned error = m_File.open(filename);
+	if (error) return error;
+
+	const unsigned char* data = m_File.data();
+	const size_t size = m_File.size();
+
+	if (size < 2 || data[0] != 'P' || (data[1] != '5' && data[1] != '6')) return errorInvalidPnmHeader;
+
+	m_Channels = data[1] == '5' ? 1 : 3;
+
+	size_t position = 2;
+	if (!readNumber(data, size, position, m_Width) ||
+		!readNumber(data, size, position, m_Height) ||
+		!readNumber(data, size, position, m_MaxValue)) {
+		return errorInvalidPnmHeader;
+	}
+
+	// Exactly one whitespace character separates the header from the pixels
+	if (position == size || !isspace(data[position])) return errorInvalidPnmHeader;
+	position++;
+
+	if (m_Width == 0 || m_Height == 0) return 93;
+	if (m_MaxValue == 0 || m_MaxValue > 65535) return errorInvalidPnmHeader;
+
+	m_BytesPerSample = m_MaxValue > 255 ? 2 : 1;
+
+	return setPixels(position);
+}
+
+unsigned RawGrayReader::openRaw(const char* filename, const RawFormat& format) {
+	if (format.width == 0 || format.height == 0) return errorInvalidRawFormat;
+	if (format.channels != 1 && format.channels != 3 && format.channels != 4) return errorInvalidRawFormat;
+
+	unsigned error = m_File.open(filename);
+	if (error) return error;
+
+	m_Width = format.width;
+	m_Height = format.height;
+	m_Channels = format.channels;
+	m_BytesPerSample = 1;
+	m_MaxValue = 255;
+
+	return setPixels(0);
+}
+
+unsigned RawGrayReader::setPixels(const size_t offset) {
+	m_RowBytes = (size_t)m_Width * m_Channels * m_BytesPerSample;
+
+	if (m_File.size() - offset < m_RowBytes * m_Height) return errorFileTooSmall;
+
+	m_Pixels = m_File.data() + offset;
+	m_GrayRow = 0;
+
+	return 0;
+}
+
+unsigned RawGrayReader::nextRow(unsigned* out) {
+	// Same source row as scaleAndGray picks
+	size_t x = m_ScaleFactor * m_GrayRow - 1 * (m_GrayRow > 0);
+	const unsigned char* line = m_Pixels + x * m_RowBytes;
+
+	const unsigned pixelBytes = m_Channels * m_BytesPerSample;
+	const bool isRGB = m_Channels >= 3;
+
+	for (unsigned j = 0; j < width(); j++) {
+		size_t y = m_ScaleFactor * j - 1 * (j > 0);
+		const unsigned char* pixel = line + y * pixelBytes;
+
+		unsigned r, g, b;
+
+		if (m_MaxValue == 255) {
+			r = pixel[0];
+			g = isRGB ? pixel[1] : r;
+			b = isRGB ? pixel[2] : r;
+		} else if (m_MaxValue == 65535) {
+			// The most significant byte comes first, like lodepng's conversion of 16 bit PNGs
+			r = pixel[0];
+			g = isRGB ? pixel[2] : r;
+			b = isRGB ? pixel[4] : r;
+		} else {
+			// Other maximum values are rescaled to 0..255
+			auto sample = [&](const unsigned c) {
+				const unsigned char* s = pixel + c * m_BytesPerSample;
+				unsigned value = m_BytesPerSample == 2 ? (s[0] << 8) | s[1] : s[0];
+				return std::min(value, m_MaxValue) * 255 / m_MaxValue;
+			};
+
+			r = sample(0);
+			g = isRGB ? sample(1) : r;
+			b = isRGB ? sample(2) : r;
+		}
+
+		out[j] = 0.3 * r + 0.59 * g + 0.11 * b;
+	}
+
+	m_GrayRow++;
+
+	return 0;
+}
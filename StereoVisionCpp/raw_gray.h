@@ -0,0 +1,31 @@
+#pragma once
+
+#include "gray_reader.h"
+#include "mapped_file.h"
+
+/*
+Reads uncompressed images through a memory mapping, the downscaled gray rows are converted straight from the mapped pages.
+* Supports binary PGM (P5) and PPM (P6) files with 8 or 16 bit samples, and raw headerless 8 bit images.
+* Nothing is decoded or copied, only the pages holding the sampled source rows are ever read from the disk.
+*/
+class RawGrayReader : public GrayReader {
+private:
+	MappedFile m_File;
+	const unsigned char* m_Pixels;
+	size_t m_RowBytes;
+	unsigned m_Channels, m_BytesPerSample, m_MaxValue;
+	unsigned m_GrayRow;
+
+	unsigned setPixels(const size_t offset);
+
+public:
+	RawGrayReader(const int scaleFactor);
+
+	// Maps a binary PGM or PPM file and reads its header
+	unsigned open(const char* filename);
+
+	// Maps a raw headerless file with the given dimensions
+	unsigned openRaw(const char* filename, const RawFormat& format);
+
+	unsigned nextRow(unsigned* out) override;
+};
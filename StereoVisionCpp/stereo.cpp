@@ -0,0 +1,325 @@
+#include <iostream>
+#include <climits>
+#include <cmath>
+
+#include "stereo.h"
+#include "profiler.h"
+
+std::vector<unsigned> scaleAndGray(
+	std::vector<unsigned char> origPixels, 
+	const unsigned width, 
+	const unsigned height
+) {
+	unsigned newWidth = width / scaleFactor;
+	unsigned newHeight = height / scaleFactor;
+
+	std::vector<unsigned> result(newWidth * newHeight);
+
+	// Downscaling and conversion to grayscale
+	for (int i = 0; i < newHeight; i++) {
+		for (int j = 0; j < newWidth; j++) {
+			int x = (scaleFactor * i - 1 * (i > 0));
+			int y = (scaleFactor * j - 1 * (j > 0));
+
+			result[i * newWidth + j] = 
+				0.3 * origPixels[x * (4 * width) + 4 * y] + 
+				0.59 * origPixels[x * (4 * width) + 4 * y + 1] + 
+				0.11 * origPixels[x * (4 * width) + 4 * y + 2];
+		}
+	}
+
+	return result;
+}
+
+std::vector<unsigned> zncc(
+	std::vector<unsigned> leftPixels, 
+	std::vector<unsigned> rightPixels, 
+	const unsigned width, 
+	const unsigned height,
+	const int minDisp,
+	const int maxDisp,
+	const int blockWidth,
+	const int blockHeight
+) {
+	ProfileZone zone("zncc", true);
+	zone.setPixels((unsigned long long)width * height);
+
+	std::vector<unsigned> disparityMap(width * height);
+
+	std::vector<const unsigned*> leftRows(blockHeight);
+	std::vector<const unsigned*> rightRows(blockHeight);
+
+	for (int i = 0; i < height; i++) {
+		for (int x = -blockHeight / 2; x < blockHeight / 2; x++) {
+			bool inside = i + x >= 0 && i + x < height;
+
+			leftRows[x + blockHeight / 2] = inside ? &leftPixels[(i + x) * width] : nullptr;
+			rightRows[x + blockHeight / 2] = inside ? &rightPixels[(i + x) * width] : nullptr;
+		}
+
+		znccRow(leftRows.data(), rightRows.data(), &disparityMap[i * width], width, minDisp, maxDisp, 0, width, 0, blockWidth, blockHeight);
+	}
+
+	return disparityMap;
+}
+
+void znccRow(
+	const unsigned* const* leftRows,
+	const unsigned* const* rightRows,
+	unsigned* disparityRow,
+	const unsigned width,
+	const int minDisp,
+	const int maxDisp,
+	const int columnBegin,
+	const int columnEnd,
+	const int columnOffset,
+	const int blockWidth,
+	const int blockHeight
+) {
+	const unsigned windowSize = blockWidth * blockHeight;
+
+	float meanLBlock, meanRBlock;
+	float stdLBlock, stdRBlock;
+
+	float currentZncc;
+	float bestDisparity, bestZncc;
+
+	for (int j = columnBegin; j < columnEnd; j++) {
+		bestDisparity = maxDisp;
+		bestZncc = -1;
+
+		// Select the best disparity value for the current pixel
+		for (int d = minDisp; d <= maxDisp; d++) {
+			// Calculating mean of blocks using the sliding window method
+			meanLBlock = meanRBlock = 0;
+
+			for (int x = -blockHeight / 2; x < blockHeight / 2; x++) {
+				const unsigned* leftRow = leftRows[x + blockHeight / 2];
+				const unsigned* rightRow = rightRows[x + blockHeight / 2];
+
+				for (int y = -blockWidth / 2; y < blockWidth / 2; y++) {
+					// Check for image borders
+					if (
+						!leftRow ||
+						!(j + y >= 0) || 
+						!(j + y < width) || 
+						!(j + y - d >= 0) || 
+						!(j + y - d < width)
+					) {
+						continue;
+					}
+
+					meanLBlock += leftRow[j + y - columnOffset];
+					meanRBlock += rightRow[j + y - d - columnOffset];
+				}
+			}
+
+			meanLBlock /= windowSize;
+			meanRBlock /= windowSize;
+
+			// Calculate ZNCC for current disparity value
+			stdLBlock = stdRBlock = 0;
+			currentZncc = 0;
+
+			for (int x = -blockHeight / 2; x < blockHeight / 2; x++) {
+				const unsigned* leftRow = leftRows[x + blockHeight / 2];
+				const unsigned* rightRow = rightRows[x + blockHeight / 2];
+
+				for (int y = -blockWidth / 2; y < blockWidth / 2; y++) {
+					// Check for image borders
+					if (
+						!leftRow ||
+						!(j + y >= 0) ||
+						!(j + y < width) ||
+						!(j + y - d >= 0) ||
+						!(j + y - d < width)
+						) {
+						continue;
+					}
+
+					int centerL = leftRow[j + y - columnOffset] - meanLBlock;
+					int centerR = rightRow[j + y - d - columnOffset] - meanRBlock;
+
+					// standard deviation
+					stdLBlock += centerL * centerL;
+					stdRBlock += centerR * centerR;
+
+					currentZncc += centerL * centerR;
+				}
+			}
+
+			currentZncc /= sqrt(stdLBlock) * sqrt(stdRBlock);
+
+			// Selecting best disparity
+			if (currentZncc > bestZncc) {
+				bestZncc = currentZncc;
+				bestDisparity = d;
+			}
+		}
+
+		disparityRow[j - columnBegin] = (unsigned)abs(bestDisparity);
+	}
+}
+
+std::vector<unsigned> crossChecking(
+	std::vector<unsigned> leftDisp, 
+	std::vector<unsigned> rightDisp, 
+	const unsigned width, 
+	const unsigned height
+) {
+	ProfileZone zone("cross checking", true);
+	zone.setPixels((unsigned long long)width * height);
+
+	const unsigned imageSize = width * height;
+
+	std::vector<unsigned> result(imageSize);
+
+	// The check is per pixel, so the whole image can be treated as one long row
+	crossCheckingRow(leftDisp.data(), rightDisp.data(), result.data(), imageSize);
+
+	return result;
+}
+
+void crossCheckingRow(
+	const unsigned* leftDisp,
+	const unsigned* rightDisp,
+	unsigned* result,
+	const unsigned width
+) {
+	for (int i = 0; i < width; i++) {
+		if (abs((int)leftDisp[i] - (int)rightDisp[i]) > crossCheckingThreshold) {
+			result[i] = 0;
+		} else {
+			result[i] = leftDisp[i];
+		}
+	}
+}
+
+std::vector<unsigned> occlusionFilling(
+	std::vector<unsigned> map,
+	const unsigned width,
+	const unsigned height
+) {
+	ProfileZone zone("occlusion filling", true);
+	zone.setPixels((unsigned long long)width * height);
+
+	std::vector<unsigned> result(width * height);
+
+	const unsigned* rows[occlusionNeighbours + 1];
+
+	for (int i = 0; i < height; i++) {
+		for (int x = -occlusionNeighbours / 2; x <= occlusionNeighbours / 2; x++) {
+			rows[x + occlusionNeighbours / 2] = i + x >= 0 && i + x < height ? &map[(i + x) * width] : nullptr;
+		}
+
+		occlusionFillingRow(rows, &result[i * width], width, 0, width, 0);
+	}
+
+	return result;
+}
+
+void occlusionFillingRow(
+	const unsigned* const* rows,
+	unsigned* resultRow,
+	const unsigned width,
+	const int columnBegin,
+	const int columnEnd,
+	const int columnOffset
+) {
+	const unsigned* mapRow = rows[occlusionNeighbours / 2];
+
+	for (int j = columnBegin; j < columnEnd; j++) {
+		resultRow[j - columnBegin] = mapRow[j - columnOffset];
+
+		// If the pixel value is 0, copy value from nearest non zero neighbour
+		if (mapRow[j - columnOffset] == 0) {
+			bool stop = false;
+
+			for (int n = 1; n <= occlusionNeighbours / 2 && !stop; n++) {
+				for (int y = -n; y <= n && !stop; y++) {
+					for (int x = -n; x <= n && !stop; x++) {
+						const unsigned* row = rows[x + occlusionNeighbours / 2];
+
+						// Checking for borders
+						if (
+							!row || 
+							!(j + y >= 0) || 
+							!(j + y < width) || 
+							(x == 0 && y == 0)
+						) {
+							continue;
+						}
+
+						if (row[j + y - columnOffset] == 0) {
+							resultRow[j - columnBegin] = row[j + y - columnOffset];
+							stop = true;
+							break;
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+std::vector<unsigned char> normalize(
+	std::vector<unsigned> in, 
+	const unsigned width, 
+	const unsigned height
+) {
+	std::vector<unsigned char> result(width * height * 4);
+
+	unsigned char max = 0;
+	unsigned char min = UCHAR_MAX;
+
+	for (int i = 0; i < width * height; i++) {
+		if (in[i] > max) {
+			max = in[i];
+		}
+
+		if (in[i] < min) {
+			min = in[i];
+		}
+	}
+
+	// Normalize values to be between 0 and 255
+	int mapIndex = 0;
+	for (int i = 0; i < width * height * 4; i+=4, mapIndex++) {
+		result[i] = result[i + 1] = result[i + 2] = (unsigned char)(255 * (in[mapIndex] - min) / (max - min));
+		result[i + 3] = 255;
+	}
+
+	return result;
+}
+
+// Same values as normalize, one gray byte per pixel instead of RGBA
+std::vector<unsigned char> normalizeGray(
+	const std::vector<unsigned>& in,
+	const unsigned width,
+	const unsigned height
+) {
+	const size_t size = (size_t)width * height;
+	std::vector<unsigned char> result(size);
+
+	unsigned char max = 0;
+	unsigned char min = UCHAR_MAX;
+
+	for (size_t i = 0; i < size; i++) {
+		if (in[i] > max) {
+			max = in[i];
+		}
+
+		if (in[i] < min) {
+			min = in[i];
+		}
+	}
+
+	// A constant map has no range to stretch
+	const unsigned range = max > min ? max - min : 1;
+
+	for (size_t i = 0; i < size; i++) {
+		result[i] = (unsigned char)(255 * (in[i] - min) / range);
+	}
+
+	return result;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+
+constexpr int maxDisparity = 64;
+
+constexpr int windowWidth = 9;
+constexpr int windowHeight = 9;
+
+constexpr int crossCheckingThreshold = 2;
+
+constexpr int occlusionNeighbours = 256;
+
+constexpr int scaleFactor = 4;
+
+// Prototypes
+std::vector<unsigned> scaleAndGray(std::vector<unsigned char>, const unsigned, const unsigned);
+std::vector<unsigned> zncc(
+	std::vector<unsigned>, 
+	std::vector<unsigned>, 
+	const unsigned, 
+	const unsigned,
+	const int,
+	const int,
+	const int = windowWidth,
+	const int = windowHeight
+);
+std::vector<unsigned> crossChecking(
+	std::vector<unsigned>,
+	std::vector<unsigned>,
+	const unsigned, 
+	const unsigned
+);
+std::vector<unsigned> occlusionFilling(std::vector<unsigned>, const unsigned, const unsigned);
+std::vector<unsigned char> normalize(std::vector<unsigned>, const unsigned, const unsigned);
+std::vector<unsigned char> normalizeGray(const std::vector<unsigned>&, const unsigned, const unsigned);
+
+/*
+Row level versions of the stages, used by the streaming and tiled pipelines and by the whole image functions above.
+* Neighbouring rows are passed as an array of row pointers centered on the current row,
+  rows outside the image are nullptr.
+* The rows may hold only part of the image width, their first value is image column columnOffset.
+  Only the columns [columnBegin, columnEnd) are computed and written to the output row, starting at its first value.
+*/
+
+// rows holds one pointer per window row, rows[window height / 2] is the current row.
+// The window size is a parameter for the benchmarks, the pipelines use windowWidth x windowHeight.
+void znccRow(
+	const unsigned* const*,
+	const unsigned* const*,
+	unsigned*,
+	const unsigned,
+	const int,
+	const int,
+	const int,
+	const int,
+	const int,
+	const int = windowWidth,
+	const int = windowHeight
+);
+void crossCheckingRow(const unsigned*, const unsigned*, unsigned*, const unsigned);
+// rows holds occlusionNeighbours + 1 pointers, rows[occlusionNeighbours / 2] is the current row
+void occlusionFillingRow(const unsigned* const*, unsigned*, const unsigned, const int, const int, const int);
@@ -0,0 +1,83 @@
+#include "streaming.h"
+
+#include <vector>
+
+#include "stereo.h"
+
+/*
+Fixed number of image rows stored in one buffer, row i lives in slot i % rows.
+*/
+class RowRing {
+private:
+	std::vector<unsigned> m_Data;
+	unsigned m_Width, m_Rows;
+
+public:
+	RowRing(const unsigned width, const unsigned rows) : m_Data(width * rows), m_Width(width), m_Rows(rows) {}
+
+	inline unsigned* row(const unsigned i) { return &m_Data[(i % m_Rows) * m_Width]; }
+};
+
+unsigned streamDisparity(
+	RowSource left,
+	RowSource right,
+	const unsigned width,
+	const unsigned height,
+	RowSink sink
+) {
+	const int fillRadius = occlusionNeighbours / 2;
+
+	RowRing grayL(width, windowHeight), grayR(width, windowHeight);
+	RowRing dispCC(width, occlusionNeighbours + 1);
+	std::vector<unsigned> dispLR(width), dispRL(width), result(width);
+
+	const unsigned* leftRows[windowHeight];
+	const unsigned* rightRows[windowHeight];
+	const unsigned* fillRows[occlusionNeighbours + 1];
+
+	unsigned loaded = 0; // Number of gray rows read from the sources so far
+
+	// Occlusion filling for row k, once the cross checked rows up to k + fillRadius (or the last row) exist
+	auto fill = [&](const int k) {
+		for (int x = -fillRadius; x <= fillRadius; x++) {
+			fillRows[x + fillRadius] = k + x >= 0 && k + x < height ? dispCC.row(k + x) : nullptr;
+		}
+
+		occlusionFillingRow(fillRows, result.data(), width, 0, width, 0);
+		sink(k, result.data());
+	};
+
+	for (int i = 0; i < height; i++) {
+		// The window of row i reaches down to row i + windowHeight / 2 - 1
+		while (loaded < height && (int)loaded <= i + windowHeight / 2 - 1) {
+			unsigned error = left(grayL.row(loaded));
+			if (!error) error = right(grayR.row(loaded));
+			if (error) return error;
+
+			loaded++;
+		}
+
+		for (int x = -windowHeight / 2; x < windowHeight / 2; x++) {
+			bool inside = i + x >= 0 && i + x < height;
+
+			leftRows[x + windowHeight / 2] = inside ? grayL.row(i + x) : nullptr;
+			rightRows[x + windowHeight / 2] = inside ? grayR.row(i + x) : nullptr;
+		}
+
+		znccRow(leftRows, rightRows, dispLR.data(), width, 0, maxDisparity, 0, width, 0);
+		znccRow(rightRows, leftRows, dispRL.data(), width, -maxDisparity, 0, 0, width, 0);
+
+		crossCheckingRow(dispLR.data(), dispRL.data(), dispCC.row(i), width);
+
+		if (i - fillRadius >= 0) {
+			fill(i - fillRadius);
+		}
+	}
+
+	// The last rows have no more rows below them to wait for
+	for (int k = height > fillRadius ? height - fillRadius : 0; k < height; k++) {
+		fill(k);
+	}
+
+	return 0;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <functional>
+
+/*
+Row streaming version of the stereo pipeline, for inputs that don't fit in memory.
+* Gray rows are pulled from the sources as they are needed and kept in ring buffers of windowHeight rows,
+  so decoding, ZNCC, cross checking and occlusion filling run interleaved instead of stage after stage.
+* Each disparity row is handed to the sink as soon as it is final, in order from top to bottom.
+* The cross checked rows wait in a ring of occlusionNeighbours + 1 rows until the occlusion filling
+  neighbourhood below them is known, that ring is the largest buffer.
+* Memory use only depends on the width of the image, the output is identical to the in memory pipeline.
+*/
+
+// Writes the next downscaled gray row into the buffer, returns a lodepng style error code
+typedef std::function<unsigned(unsigned*)> RowSource;
+
+// Receives the final disparity of a row, the row index comes first
+typedef std::function<void(unsigned, const unsigned*)> RowSink;
+
+unsigned streamDisparity(
+	RowSource left,
+	RowSource right,
+	const unsigned width,
+	const unsigned height,
+	RowSink sink
+);
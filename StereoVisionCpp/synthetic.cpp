@@ -0,0 +1,159 @@
+#include "synthetic.h"
+
+#include <algorithm>
+
+// Same linear congruential generator as the synthetic image of the inflate benchmark, 15 random bits per call
+static unsigned nextRandom(unsigned& seed) {
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 16) & 0x7fff;
+}
+
+// Uniform noise smoothed with a 3x3 binomial filter, so the ZNCC windows see texture instead of independent pixels
+static std::vector<int> smoothNoise(const unsigned width, const unsigned height, unsigned& seed) {
+	const size_t size = (size_t)width * height;
+
+	std::vector<int> noise(size), rows(size);
+	for (size_t i = 0; i < size; i++) {
+		noise[i] = nextRandom(seed) & 255;
+	}
+
+	for (unsigned i = 0; i < height; i++) {
+		const int* row = &noise[(size_t)i * width];
+
+		for (unsigned j = 0; j < width; j++) {
+			int left = row[j > 0 ? j - 1 : j];
+			int right = row[j + 1 < width ? j + 1 : j];
+			rows[(size_t)i * width + j] = left + 2 * row[j] + right;
+		}
+	}
+
+	for (unsigned i = 0; i < height; i++) {
+		const int* above = &rows[(size_t)(i > 0 ? i - 1 : i) * width];
+		const int* row = &rows[(size_t)i * width];
+		const int* below = &rows[(size_t)(i + 1 < height ? i + 1 : i) * width];
+
+		for (unsigned j = 0; j < width; j++) {
+			noise[(size_t)i * width + j] = (above[j] + 2 * row[j] + below[j]) / 16;
+		}
+	}
+
+	return noise;
+}
+
+void makeSyntheticPair(
+	SyntheticPair& pair,
+	const unsigned width,
+	const unsigned height,
+	const int maxDisp,
+	const unsigned seed
+) {
+	struct Surface {
+		unsigned left, top, right, bottom;
+		int disparity;
+		int brightness;
+	};
+
+	const size_t size = (size_t)width * height;
+	unsigned random = seed;
+
+	// Roughly one rectangle per 128 x 128 pixels, drawn from the farthest to the nearest
+	const unsigned surfaceCount = std::max(3u, (unsigned)(size / (128 * 128)));
+
+	std::vector<Surface> surfaces(surfaceCount);
+	for (Surface& surface : surfaces) {
+		unsigned surfaceWidth = width / 16 + nextRandom(random) % (width / 4 + 1);
+		unsigned surfaceHeight = height / 16 + nextRandom(random) % (height / 4 + 1);
+
+		surface.left = nextRandom(random) % width;
+		surface.top = nextRandom(random) % height;
+		surface.right = std::min(width, surface.left + surfaceWidth);
+		surface.bottom = std::min(height, surface.top + surfaceHeight);
+		surface.disparity = maxDisp / 2 + (int)(nextRandom(random) % (maxDisp - maxDisp / 2 + 1));
+		surface.brightness = (int)(nextRandom(random) % 129) - 64;
+	}
+
+	std::stable_sort(surfaces.begin(), surfaces.end(), [](const Surface& a, const Surface& b) { return a.disparity < b.disparity; });
+
+	pair.width = width;
+	pair.height = height;
+	pair.disparity.resize(size);
+	pair.left.resize(size);
+	pair.right.resize(size);
+	pair.occluded.assign(size, 0);
+
+	std::vector<int> brightness(size);
+
+	// The background plane comes nearer from the top to the bottom row
+	for (unsigned i = 0; i < height; i++) {
+		for (unsigned j = 0; j < width; j++) {
+			pair.disparity[(size_t)i * width + j] = maxDisp / 4 + (unsigned)(maxDisp / 4 * (size_t)i / height);
+		}
+	}
+
+	for (const Surface& surface : surfaces) {
+		for (unsigned i = surface.top; i < surface.bottom; i++) {
+			for (unsigned j = surface.left; j < surface.right; j++) {
+				pair.disparity[(size_t)i * width + j] = surface.disparity;
+				brightness[(size_t)i * width + j] = surface.brightness;
+			}
+		}
+	}
+
+	std::vector<int> texture = smoothNoise(width, height, random);
+	for (size_t i = 0; i < size; i++) {
+		pair.left[i] = (unsigned)std::min(255, std::max(0, texture[i] + brightness[i]));
+	}
+
+	// Right pixels that nothing maps to, they are visible in the right image only
+	texture = smoothNoise(width, height, random);
+	for (size_t i = 0; i < size; i++) {
+		pair.right[i] = (unsigned)texture[i];
+	}
+
+	// Nearest disparity written to every right pixel so far, -1 for none
+	std::vector<int> depth(width);
+
+	for (unsigned i = 0; i < height; i++) {
+		const size_t rowOffset = (size_t)i * width;
+		std::fill(depth.begin(), depth.end(), -1);
+
+		for (unsigned j = 0; j < width; j++) {
+			int disparity = pair.disparity[rowOffset + j];
+			int target = (int)j - disparity;
+
+			if (target >= 0 && disparity > depth[target]) {
+				depth[target] = disparity;
+				pair.right[rowOffset + target] = pair.left[rowOffset + j];
+			}
+		}
+
+		for (unsigned j = 0; j < width; j++) {
+			int disparity = pair.disparity[rowOffset + j];
+			int target = (int)j - disparity;
+
+			pair.occluded[rowOffset + j] = target < 0 || depth[target] != disparity;
+		}
+	}
+}
+
+std::vector<unsigned char> grayToRgba(
+	const std::vector<unsigned>& gray,
+	const unsigned width,
+	const unsigned height,
+	const int scale
+) {
+	const size_t fullWidth = (size_t)width * scale;
+	std::vector<unsigned char> result(fullWidth * height * scale * 4);
+
+	for (size_t i = 0; i < (size_t)height * scale; i++) {
+		for (size_t j = 0; j < fullWidth; j++) {
+			unsigned char value = (unsigned char)gray[(i / scale) * width + j / scale];
+			unsigned char* pixel = &result[(i * fullWidth + j) * 4];
+
+			pixel[0] = pixel[1] = pixel[2] = value;
+			pixel[3] = 255;
+		}
+	}
+
+	return result;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vector>
+
+/*
+Synthetic rectified stereo pair with known disparity, for benchmarks and accuracy checks at any size.
+* The scene is a slanted background plane with fronto parallel rectangles in front of it,
+  every surface is covered with a smoothed random texture.
+* The left image is rendered first, the right image is the left one with every pixel moved by its disparity
+  (right column = left column - disparity), nearer surfaces hide farther ones.
+  Right image pixels that no left pixel maps to get texture of their own.
+* The result is deterministic for a given seed.
+*/
+struct SyntheticPair {
+	unsigned width, height;
+	std::vector<unsigned> left, right; // Gray values 0-255, like scaleAndGray
+	std::vector<unsigned> disparity; // Ground truth of every left pixel, between 0 and the maximum disparity
+	std::vector<unsigned char> occluded; // 1 where the left pixel is hidden or outside in the right image
+};
+
+void makeSyntheticPair(
+	SyntheticPair& pair,
+	const unsigned width,
+	const unsigned height,
+	const int maxDisp,
+	const unsigned seed = 1
+);
+
+// Scales a gray image up by scale in both directions as RGBA, an input for scaleAndGray of the matching size
+std::vector<unsigned char> grayToRgba(const std::vector<unsigned>&, const unsigned, const unsigned, const int);
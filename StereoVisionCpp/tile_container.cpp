@@ -0,0 +1,277 @@
+#include "tile_container.h"
+
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+#include "fast_inflate.h"
+#include "lodepng.h"
+#include "stereo.h"
+
+static const char containerMagic[8] = { 'Z', 'N', 'C', 'C', 'D', 'T', 'C', '1' };
+
+TileContainerWriter::TileContainerWriter() : m_File(nullptr), m_End(0), m_TilesX(0), m_TilesY(0), m_Compress(true) {
+	memset(&m_Header, 0, sizeof(m_Header));
+}
+
+TileContainerWriter::~TileContainerWriter() {
+	// An unfinished file has no index and is rejected by the reader
+	if (m_File) fclose(m_File);
+}
+
+unsigned TileContainerWriter::create(
+	const char* filename,
+	const unsigned width,
+	const unsigned height,
+	const unsigned tileSize,
+	const unsigned sampleBytes,
+	const bool compress
+) {
+	if (m_File) fclose(m_File);
+
+	m_File = fopen(filename, "wb");
+	if (!m_File) return 79;
+
+	memset(&m_Header, 0, sizeof(m_Header));
+	memcpy(m_Header.magic, containerMagic, sizeof(containerMagic));
+	m_Header.width = width;
+	m_Header.height = height;
+	m_Header.tileSize = tileSize;
+	m_Header.sampleBytes = sampleBytes;
+	m_Header.maxDisparity = maxDisparity;
+	m_Header.windowWidth = windowWidth;
+	m_Header.windowHeight = windowHeight;
+	m_Header.crossCheckingThreshold = crossCheckingThreshold;
+	m_Header.occlusionNeighbours = occlusionNeighbours;
+	m_Header.scaleFactor = scaleFactor;
+	m_Header.minValue = UINT_MAX;
+	m_Header.maxValue = 0;
+
+	m_TilesX = (width + tileSize - 1) / tileSize;
+	m_TilesY = (height + tileSize - 1) / tileSize;
+	m_Index.assign((size_t)m_TilesX * m_TilesY, TileIndexEntry{ 0, 0, 0 });
+	m_Compress = compress;
+
+	// The header is written again with the index offset by finish
+	if (fwrite(&m_Header, sizeof(m_Header), 1, m_File) != 1) return 79;
+	m_End = sizeof(m_Header);
+
+	return 0;
+}
+
+unsigned TileContainerWriter::writeTile(const unsigned tileX, const unsigned tileY, const unsigned* values) {
+	const size_t count = (size_t)tileWidth(tileX) * tileHeight(tileY);
+
+	std::vector<unsigned char> samples(count * m_Header.sampleBytes);
+	unsigned minValue = UINT_MAX, maxValue = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		unsigned value = values[i];
+		if (value < minValue) minValue = value;
+		if (value > maxValue) maxValue = value;
+
+		if (m_Header.sampleBytes == 1) {
+			samples[i] = (unsigned char)value;
+		} else {
+			samples[2 * i] = (unsigned char)value;
+			samples[2 * i + 1] = (unsigned char)(value >> 8);
+		}
+	}
+
+	const unsigned char* data = samples.data();
+	size_t size = samples.size();
+	unsigned compressed = 0;
+
+	unsigned char* deflated = nullptr;
+	size_t deflatedSize = 0;
+
+	if (m_Compress) {
+		LodePNGCompressSettings settings;
+		lodepng_compress_settings_init(&settings);
+
+		if (!lodepng_zlib_compress(&deflated, &deflatedSize, samples.data(), samples.size(), &settings) && deflatedSize < size) {
+			data = deflated;
+			size = deflatedSize;
+			compressed = 1;
+		}
+	}
+
+	unsigned error = 0;
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		if (!m_File || fwrite(data, 1, size, m_File) != size) {
+			error = 79;
+		} else {
+			m_Index[(size_t)tileY * m_TilesX + tileX] = TileIndexEntry{ m_End, (unsigned)size, compressed };
+			m_End += size;
+
+			m_Header.minValue = std::min(m_Header.minValue, minValue);
+			m_Header.maxValue = std::max(m_Header.maxValue, maxValue);
+		}
+	}
+
+	free(deflated);
+
+	return error;
+}
+
+bool TileContainerWriter::hasTile(const unsigned tileX, const unsigned tileY) {
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Index[(size_t)tileY * m_TilesX + tileX].offset != 0;
+}
+
+unsigned TileContainerWriter::finish() {
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	if (!m_File) return 79;
+
+	// The index is read in place from the mapping, so it is aligned
+	static const unsigned char padding[8] = { 0 };
+	size_t paddingSize = (8 - m_End % 8) % 8;
+
+	bool failed = fwrite(padding, 1, paddingSize, m_File) != paddingSize;
+	m_Header.indexOffset = m_End + paddingSize;
+
+	if (m_Header.minValue > m_Header.maxValue) {
+		m_Header.minValue = m_Header.maxValue = 0;
+	}
+
+	failed = failed || fwrite(m_Index.data(), sizeof(TileIndexEntry), m_Index.size(), m_File) != m_Index.size();
+	failed = failed || fseek(m_File, 0, SEEK_SET) != 0;
+	failed = failed || fwrite(&m_Header, sizeof(m_Header), 1, m_File) != 1;
+	failed = fclose(m_File) != 0 || failed;
+
+	m_File = nullptr;
+
+	return failed ? 79 : 0;
+}
+
+unsigned TileContainerReader::open(const char* filename) {
+	m_Header = nullptr;
+	m_Index = nullptr;
+
+	unsigned error = m_File.open(filename);
+	if (error) return error;
+
+	if (m_File.size() < sizeof(TileContainerHeader)) return errorInvalidContainer;
+
+	const TileContainerHeader* header = (const TileContainerHeader*)m_File.data();
+
+	if (memcmp(header->magic, containerMagic, sizeof(containerMagic))) return errorInvalidContainer;
+	if (!header->width || !header->height || !header->tileSize) return errorInvalidContainer;
+	if (header->sampleBytes != 1 && header->sampleBytes != 2) return errorInvalidContainer;
+
+	const unsigned tilesX = (header->width + header->tileSize - 1) / header->tileSize;
+	const unsigned tilesY = (header->height + header->tileSize - 1) / header->tileSize;
+	const unsigned long long indexSize = (unsigned long long)tilesX * tilesY * sizeof(TileIndexEntry);
+
+	// Also rejects files whose writer didn't finish, their index offset is still 0
+	if (header->indexOffset < sizeof(TileContainerHeader) || header->indexOffset % 8) return errorInvalidContainer;
+	if (header->indexOffset > m_File.size() || indexSize > m_File.size() - header->indexOffset) return errorInvalidContainer;
+
+	const TileIndexEntry* index = (const TileIndexEntry*)(m_File.data() + header->indexOffset);
+
+	for (unsigned long long i = 0; i < (unsigned long long)tilesX * tilesY; i++) {
+		if (index[i].offset == 0) continue;
+
+		if (index[i].offset < sizeof(TileContainerHeader) || index[i].offset > header->indexOffset ||
+			index[i].size > header->indexOffset - index[i].offset) {
+			return errorInvalidContainer;
+		}
+	}
+
+	m_Header = header;
+	m_Index = index;
+	m_TilesX = tilesX;
+	m_TilesY = tilesY;
+
+	return 0;
+}
+
+unsigned TileContainerReader::readTile(const unsigned tileX, const unsigned tileY, std::vector<unsigned>& values) const {
+	if (!m_Header || tileX >= m_TilesX || tileY >= m_TilesY) return errorRegionOutside;
+
+	const TileIndexEntry& entry = m_Index[(size_t)tileY * m_TilesX + tileX];
+	if (entry.offset == 0) return errorMissingTile;
+
+	const size_t count = (size_t)tileWidth(tileX) * tileHeight(tileY);
+	const size_t size = count * m_Header->sampleBytes;
+
+	const unsigned char* samples = m_File.data() + entry.offset;
+	unsigned char* inflated = nullptr;
+
+	if (entry.compressed) {
+		size_t inflatedSize = 0;
+
+		unsigned error = fastZlibDecompress(&inflated, &inflatedSize, samples, entry.size, &lodepng_default_decompress_settings);
+		if (!error && inflatedSize != size) error = errorInvalidContainer;
+
+		if (error) {
+			free(inflated);
+			return error;
+		}
+
+		samples = inflated;
+	} else if (entry.size != size) {
+		return errorInvalidContainer;
+	}
+
+	values.resize(count);
+
+	if (m_Header->sampleBytes == 1) {
+		for (size_t i = 0; i < count; i++) {
+			values[i] = samples[i];
+		}
+	} else {
+		for (size_t i = 0; i < count; i++) {
+			values[i] = samples[2 * i] | (samples[2 * i + 1] << 8);
+		}
+	}
+
+	free(inflated);
+
+	return 0;
+}
+
+unsigned TileContainerReader::readRegion(
+	const unsigned x,
+	const unsigned y,
+	const unsigned width,
+	const unsigned height,
+	std::vector<unsigned>& values
+) const {
+	if (!m_Header) return errorRegionOutside;
+	if (x > m_Header->width || width > m_Header->width - x) return errorRegionOutside;
+	if (y > m_Header->height || height > m_Header->height - y) return errorRegionOutside;
+
+	values.resize((size_t)width * height);
+	if (!width || !height) return 0;
+
+	const unsigned tileSize = m_Header->tileSize;
+	std::vector<unsigned> tile;
+
+	// Only the tiles overlapping the region are decoded
+	for (unsigned tileY = y / tileSize; tileY <= (y + height - 1) / tileSize; tileY++) {
+		for (unsigned tileX = x / tileSize; tileX <= (x + width - 1) / tileSize; tileX++) {
+			unsigned error = readTile(tileX, tileY, tile);
+			if (error) return error;
+
+			const unsigned tileLeft = tileX * tileSize;
+			const unsigned tileTop = tileY * tileSize;
+			const unsigned columnBegin = std::max(x, tileLeft);
+			const unsigned columnEnd = std::min(x + width, tileLeft + tileWidth(tileX));
+			const unsigned rowBegin = std::max(y, tileTop);
+			const unsigned rowEnd = std::min(y + height, tileTop + tileHeight(tileY));
+
+			for (unsigned i = rowBegin; i < rowEnd; i++) {
+				const unsigned* source = &tile[(size_t)(i - tileTop) * tileWidth(tileX) + (columnBegin - tileLeft)];
+				unsigned* target = &values[(size_t)(i - y) * width + (columnBegin - x)];
+
+				std::copy(source, source + (columnEnd - columnBegin), target);
+			}
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+#include "mapped_file.h"
+
+/*
+Tiled container for disparity maps (and other maps of the pipeline), so a region of interest can be read
+without decoding the whole map.
+* The file starts with a TileContainerHeader and is followed by the tiles in the order they were written.
+  The index, one TileIndexEntry per tile in row major tile order, is appended (8 byte aligned) when the writer finishes.
+* Tiles are tileSize x tileSize samples, the ones at the right and bottom border are cropped to the map.
+  Samples are 1 or 2 bytes (little endian), stored row by row within the tile.
+* Every tile is zlib compressed on its own, or stored as is when that isn't smaller.
+* Header and index are stored in the byte order of the machine, little endian on all our targets.
+*/
+struct TileContainerHeader {
+	char magic[8];
+	unsigned width, height, tileSize, sampleBytes;
+	int maxDisparity, windowWidth, windowHeight, crossCheckingThreshold, occlusionNeighbours, scaleFactor;
+	unsigned minValue, maxValue;
+	unsigned long long indexOffset; // 0 while the writer isn't finished
+};
+
+struct TileIndexEntry {
+	unsigned long long offset; // 0 for a tile that was never written
+	unsigned size;
+	unsigned compressed;
+};
+
+// Tile size of the containers written by ImageWriter, the tiled pipeline uses its own tile size
+constexpr unsigned containerTileSize = 256;
+
+// Error codes of the container, above the ones of the image readers
+constexpr unsigned errorInvalidContainer = 203;
+constexpr unsigned errorMissingTile = 204;
+constexpr unsigned errorRegionOutside = 205;
+
+/*
+Writes a container, tiles can be written in any order and from several threads at once.
+* A tile is compressed on the calling thread, only appending it to the file is serialized.
+* Returns 79 (lodepng's error for writing files) on write errors.
+*/
+class TileContainerWriter {
+private:
+	FILE* m_File;
+	TileContainerHeader m_Header;
+	std::vector<TileIndexEntry> m_Index;
+	unsigned long long m_End;
+	unsigned m_TilesX, m_TilesY;
+	bool m_Compress;
+
+	std::mutex m_Mutex;
+
+public:
+	TileContainerWriter();
+	~TileContainerWriter();
+
+	TileContainerWriter(const TileContainerWriter&) = delete;
+	TileContainerWriter& operator=(const TileContainerWriter&) = delete;
+
+	// Starts a new file, the parameters of the pipeline are recorded from stereo.h
+	unsigned create(
+		const char* filename,
+		const unsigned width,
+		const unsigned height,
+		const unsigned tileSize,
+		const unsigned sampleBytes,
+		const bool compress = true
+	);
+
+	// values holds the tileWidth(tileX) * tileHeight(tileY) samples of the tile, row by row. Writing a tile again replaces it.
+	unsigned writeTile(const unsigned tileX, const unsigned tileY, const unsigned* values);
+
+	bool hasTile(const unsigned tileX, const unsigned tileY);
+
+	// Appends the index and completes the header, the file is closed afterwards
+	unsigned finish();
+
+	inline unsigned tilesX() const { return m_TilesX; }
+	inline unsigned tilesY() const { return m_TilesY; }
+	inline unsigned tileWidth(const unsigned tileX) const { return std::min(m_Header.tileSize, m_Header.width - tileX * m_Header.tileSize); }
+	inline unsigned tileHeight(const unsigned tileY) const { return std::min(m_Header.tileSize, m_Header.height - tileY * m_Header.tileSize); }
+};
+
+/*
+Reads a finished container through a memory mapping, only the tiles that are asked for are decoded.
+* Returns errorInvalidContainer for files that aren't complete containers, errorMissingTile for tiles that were never written.
+*/
+class TileContainerReader {
+private:
+	MappedFile m_File;
+	const TileContainerHeader* m_Header;
+	const TileIndexEntry* m_Index;
+	unsigned m_TilesX, m_TilesY;
+
+public:
+	TileContainerReader() : m_Header(nullptr), m_Index(nullptr), m_TilesX(0), m_TilesY(0) {}
+
+	unsigned open(const char* filename);
+
+	// Decodes one tile into values, tileWidth(tileX) * tileHeight(tileY) samples row by row
+	unsigned readTile(const unsigned tileX, const unsigned tileY, std::vector<unsigned>& values) const;
+
+	// Decodes the region [x, x + width) x [y, y + height), which must lie inside the map, into values row by row
+	unsigned readRegion(
+		const unsigned x,
+		const unsigned y,
+		const unsigned width,
+		const unsigned height,
+		std::vector<unsigned>& values
+	) const;
+
+	inline const TileContainerHeader& header() const { return *m_Header; }
+	inline unsigned tilesX() const { return m_TilesX; }
+	inline unsigned tilesY() const { return m_TilesY; }
+	inline unsigned tileWidth(const unsigned tileX) const { return std::min(m_Header->tileSize, m_Header->width - tileX * m_Header->tileSize); }
+	inline unsigned tileHeight(const unsigned tileY) const { return std::min(m_Header->tileSize, m_Header->height - tileY * m_Header->tileSize); }
+};
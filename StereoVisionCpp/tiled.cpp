@@ -0,0 +1,386 @@
+#include "tiled.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mapped_file.h"
+#include "profiler.h"
+#include "stereo.h"
+#include "tile_container.h"
+
+static_assert(maxDisparity <= 255, "disparities are stored in 8 bit scratch and output files");
+
+/*
+Layout of the checkpoint file, followed by one byte per tile for each pass (1 once the tile is written).
+* The parameters are stored so a checkpoint of a different job is never resumed.
+*/
+struct CheckpointHeader {
+	char magic[8];
+	unsigned width, height, tileSize;
+	int maxDisparity, windowWidth, windowHeight, occlusionNeighbours, scaleFactor;
+	unsigned grayReady;
+};
+
+static const char checkpointMagic[8] = { 'Z', 'N', 'C', 'C', 'T', 'I', 'L', '1' };
+
+/*
+Region of the image covered by a tile, the halo is added when its input is loaded.
+*/
+struct Tile {
+	int rowBegin, rowEnd;
+	int columnBegin, columnEnd;
+};
+
+/*
+Copies rows [rowBegin, rowEnd) and columns [columnBegin, columnEnd) of an 8 bit mapped image, clipped to the image.
+* rows receives a pointer for every row of the range, nullptr for rows outside the image.
+* Returns the first column that was loaded, which is the columnOffset for the row functions.
+*/
+static int loadRegion(
+	const unsigned char* image,
+	const int width,
+	const int height,
+	int rowBegin,
+	int rowEnd,
+	int columnBegin,
+	int columnEnd,
+	std::vector<unsigned>& buffer,
+	const unsigned** rows
+) {
+	const int firstRow = rowBegin;
+
+	columnBegin = std::max(columnBegin, 0);
+	columnEnd = std::min(columnEnd, width);
+
+	const int regionWidth = columnEnd - columnBegin;
+
+	buffer.resize((size_t)(rowEnd - rowBegin) * regionWidth);
+
+	for (int i = rowBegin; i < rowEnd; i++) {
+		if (i < 0 || i >= height) {
+			rows[i - firstRow] = nullptr;
+			continue;
+		}
+
+		unsigned* row = &buffer[(size_t)(i - firstRow) * regionWidth];
+		const unsigned char* source = image + (size_t)i * width + columnBegin;
+
+		for (int j = 0; j < regionWidth; j++) {
+			row[j] = source[j];
+		}
+
+		rows[i - firstRow] = row;
+	}
+
+	return columnBegin;
+}
+
+static void storeRow(unsigned char* image, const int width, const int row, const Tile& tile, const unsigned* values) {
+	unsigned char* target = image + (size_t)row * width + tile.columnBegin;
+
+	for (int j = 0; j < tile.columnEnd - tile.columnBegin; j++) {
+		target[j] = (unsigned char)values[j];
+	}
+}
+
+// Both disparity maps and the cross check of one tile
+static void matchTile(const MappedFile& grayL, const MappedFile& grayR, MappedFile& dispCC, const int width, const int height, const Tile& tile) {
+	const int halo = windowWidth / 2 + maxDisparity;
+	const int tileWidth = tile.columnEnd - tile.columnBegin;
+	const int firstRow = tile.rowBegin - windowHeight / 2;
+	const int lastRow = tile.rowEnd + windowHeight / 2 - 1;
+
+	std::vector<unsigned> bufferL, bufferR;
+	std::vector<const unsigned*> rowsL(lastRow - firstRow), rowsR(lastRow - firstRow);
+
+	int columnOffset = loadRegion(grayL.data(), width, height, firstRow, lastRow,
+		tile.columnBegin - halo, tile.columnEnd + halo, bufferL, rowsL.data());
+	loadRegion(grayR.data(), width, height, firstRow, lastRow,
+		tile.columnBegin - halo, tile.columnEnd + halo, bufferR, rowsR.data());
+
+	std::vector<unsigned> dispLR(tileWidth), dispRL(tileWidth), result(tileWidth);
+
+	for (int i = tile.rowBegin; i < tile.rowEnd; i++) {
+		// rows[windowHeight / 2] has to be row i
+		const unsigned* const* leftRows = &rowsL[i - windowHeight / 2 - firstRow];
+		const unsigned* const* rightRows = &rowsR[i - windowHeight / 2 - firstRow];
+
+		znccRow(leftRows, rightRows, dispLR.data(), width, 0, maxDisparity, tile.columnBegin, tile.columnEnd, columnOffset);
+		znccRow(rightRows, leftRows, dispRL.data(), width, -maxDisparity, 0, tile.columnBegin, tile.columnEnd, columnOffset);
+
+		crossCheckingRow(dispLR.data(), dispRL.data(), result.data(), tileWidth);
+
+		storeRow(dispCC.data(), width, i, tile, result.data());
+	}
+}
+
+// Occlusion filling of one tile
+static void fillTile(const MappedFile& dispCC, unsigned char* output, const int width, const int height, const Tile& tile) {
+	const int radius = occlusionNeighbours / 2;
+	const int tileWidth = tile.columnEnd - tile.columnBegin;
+	const int firstRow = tile.rowBegin - radius;
+	const int lastRow = tile.rowEnd + radius;
+
+	std::vector<unsigned> buffer;
+	std::vector<const unsigned*> rows(lastRow - firstRow);
+
+	int columnOffset = loadRegion(dispCC.data(), width, height, firstRow, lastRow,
+		tile.columnBegin - radius, tile.columnEnd + radius, buffer, rows.data());
+
+	std::vector<unsigned> result(tileWidth);
+
+	for (int i = tile.rowBegin; i < tile.rowEnd; i++) {
+		occlusionFillingRow(&rows[i - radius - firstRow], result.data(), width, tile.columnBegin, tile.columnEnd, columnOffset);
+
+		storeRow(output, width, i, tile, result.data());
+	}
+}
+
+// Appends a tile of the 8 bit output to the container
+static unsigned storeTile(TileContainerWriter& container, const unsigned char* image, const int width, const Tile& tile) {
+	std::vector<unsigned> values;
+	values.reserve((size_t)(tile.rowEnd - tile.rowBegin) * (tile.columnEnd - tile.columnBegin));
+
+	for (int i = tile.rowBegin; i < tile.rowEnd; i++) {
+		const unsigned char* row = image + (size_t)i * width;
+		values.insert(values.end(), row + tile.columnBegin, row + tile.columnEnd);
+	}
+
+	return container.writeTile(tile.columnBegin / tileSize, tile.rowBegin / tileSize, values.data());
+}
+
+// Converts an input image to the 8 bit gray scratch file, row by row
+static unsigned convertToGray(GrayReader& reader, MappedFile& gray) {
+	std::vector<unsigned> row(reader.width());
+
+	for (unsigned i = 0; i < reader.height(); i++) {
+		unsigned error = reader.nextRow(row.data());
+		if (error) return error;
+
+		unsigned char* target = gray.data() + (size_t)i * reader.width();
+		for (unsigned j = 0; j < reader.width(); j++) {
+			target[j] = (unsigned char)row[j];
+		}
+	}
+
+	gray.flush(0, gray.size());
+
+	return 0;
+}
+
+/*
+Processes every tile that isn't marked as done yet on threadCount threads, all cores for 0.
+* A tile is marked in the checkpoint only after its output rows were flushed to the file.
+*/
+template<typename Process>
+static void runTiles(
+	const int width,
+	const int height,
+	MappedFile& target,
+	const size_t targetOffset,
+	MappedFile& checkpoint,
+	const size_t doneOffset,
+	const unsigned threadCount,
+	Process process
+) {
+	const int tilesX = (width + tileSize - 1) / tileSize;
+	const int tilesY = (height + tileSize - 1) / tileSize;
+	const int tileCount = tilesX * tilesY;
+
+	std::atomic<int> nextTile(0);
+
+	auto worker = [&]() {
+		for (int t = nextTile++; t < tileCount; t = nextTile++) {
+			unsigned char* done = checkpoint.data() + doneOffset + t;
+			if (*done) continue;
+
+			Tile tile;
+			tile.rowBegin = (t / tilesX) * tileSize;
+			tile.rowEnd = std::min<int>(tile.rowBegin + tileSize, height);
+			tile.columnBegin = (t % tilesX) * tileSize;
+			tile.columnEnd = std::min<int>(tile.columnBegin + tileSize, width);
+
+			process(tile);
+
+			size_t first = targetOffset + (size_t)tile.rowBegin * width + tile.columnBegin;
+			size_t last = targetOffset + (size_t)(tile.rowEnd - 1) * width + tile.columnEnd;
+			target.flush(first, last - first);
+
+			*done = 1;
+			checkpoint.flush(doneOffset + t, 1);
+		}
+	};
+
+	const unsigned workerCount = threadCount ? threadCount : std::max(1u, std::thread::hardware_concurrency());
+
+	std::vector<std::thread> threads;
+	for (unsigned i = 1; i < workerCount; i++) {
+		threads.emplace_back([&]() {
+			Profiler::instance().setThreadName("tile worker");
+			worker();
+		});
+	}
+	worker();
+
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+}
+
+unsigned tiledDisparity(
+	GrayReader& left,
+	GrayReader& right,
+	const char* outputFile,
+	const char* containerFile,
+	const unsigned threadCount
+) {
+	// left and right images are assumed to be of same dimensions
+	assert(left.fullWidth() == right.fullWidth() && left.fullHeight() == right.fullHeight());
+
+	const int width = left.width();
+	const int height = left.height();
+	const size_t imageSize = (size_t)width * height;
+
+	const int tileCount = ((width + tileSize - 1) / tileSize) * ((height + tileSize - 1) / tileSize);
+
+	const std::string output(outputFile);
+	const std::string checkpointFile = output + ".checkpoint";
+	const std::string grayLFile = output + ".grayL";
+	const std::string grayRFile = output + ".grayR";
+	const std::string dispCCFile = output + ".dispCC";
+
+	// Checkpoint, a new (zero filled) or foreign file is reset
+	CheckpointHeader expected;
+	memset(&expected, 0, sizeof(expected));
+	memcpy(expected.magic, checkpointMagic, sizeof(checkpointMagic));
+	expected.width = width;
+	expected.height = height;
+	expected.tileSize = tileSize;
+	expected.maxDisparity = maxDisparity;
+	expected.windowWidth = windowWidth;
+	expected.windowHeight = windowHeight;
+	expected.occlusionNeighbours = occlusionNeighbours;
+	expected.scaleFactor = scaleFactor;
+
+	MappedFile checkpoint;
+	unsigned error = checkpoint.create(checkpointFile.c_str(), sizeof(CheckpointHeader) + 2 * tileCount);
+	if (error) return error;
+
+	CheckpointHeader* header = (CheckpointHeader*)checkpoint.data();
+	unsigned char* matched = checkpoint.data() + sizeof(CheckpointHeader);
+	unsigned char* filled = matched + tileCount;
+
+	expected.grayReady = header->grayReady;
+	if (memcmp(header, &expected, sizeof(expected))) {
+		memset(checkpoint.data(), 0, checkpoint.size());
+		expected.grayReady = 0;
+		memcpy(header, &expected, sizeof(expected));
+		checkpoint.flush(0, checkpoint.size());
+	}
+
+	int matchedCount = (int)std::count(matched, matched + tileCount, 1);
+	int filledCount = (int)std::count(filled, filled + tileCount, 1);
+
+	if (matchedCount || filledCount) {
+		std::cout << "Resuming from checkpoint (" << matchedCount + filledCount << " of " << 2 * tileCount << " tiles done)...";
+	}
+
+	MappedFile dispCC;
+	error = dispCC.create(dispCCFile.c_str(), imageSize);
+	if (error) return error;
+
+	// First pass, only needs the gray images while some of its tiles are missing
+	if (matchedCount < tileCount) {
+		MappedFile grayL, grayR;
+
+		error = grayL.create(grayLFile.c_str(), imageSize);
+		if (!error) error = grayR.create(grayRFile.c_str(), imageSize);
+		if (error) return error;
+
+		if (!header->grayReady) {
+			error = convertToGray(left, grayL);
+			if (!error) error = convertToGray(right, grayR);
+			if (error) return error;
+
+			header->grayReady = 1;
+			checkpoint.flush(0, sizeof(CheckpointHeader));
+		}
+
+		runTiles(width, height, dispCC, 0, checkpoint, sizeof(CheckpointHeader), threadCount, [&](const Tile& tile) {
+			ProfileZone zone("match tile");
+			zone.setPixels((unsigned long long)(tile.rowEnd - tile.rowBegin) * (tile.columnEnd - tile.columnBegin));
+			matchTile(grayL, grayR, dispCC, width, height, tile);
+		});
+	}
+
+	// Second pass, the output is a PGM file whose pixels are written in place
+	char pgmHeader[64];
+	size_t pgmHeaderSize = snprintf(pgmHeader, sizeof(pgmHeader), "P5\n%d %d\n255\n", width, height);
+
+	MappedFile result;
+	error = result.create(outputFile, pgmHeaderSize + imageSize);
+	if (error) return error;
+
+	memcpy(result.data(), pgmHeader, pgmHeaderSize);
+
+	TileContainerWriter container;
+	if (containerFile) {
+		error = container.create(containerFile, width, height, tileSize, 1);
+		if (error) return error;
+	}
+
+	std::atomic<unsigned> containerError(0);
+
+	runTiles(width, height, result, pgmHeaderSize, checkpoint, sizeof(CheckpointHeader) + tileCount, threadCount, [&](const Tile& tile) {
+		ProfileZone zone("fill tile");
+		zone.setPixels((unsigned long long)(tile.rowEnd - tile.rowBegin) * (tile.columnEnd - tile.columnBegin));
+		fillTile(dispCC, result.data() + pgmHeaderSize, width, height, tile);
+
+		if (containerFile) {
+			unsigned tileError = storeTile(container, result.data() + pgmHeaderSize, width, tile);
+			if (tileError) containerError = tileError;
+		}
+	});
+
+	result.flush(0, result.size());
+
+	// Tiles that were done before a restart are taken from the output
+	if (containerFile) {
+		error = containerError;
+
+		for (unsigned tileY = 0; !error && tileY < container.tilesY(); tileY++) {
+			for (unsigned tileX = 0; !error && tileX < container.tilesX(); tileX++) {
+				if (container.hasTile(tileX, tileY)) continue;
+
+				Tile tile;
+				tile.rowBegin = tileY * tileSize;
+				tile.rowEnd = tile.rowBegin + container.tileHeight(tileY);
+				tile.columnBegin = tileX * tileSize;
+				tile.columnEnd = tile.columnBegin + container.tileWidth(tileX);
+
+				error = storeTile(container, result.data() + pgmHeaderSize, width, tile);
+			}
+		}
+
+		if (!error) error = container.finish();
+		if (error) return error;
+	}
+
+	// Done, the scratch files and the checkpoint aren't needed anymore
+	dispCC.close();
+	checkpoint.close();
+
+	remove(grayLFile.c_str());
+	remove(grayRFile.c_str());
+	remove(dispCCFile.c_str());
+	remove(checkpointFile.c_str());
+
+	return 0;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "gray_reader.h"
+
+/*
+Tiled out of core version of the stereo pipeline, for image pairs much larger than the memory.
+* The inputs are first decoded to 8 bit gray scratch files, all large data lives in memory mapped files
+  next to the output, so the OS pages it in and out as needed.
+* The first pass computes both disparity maps and the cross check tile by tile, every tile loads its rows
+  of the gray images plus a halo of the ZNCC window and the disparity range.
+  The second pass does the occlusion filling tile by tile, with a halo of occlusionNeighbours / 2.
+* Tiles are independent and are processed on threadCount threads (all cores for 0), each one only holds its own buffers,
+  so the working set is fixed by tileSize and not by the image size.
+* The output is a binary PGM with the raw disparities (maximum value 255, like ImageFormat::Pgm), written in place through the mapping.
+* Finished tiles are recorded in outputFile.checkpoint, an interrupted job started again with the same
+  inputs and parameters continues where it stopped. The scratch files and the checkpoint are removed at the end.
+* With a containerFile the result is also written as tile container (see tile_container.h) with the same tiles,
+  each one appended as soon as a worker has filled it.
+* left and right are freshly opened readers, they are only read when the gray scratch files don't exist yet.
+* Returns an error code of the readers (see imageErrorText), 0 on success.
+*/
+
+constexpr unsigned tileSize = 256;
+
+unsigned tiledDisparity(
+	GrayReader& left,
+	GrayReader& right,
+	const char* outputFile,
+	const char* containerFile = nullptr,
+	const unsigned threadCount = 0
+);
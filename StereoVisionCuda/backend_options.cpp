@@ -0,0 +1,69 @@
+#include "backend_options.h"
+
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+bool parseBackendOptions(int argc, char** argv, BackendOptions& options) {
+	bool valid = true;
+
+	for (int i = 1; i < argc && valid; i++) {
+		if (i + 1 >= argc) {
+			valid = false;
+		} else if (!strcmp(argv[i], "--left")) {
+			options.leftFile = argv[++i];
+		} else if (!strcmp(argv[i], "--right")) {
+			options.rightFile = argv[++i];
+		} else if (!strcmp(argv[i], "--window")) {
+			options.windowWidth = options.windowHeight = atoi(argv[++i]);
+			valid = options.windowWidth > 0;
+		} else if (!strcmp(argv[i], "--max-disparity")) {
+			options.maxDisparity = atoi(argv[++i]);
+			valid = options.maxDisparity > 0;
+		} else if (!strcmp(argv[i], "--output")) {
+			options.outputFile = argv[++i];
+		} else if (!strcmp(argv[i], "--profile")) {
+			options.profileFile = argv[++i];
+		} else {
+			valid = false;
+		}
+	}
+
+	if (!valid) {
+		std::cout << "Usage: " << argv[0] << " [--left file] [--right file] [--window n] [--max-disparity n]"
+			<< " [--output file.pgm] [--profile trace.json]" << std::endl;
+	}
+
+	return valid;
+}
+
+unsigned writeDisparityPgm(const char* filename, const std::vector<unsigned>& map, const unsigned width, const unsigned height) {
+	const size_t size = (size_t)width * height;
+
+	bool wide = false;
+	for (size_t i = 0; i < size; i++) {
+		if (map[i] > 255) wide = true;
+	}
+
+	FILE* file = fopen(filename, "wb");
+	if (!file) return 79;
+
+	fprintf(file, "P5\n%u %u\n%u\n", width, height, wide ? 65535 : 255);
+
+	std::vector<unsigned char> samples(wide ? 2 * size : size);
+	for (size_t i = 0; i < size; i++) {
+		if (wide) {
+			unsigned value = map[i] > 65535 ? 65535 : map[i];
+			samples[2 * i] = (unsigned char)(value >> 8);
+			samples[2 * i + 1] = (unsigned char)value;
+		} else {
+			samples[i] = (unsigned char)map[i];
+		}
+	}
+
+	bool failed = fwrite(samples.data(), 1, samples.size(), file) != samples.size();
+	failed = fclose(file) != 0 || failed;
+
+	return failed ? 79 : 0;
+}
@@ -6,7 +6,9 @@
 #include <cassert>
 #include <vector>
 
+#include "backend_options.h"
 #include "lodepng.h"
+#include "profiler.h"
 
 cudaError_t status;
 #define CudaCall(x) \
@@ -23,11 +25,12 @@ void ScaleAndGray(unsigned char* orig, unsigned* gray, unsigned width, unsigned
 	int i = blockIdx.x * blockDim.x + threadIdx.x;
 	int j = blockIdx.y * blockDim.y + threadIdx.y;
 
-	if (i >= height || j >= width)
-		return;
-
 	int newWidth = width / scaleFactor;
 
+	// i and j are pixels of the downscaled image
+	if (i >= height / scaleFactor || j >= newWidth)
+		return;
+
 	int x = (scaleFactor * i - 1 * (i > 0));
 	int y = (scaleFactor * j - 1 * (j > 0));
 
@@ -127,20 +130,12 @@ void CrossCheck(unsigned* leftDisp, unsigned* rightDisp, unsigned* result, unsig
 	if (i >= imSize)
 		return;
 
+	// The left to right disparity where both maps agree, like the CPU crossChecking
 	int diff = leftDisp[i] - rightDisp[i];
-	if (diff >= 0) { // leftDisp is winner
-		if (diff <= crossCheckingThreshold) {
-			result[i] = leftDisp[i];
-		} else {
-			result[i] = 0;
-		}
-	} else { //  rightDisp is winner
-		if (-diff <= crossCheckingThreshold) {
-			result[i] = rightDisp[i];
-		} else {
-			result[i] = 0;
-		}
-
+	if (abs(diff) <= crossCheckingThreshold) {
+		result[i] = leftDisp[i];
+	} else {
+		result[i] = 0;
 	}
 }
 
@@ -189,37 +184,6 @@ void OcclusionFill(unsigned* map, unsigned* result, unsigned width, unsigned hei
 #pragma endregion gpuCode
 
 
-/*
-Class to calculate time taken by functions in seconds.
-* Creating an object of the class in a function, calls the constructor which starts the timer.
-* At the end of the function, the destructor is called which stops the timer and calculates the duration.
-* We can get the duration manually using the getElapsedTime method.
-*/
-class Timer {
-private:
-	std::chrono::time_point<std::chrono::steady_clock> m_Start, m_End;
-	std::chrono::duration<float> m_Duration;
-
-public:
-	Timer() {
-		m_Start = std::chrono::high_resolution_clock::now();
-	}
-
-	~Timer() {
-		m_End = std::chrono::high_resolution_clock::now();
-		m_Duration = m_End - m_Start;
-
-		std::cout << "Done (" << m_Duration.count() << " s)" << std::endl;
-	}
-
-	float getElapsedTime() {
-		m_End = std::chrono::high_resolution_clock::now();
-		m_Duration = m_End - m_Start;
-
-		return m_Duration.count();
-	}
-};
-
 constexpr int maxDisparity = 64;
 
 constexpr int windowWidth = 15;
@@ -264,8 +228,23 @@ void DisplayHeader() {
 	}
 }
 
-int main() {
-	Timer timer;
+int main(int argc, char** argv) {
+	// The options shared by all backends, see backend_options.h
+	BackendOptions options(windowWidth, windowHeight, maxDisparity);
+	if (!parseBackendOptions(argc, argv, options)) {
+		return -1;
+	}
+
+	ProfileOutput profileOutput(options.profileFile);
+	Profiler::instance().setThreadName("main");
+
+	ProfileZone programZone("program");
+
+	int deviceCount = 0;
+	if (cudaGetDeviceCount(&deviceCount) != cudaSuccess || deviceCount == 0) {
+		std::cout << "No CUDA device found" << std::endl;
+		return exitNoDevice;
+	}
 
 	DisplayHeader();
 
@@ -274,10 +253,10 @@ int main() {
 	unsigned width, height, rightWidth, rightHeight;
 
 	std::cout << "Reading Left Image...";
-	leftPixels = loadImage("imageL.png", width, height);
+	leftPixels = loadImage(options.leftFile, width, height);
 
 	std::cout << "Reading Right Image...";
-	rightPixels = loadImage("imageR.png", rightWidth, rightHeight);
+	rightPixels = loadImage(options.rightFile, rightWidth, rightHeight);
 
 	// left and right images are assumed to be of same dimensions
 	assert(width == rightWidth && height == rightHeight);
@@ -313,10 +292,10 @@ int main() {
 	CudaCall(cudaEventCreate(&start));
 	CudaCall(cudaEventCreate(&stop));
 
-	// Kernel Calls
-	dim3 blocks(height / 21, width / 21);
+	// Kernel Calls, the grids are rounded up to cover images whose size isn't a multiple of the block size
+	dim3 blocks((height + 20) / 21, (width + 20) / 21);
 	dim3 threads(21, 21);
-	dim3 blocks1D((height / 21) * (width / 21));
+	dim3 blocks1D((imSize + 21 * 21 - 1) / (21 * 21));
 	dim3 threads1D(21 * 21);
 
 	// Scale and Gray left
@@ -351,7 +330,7 @@ int main() {
 	std::cout << "Converting Left Disparity Map...";
 	CudaCall(cudaEventRecord(start));
 
-	Zncc<<<blocks, threads>>>(d_grayL, d_grayR, d_dispLR, width, height, 0, maxDisparity, windowWidth, windowHeight);
+	Zncc<<<blocks, threads>>>(d_grayL, d_grayR, d_dispLR, width, height, 0, options.maxDisparity, options.windowWidth, options.windowHeight);
 
 	CudaCall(cudaEventRecord(stop));
 	CudaCall(cudaEventSynchronize(stop));
@@ -365,7 +344,7 @@ int main() {
 	std::cout << "Converting Right Disparity Map...";
 	CudaCall(cudaEventRecord(start));
 
-	Zncc<<<blocks, threads>>>(d_grayR, d_grayL, d_dispRL, width, height, -maxDisparity, 0, windowWidth, windowHeight);
+	Zncc<<<blocks, threads>>>(d_grayR, d_grayL, d_dispRL, width, height, -options.maxDisparity, 0, options.windowWidth, options.windowHeight);
 
 	CudaCall(cudaEventRecord(stop));
 	CudaCall(cudaEventSynchronize(stop));
@@ -408,7 +387,13 @@ int main() {
 
 	lodepng::encode("output.png", normalize(output, width, height), width, height);
 
-	std::cout << "The program took " << timer.getElapsedTime() << " s" << std::endl;
+	// A failed write ends the program with -1 like the other backends, once the device buffers are freed
+	const bool writeFailed = options.outputFile && writeDisparityPgm(options.outputFile, output, width, height);
+	if (writeFailed) {
+		std::cout << "Failed to write " << options.outputFile << std::endl;
+	}
+
+	std::cout << "The program took " << programZone.getElapsedTime() << " s" << std::endl;
 
 	cudaFree(d_origL);
 	cudaFree(d_origR);
@@ -419,12 +404,16 @@ int main() {
 	cudaFree(d_dispCC);
 	cudaFree(d_output);
 
+	if (writeFailed) {
+		return -1;
+	}
+
 	std::cin.get();
 	return 0;
 }
 
 std::vector<unsigned char> loadImage(const char* filename, unsigned& width, unsigned& height) {
-	Timer timer;
+	ProfileZone zone("load image", true);
 
 	std::vector<unsigned char> pixels;
 
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*
+Hierarchical profiler for named scopes, see ProfileZone.
+* Every thread records into its own buffer, which is registered once on the first zone of the thread,
+  so recording a zone takes no lock and costs two clock reads and a vector append.
+* Zones nest, the parent of a zone is the innermost zone that was open on the same thread when it started.
+* The buffers outlive their threads, report and writeChromeTrace can be called once the threads of interest are joined.
+*/
+class Profiler {
+public:
+	struct Zone {
+		const char* name;
+		long long begin, end; // Nanoseconds since the profiler was created, end is -1 while the zone is open
+		int parent; // Index of the enclosing zone in the same buffer, -1 at the top level
+	};
+
+	struct ThreadBuffer {
+		unsigned id;
+		std::string name;
+		std::vector<Zone> zones;
+		int open = -1; // Innermost open zone, -1 if there is none
+
+		ThreadBuffer(const unsigned bufferId, const std::string& bufferName) : id(bufferId), name(bufferName) {}
+	};
+
+private:
+	std::chrono::steady_clock::time_point m_Start;
+	std::vector<std::unique_ptr<ThreadBuffer>> m_Buffers;
+	std::mutex m_Mutex;
+
+	Profiler();
+
+public:
+	static Profiler& instance();
+
+	// Buffer of the calling thread, created on first use
+	ThreadBuffer& threadBuffer();
+
+	inline long long now() const {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_Start).count();
+	}
+
+	// Name shown for the calling thread in the trace, threads are "thread N" until they set one
+	void setThreadName(const std::string& name);
+
+	/*
+	Prints one line per zone path (zones with the same name under the same parents), indented by nesting depth:
+	number of calls, total, minimum, median, 99th percentile and maximum duration.
+	Calls of the same zone on several threads or in several frames are aggregated together.
+	*/
+	void report(std::ostream& out);
+
+	// Writes all zones as Chrome trace event JSON, for chrome://tracing or ui.perfetto.dev, returns false on errors
+	bool writeChromeTrace(const char* filename);
+};
+
+/*
+Records the time from its construction to its destruction as a zone of the calling thread.
+* name must be a string that outlives the profiler, a string literal in practice.
+* With print the duration is written to stdout as "Done (x s)" at the end, like the progress output of the pipeline.
+*/
+class ProfileZone {
+private:
+	Profiler::ThreadBuffer& m_Buffer;
+	int m_Index;
+	bool m_Print;
+
+public:
+	ProfileZone(const char* name, const bool print = false);
+	~ProfileZone();
+
+	ProfileZone(const ProfileZone&) = delete;
+	ProfileZone& operator=(const ProfileZone&) = delete;
+
+	// Seconds since the zone started
+	float getElapsedTime() const;
+};
+
+/*
+Prints the report and writes the Chrome trace to file when it goes out of scope, does nothing without a file.
+* Meant to be created first thing in main, so it outlives the zones and the threads of the pipeline.
+*/
+class ProfileOutput {
+private:
+	const char* m_File;
+
+public:
+	ProfileOutput(const char* file) : m_File(file) {}
+	~ProfileOutput();
+
+	ProfileOutput(const ProfileOutput&) = delete;
+	ProfileOutput& operator=(const ProfileOutput&) = delete;
+};
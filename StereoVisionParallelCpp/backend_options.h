@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vector>
+
+/*
+Command line options every backend takes, so StereoVisionCompare can run all of them on the same inputs and parameters.
+* --left and --right replace imageL.png and imageR.png.
+* --window n sets a square ZNCC window and --max-disparity n the largest disparity searched,
+  the backend keeps its own defaults for the ones that aren't given.
+* --output file writes the final disparity map as binary PGM with the raw disparities, like StereoVisionCpp does.
+* --profile file prints the profiler report at the end and writes the zones as Chrome trace to the file.
+*/
+struct BackendOptions {
+	const char* leftFile = "imageL.png";
+	const char* rightFile = "imageR.png";
+	int windowWidth, windowHeight;
+	int maxDisparity;
+	const char* outputFile = nullptr;
+	const char* profileFile = nullptr;
+
+	BackendOptions(const int windowWidth, const int windowHeight, const int maxDisparity) :
+		windowWidth(windowWidth), windowHeight(windowHeight), maxDisparity(maxDisparity) {}
+};
+
+// Exit code of a backend that found no device to run on, the harness reports it as unavailable instead of failed
+constexpr int exitNoDevice = 2;
+
+// Prints the usage and returns false on unknown or invalid options
+bool parseBackendOptions(int argc, char** argv, BackendOptions& options);
+
+// 8 bit PGM if all values fit in a byte, 16 bit (big endian) otherwise. Returns lodepng's error for writing files (79) on failure.
+unsigned writeDisparityPgm(const char* filename, const std::vector<unsigned>& map, const unsigned width, const unsigned height);
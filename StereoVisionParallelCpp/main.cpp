@@ -3,38 +3,9 @@
 #include <chrono>
 #include <omp.h>
 
+#include "backend_options.h"
 #include "lodepng.h"
-
-/*
-Class to calculate time taken by functions in seconds.
-* Creating an object of the class in a function, calls the constructor which starts the timer.
-* At the end of the function, the destructor is called which stops the timer and calculates the duration.
-* We can get the duration manually using the getElapsedTime method.
-*/
-class Timer {
-private:
-	std::chrono::time_point<std::chrono::steady_clock> start, end;
-	std::chrono::duration<float> duration;
-
-public:
-	Timer() {
-		start = std::chrono::high_resolution_clock::now();
-	}
-
-	~Timer() {
-		end = std::chrono::high_resolution_clock::now();
-		duration = end - start;
-
-		std::cout << "Done (" << duration.count() << " s)" << std::endl;
-	}
-
-	float getElapsedTime() {
-		end = std::chrono::high_resolution_clock::now();
-		duration = end - start;
-
-		return duration.count();
-	}
-};
+#include "profiler.h"
 
 constexpr int maxDisparity = 64;
 
@@ -58,6 +29,8 @@ std::vector<unsigned> zncc(
 	const unsigned,
 	const unsigned,
 	const int,
+	const int,
+	const int,
 	const int
 );
 std::vector<unsigned> crossChecking(
@@ -70,8 +43,17 @@ std::vector<unsigned> occlusionFilling(std::vector<unsigned>, const unsigned, co
 std::vector<unsigned char> normalize(std::vector<unsigned>, const unsigned, const unsigned);
 
 
-int main() {
-	Timer timer; // For calculating time of entire program
+int main(int argc, char** argv) {
+	// The options shared by all backends, see backend_options.h
+	BackendOptions options(windowWidth, windowHeight, maxDisparity);
+	if (!parseBackendOptions(argc, argv, options)) {
+		return -1;
+	}
+
+	ProfileOutput profileOutput(options.profileFile);
+	Profiler::instance().setThreadName("main");
+
+	ProfileZone programZone("program"); // For calculating time of entire program
 
 	omp_set_num_threads(numThreads);
 
@@ -79,10 +61,10 @@ int main() {
 	unsigned width, height, rightWidth, rightHeight;
 
 	std::cout << "Reading Left Image...";
-	leftPixels = loadImage("imageL.png", width, height);
+	leftPixels = loadImage(options.leftFile, width, height);
 
 	std::cout << "Reading Right Image...";
-	rightPixels = loadImage("imageR.png", rightWidth, rightHeight);
+	rightPixels = loadImage(options.rightFile, rightWidth, rightHeight);
 
 	// left and right images are assumed to be of same dimensions
 	assert(width == rightWidth && height == rightHeight);
@@ -104,12 +86,12 @@ int main() {
 
 	// Calculate the disparity maps of left over right and vice versa
 	std::cout << "Calculating Left Disparity Map...";
-	std::vector<unsigned> dispLR = zncc(grayL, grayR, width, height, 0, maxDisparity);
+	std::vector<unsigned> dispLR = zncc(grayL, grayR, width, height, 0, options.maxDisparity, options.windowWidth, options.windowHeight);
 
 	error = lodepng::encode("dispLR.png", normalize(dispLR, width, height), width, height);
 
 	std::cout << "Calculating Right Disparity Map...";
-	std::vector<unsigned> dispRL = zncc(grayR, grayL, width, height, -maxDisparity, 0);
+	std::vector<unsigned> dispRL = zncc(grayR, grayL, width, height, -options.maxDisparity, 0, options.windowWidth, options.windowHeight);
 
 	error = lodepng::encode("dispRL.png", normalize(dispRL, width, height), width, height);
 
@@ -123,14 +105,19 @@ int main() {
 
 	error = lodepng::encode("output.png", normalize(ocfill, width, height), width, height);
 
-	std::cout << "The program took " << timer.getElapsedTime() << " s" << std::endl;
+	if (options.outputFile && writeDisparityPgm(options.outputFile, ocfill, width, height)) {
+		std::cout << "Failed to write " << options.outputFile << std::endl;
+		return -1;
+	}
+
+	std::cout << "The program took " << programZone.getElapsedTime() << " s" << std::endl;
 
 	std::cin.get();
 	return 0;
 }
 
 std::vector<unsigned char> loadImage(const char* filename, unsigned& width, unsigned& height) {
-	Timer timer;
+	ProfileZone zone("load image", true);
 
 	std::vector<unsigned char> pixels;
 
@@ -177,13 +164,15 @@ std::vector<unsigned> zncc(
 	const unsigned width,
 	const unsigned height,
 	const int minDisp,
-	const int maxDisp
+	const int maxDisp,
+	const int blockWidth,
+	const int blockHeight
 ) {
-	Timer timer;
+	ProfileZone zone("zncc", true);
 
 	std::vector<unsigned> disparityMap(width * height);
 
-	const unsigned windowSize = windowWidth * windowHeight;
+	const unsigned windowSize = blockWidth * blockHeight;
 
 	#pragma omp parallel for
 	for (int i = 0; i < height; i++) {
@@ -196,8 +185,8 @@ std::vector<unsigned> zncc(
 				// Calculating mean of blocks using the sliding window method
 				float meanLBlock = 0, meanRBlock = 0;
 
-				for (int x = -windowHeight / 2; x < windowHeight / 2; x++) {
-					for (int y = -windowWidth / 2; y < windowWidth / 2; y++) {
+				for (int x = -blockHeight / 2; x < blockHeight / 2; x++) {
+					for (int y = -blockWidth / 2; y < blockWidth / 2; y++) {
 						// Check for image borders
 						if (
 							!(i + x >= 0) ||
@@ -222,8 +211,8 @@ std::vector<unsigned> zncc(
 				float stdLBlock = 0, stdRBlock = 0;
 				float currentZncc = 0;
 
-				for (int x = -windowHeight / 2; x < windowHeight / 2; x++) {
-					for (int y = -windowWidth / 2; y < windowWidth / 2; y++) {
+				for (int x = -blockHeight / 2; x < blockHeight / 2; x++) {
+					for (int y = -blockWidth / 2; y < blockWidth / 2; y++) {
 						// Check for image borders
 						if (
 							!(i + x >= 0) ||
@@ -269,7 +258,7 @@ std::vector<unsigned> crossChecking(
 	const unsigned width,
 	const unsigned height
 ) {
-	Timer timer;
+	ProfileZone zone("cross checking", true);
 
 	const unsigned imageSize = width * height;
 
@@ -292,7 +281,7 @@ std::vector<unsigned> occlusionFilling(
 	const unsigned width,
 	const unsigned height
 ) {
-	Timer timer;
+	ProfileZone zone("occlusion filling", true);
 
 	std::vector<unsigned> result(width * height);
 
@@ -2,36 +2,13 @@
 #include <chrono>
 #include <omp.h>
 
-class Timer {
-private:
-	std::chrono::time_point<std::chrono::steady_clock> start, end;
-	std::chrono::duration<float> duration;
-
-public:
-	Timer() {
-		start = std::chrono::high_resolution_clock::now();
-	}
-
-	~Timer() {
-		end = std::chrono::high_resolution_clock::now();
-		duration = end - start;
-
-		std::cout << "Done (" << duration.count() << " s)" << std::endl;
-	}
-
-	float getElapsedTime() {
-		end = std::chrono::high_resolution_clock::now();
-		duration = end - start;
-
-		return duration.count();
-	}
-};
+#include "profiler.h"
 
 static long numSteps = 100000;
 double step;
 
 double calculatePiSeries() {
-	Timer timer;
+	ProfileZone zone("pi series", true);
 
 	double sum = 0.0;
 
@@ -45,7 +22,7 @@ double calculatePiSeries() {
 }
 
 double calculatePiParallel() {
-	Timer timer;
+	ProfileZone zone("pi parallel", true);
 
 	omp_set_num_threads(4);
 	